@@ -0,0 +1,75 @@
+/**************************************************************
+   AssetBundle - packed, read-only web UI assets with a RAM index
+   Licensed under MIT license
+ **************************************************************/
+
+#include "AssetBundle.h"
+#include "ConfigRecord.h"
+
+boolean AssetBundle::begin(const char *path) {
+  end();
+  File file = SPIFFS.open(path, "r");
+  if (!file) return false;
+  uint8_t header[WM_BUNDLE_HEADER];
+  if (file.read(header, sizeof(header)) != sizeof(header) || memcmp(header, "WMAB", 4) != 0 || header[4] != WM_BUNDLE_VERSION) {
+    file.close();
+    return false;
+  }
+  uint16_t count = header[6] | (uint16_t)header[7] << 8;
+  uint32_t crc = header[8] | (uint32_t)header[9] << 8 | (uint32_t)header[10] << 16 | (uint32_t)header[11] << 24;
+  if (count == 0 || count > WM_BUNDLE_MAX_ENTRIES) {
+    file.close();
+    return false;
+  }
+
+  size_t indexSize = count * sizeof(WM_BUNDLE_ENTRY);
+  WM_BUNDLE_ENTRY *index = new WM_BUNDLE_ENTRY[count];
+  boolean valid = file.read((uint8_t*)index, indexSize) == indexSize && configCrc32((const uint8_t*)index, indexSize) == crc;
+  // the CRC catches a truncated upload, the rest guards the binary search and the seeks
+  for (uint16_t i = 0; valid && i < count; i++) {
+    const WM_BUNDLE_ENTRY &e = index[i];
+    valid = e.path[0] == '/' && e.path[WM_BUNDLE_PATH_LEN - 1] == 0 && e.encoding <= WM_BUNDLE_BROTLI &&
+            e.offset >= WM_BUNDLE_HEADER + indexSize && e.offset + e.length <= file.size();
+    if (valid && i > 0) {
+      int order = strcmp(index[i - 1].path, e.path);
+      valid = order < 0 || (order == 0 && index[i - 1].encoding < e.encoding);
+    }
+  }
+  if (!valid) {
+    delete[] index;
+    file.close();
+    return false;
+  }
+  _file = file;
+  _index = index;
+  _count = count;
+  return true;
+}
+
+void AssetBundle::end() {
+  // only let go of the handle, a transfer still reading it keeps it open until it is done
+  _file = File();
+  delete[] _index;
+  _index = NULL;
+  _count = 0;
+}
+
+uint8_t AssetBundle::find(const char *path, const WM_BUNDLE_ENTRY **first) const {
+  int lo = 0, hi = (int)_count - 1, at = -1;
+  // leftmost entry of path, its other encodings follow it
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    int order = strcmp(_index[mid].path, path);
+    if (order < 0) {
+      lo = mid + 1;
+    } else {
+      if (order == 0) at = mid;
+      hi = mid - 1;
+    }
+  }
+  if (at < 0) return 0;
+  uint8_t n = 1;
+  while (at + n < _count && strcmp(_index[at + n].path, path) == 0) n++;
+  *first = &_index[at];
+  return n;
+}
@@ -0,0 +1,68 @@
+/**************************************************************
+   AssetBundle is a read-only pack of the web UI assets in one
+   SPIFFS file, built on the host by tools/wmbundle. A sorted
+   index of fixed size entries (path, offset, length, encoding,
+   ETag) follows the header, the payloads follow the index. The
+   index is loaded once and searched in RAM; bodies are sent by
+   seeking into the one handle kept open, so serving an asset
+   does no SPIFFS path lookup at all. An asset in the bundle
+   shadows a loose file of the same path.
+   The format part of this header is shared with the host tool.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef AssetBundle_h
+#define AssetBundle_h
+#include <stdint.h>
+#include <stddef.h>
+
+#define WM_BUNDLE_FILE         "/assets.bin"
+#define WM_BUNDLE_VERSION      1
+#define WM_BUNDLE_HEADER       16  // magic "WMAB", version, 0, entry count, index CRC32, 0
+#define WM_BUNDLE_PATH_LEN     32  // logical path with its terminating 0, as WM_ASSET_PATH_LEN
+#define WM_BUNDLE_MAX_ENTRIES  48  // index kept in RAM, 56 bytes an entry
+
+// encodings, in the order of the portal asset variants
+#define WM_BUNDLE_PLAIN        0
+#define WM_BUNDLE_GZIP         1
+#define WM_BUNDLE_BROTLI       2
+
+// one index entry as stored, little endian. Entries are sorted by path, then encoding,
+// so the variants of an asset are adjacent
+struct WM_BUNDLE_ENTRY {
+  char     path[WM_BUNDLE_PATH_LEN]; // logical path ("/gpio.html"), zero padded
+  uint32_t offset;                   // payload start, from the start of the bundle
+  uint32_t length;
+  uint32_t modified;                 // UTC seconds, 0 when unknown
+  uint8_t  encoding;
+  uint8_t  reserved[3];
+  uint64_t etag;                     // FNV-1a 64 of the payload, as the portal hashes loose files
+};
+static_assert(sizeof(WM_BUNDLE_ENTRY) == 56, "bundle index entry must stay 56 bytes");
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <FS.h>
+
+class AssetBundle {
+  public:
+    ~AssetBundle() { end(); }
+
+    //open the bundle and load its index, false (and nothing kept) when it is missing or damaged
+    boolean       begin(const char *path = WM_BUNDLE_FILE);
+    void          end();
+    boolean       active() { return _count > 0; }
+
+    //binary search for path; first variant in *first, returns the number of variants (0 when absent)
+    uint8_t       find(const char *path, const WM_BUNDLE_ENTRY **first) const;
+    //the open handle, shared by every transfer out of the bundle
+    File&         file() { return _file; }
+    uint16_t      count() { return _count; }
+
+  private:
+    File             _file;
+    WM_BUNDLE_ENTRY *_index = NULL;
+    uint16_t         _count = 0;
+};
+#endif
+#endif
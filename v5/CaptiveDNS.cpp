@@ -0,0 +1,128 @@
+/**************************************************************
+   CaptiveDNS - draining, template based captive DNS responder for the config portal
+   Licensed under MIT license
+ **************************************************************/
+
+#include "CaptiveDNS.h"
+#include "PortalMetrics.h"
+
+#define DNS_HEADER_SIZE 12
+#define DNS_TYPE_A      1
+#define DNS_TYPE_ANY    255
+#define DNS_CLASS_IN    1
+
+boolean CaptiveDNS::start(uint16_t port, const IPAddress &ip) {
+  // the answer record never changes while the portal runs: pointer to the question name (0xC00C),
+  // type A, class IN, TTL and the 4 byte address
+  static const uint8_t head[10] = { 0xC0, 0x0C, 0x00, DNS_TYPE_A, 0x00, DNS_CLASS_IN,
+                                    (uint8_t)(WM_DNS_TTL >> 24), (uint8_t)(WM_DNS_TTL >> 16),
+                                    (uint8_t)(WM_DNS_TTL >> 8), (uint8_t)WM_DNS_TTL };
+  memcpy(_answer, head, sizeof(head));
+  _answer[10] = 0;
+  _answer[11] = 4;
+  for (uint8_t i = 0; i < 4; i++) _answer[12 + i] = ip[i];
+  _running = _udp.begin(port) == 1;
+  return _running;
+}
+
+void CaptiveDNS::stop() {
+  if (_running) _udp.stop();
+  _running = false;
+}
+
+uint16_t CaptiveDNS::processRequests() {
+  uint16_t answered = 0;
+  if (!_running) return 0;
+  while (answered < WM_DNS_MAX_PER_PASS) {
+    int len = _udp.parsePacket();
+    if (len <= 0) break;
+    _queries++;
+    countClient(_udp.remoteIP());
+    if (len > WM_DNS_PACKET) {
+      _dropped++;
+      _udp.flush();
+      continue;
+    }
+    len = _udp.read(_packet, len);
+    if (len <= 0 || !answer(len)) {
+      _dropped++;
+      continue;
+    }
+    answered++;
+  }
+  return answered;
+}
+
+//turns the query in _packet into its answer and sends it, false for anything that is not one plain query
+boolean CaptiveDNS::answer(size_t len) {
+  if (len < DNS_HEADER_SIZE + 5) return false;
+  uint8_t *p = _packet;
+  // QR must be 0 (query), opcode 0 (standard), exactly one question
+  if ((p[2] & 0xF8) != 0 || p[4] != 0 || p[5] != 1) return false;
+
+  // walk the question name, labels only (no compression in a question)
+  size_t at = DNS_HEADER_SIZE;
+  while (at < len && p[at] != 0) {
+    if (p[at] & 0xC0) return false;
+    at += p[at] + 1;
+  }
+  at++; // root label
+  if (at + 4 > len) return false;
+  uint16_t qtype = p[at] << 8 | p[at + 1];
+  at += 4;
+
+  // patch the header in place: keep the id and RD, set QR and AA, no error, drop any additional
+  // records (EDNS) the client sent, answer A and ANY queries, others get an empty NOERROR answer
+  boolean withAnswer = (qtype == DNS_TYPE_A || qtype == DNS_TYPE_ANY);
+  p[2] = 0x84 | (p[2] & 0x01);
+  p[3] = 0x00;
+  p[6] = 0;
+  p[7] = withAnswer ? 1 : 0;
+  p[8] = p[9] = p[10] = p[11] = 0;
+  if (withAnswer) {
+    if (at + sizeof(_answer) > WM_DNS_PACKET) return false;
+    memcpy(p + at, _answer, sizeof(_answer));
+    at += sizeof(_answer);
+  }
+
+  _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
+  _udp.write(p, at);
+  _udp.endPacket();
+  return true;
+}
+
+void CaptiveDNS::countClient(uint32_t ip) {
+  uint8_t oldest = 0;
+  for (uint8_t i = 0; i < WM_DNS_CLIENTS; i++) {
+    if (_clients[i].ip == ip) {
+      _clients[i].queries++;
+      _clients[i].lastSeen = millis();
+      return;
+    }
+    if (_clients[i].lastSeen < _clients[oldest].lastSeen) oldest = i;
+  }
+  _clients[oldest].ip = ip;
+  _clients[oldest].queries = 1;
+  _clients[oldest].lastSeen = millis();
+}
+
+void CaptiveDNS::writeMetrics(Print &out) {
+  printMetricHeader(out, "wm_dns_queries_total", "counter", "Captive DNS queries received.");
+  out.print(F("wm_dns_queries_total "));
+  out.print(_queries);
+  out.print('\n');
+  printMetricHeader(out, "wm_dns_dropped_total", "counter", "Captive DNS queries not answered.");
+  out.print(F("wm_dns_dropped_total "));
+  out.print(_dropped);
+  out.print('\n');
+  printMetricHeader(out, "wm_dns_client_queries_total", "counter", "Captive DNS queries per recent client.");
+  for (uint8_t i = 0; i < WM_DNS_CLIENTS; i++) {
+    if (_clients[i].queries == 0) continue;
+    IPAddress ip(_clients[i].ip);
+    char line[64];
+    snprintf(line, sizeof(line), "wm_dns_client_queries_total{client=\"%u.%u.%u.%u\"} ", ip[0], ip[1], ip[2], ip[3]);
+    out.print(line);
+    out.print(_clients[i].queries);
+    out.print('\n');
+  }
+}
@@ -0,0 +1,51 @@
+/**************************************************************
+   CaptiveDNS answers every A query of the config portal clients
+   with the soft AP address. All pending queries are drained each
+   pass; answers are made in place in the receive buffer by
+   patching a header and answer record prepared at start(), so a
+   burst of lookups from a joining phone is answered in one go.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef CaptiveDNS_h
+#define CaptiveDNS_h
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+#define WM_DNS_PACKET 512       // largest query handled, plain DNS over UDP
+#define WM_DNS_MAX_PER_PASS 64  // queries answered per pass at most, the rest waits in lwIP
+#define WM_DNS_TTL 60           // seconds clients may cache the answer
+#define WM_DNS_CLIENTS 8        // clients with their own query counter, least recent is replaced
+
+class CaptiveDNS {
+  public:
+    ~CaptiveDNS() { stop(); }
+
+    boolean       start(uint16_t port, const IPAddress &ip);
+    void          stop();
+    //answers everything that is waiting, returns the number of queries answered
+    uint16_t      processRequests();
+
+    uint32_t      queries() { return _queries; }
+    uint32_t      dropped() { return _dropped; }
+    //Prometheus text lines of the counters, per client included
+    void          writeMetrics(Print &out);
+
+  private:
+    struct ClientCount {
+      uint32_t      ip       = 0;
+      uint32_t      queries  = 0;
+      unsigned long lastSeen = 0;
+    };
+    WiFiUDP       _udp;
+    boolean       _running = false;
+    uint8_t       _packet[WM_DNS_PACKET];
+    uint8_t       _answer[16];     // name pointer, type A, class IN, TTL, length, address
+    uint32_t      _queries = 0;
+    uint32_t      _dropped = 0;
+    ClientCount   _clients[WM_DNS_CLIENTS];
+
+    boolean       answer(size_t len);
+    void          countClient(uint32_t ip);
+};
+#endif
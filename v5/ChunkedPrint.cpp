@@ -0,0 +1,78 @@
+/**************************************************************
+   ChunkedPrint - streaming chunked HTTP writer for the config portal
+   Licensed under MIT license
+ **************************************************************/
+
+#include "ChunkedPrint.h"
+
+uint32_t ChunkedPrint::_totalSent = 0;
+
+ChunkedPrint::ChunkedPrint(WiFiClient client) : _client(client) {
+}
+
+ChunkedPrint::~ChunkedPrint() {
+  end();
+}
+
+void ChunkedPrint::begin(int code, const char *contentType, boolean noCache) {
+  char line[48];
+  snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", code, statusText(code));
+  _client.write((const uint8_t*)line, strlen(line));
+  _client.print(F("Content-Type: "));
+  _client.print(contentType);
+  _client.print(F("\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n"));
+  if (noCache) {
+    _client.print(F("Cache-Control: no-cache, no-store, must-revalidate\r\nPragma: no-cache\r\nExpires: -1\r\n"));
+  }
+  _client.print(F("\r\n"));
+  _started = true;
+}
+
+const char* ChunkedPrint::statusText(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 404: return "Not Found";
+    case 500: return "Internal Server Error";
+    default:  return "";
+  }
+}
+
+void ChunkedPrint::end() {
+  if (!_started || _ended) return;
+  flushChunk();
+  _client.print(F("0\r\n\r\n"));
+  _ended = true;
+}
+
+size_t ChunkedPrint::write(uint8_t c) {
+  if (_len == sizeof(_buf)) flushChunk();
+  _buf[_len++] = c;
+  return 1;
+}
+
+size_t ChunkedPrint::write(const uint8_t *buf, size_t size) {
+  size_t left = size;
+  while (left > 0) {
+    if (_len == sizeof(_buf)) flushChunk();
+    size_t n = sizeof(_buf) - _len;
+    if (n > left) n = left;
+    memcpy(_buf + _len, buf, n);
+    _len += n;
+    buf += n;
+    left -= n;
+  }
+  return size;
+}
+
+//one chunk is "<hex size>\r\n<data>\r\n"
+void ChunkedPrint::flushChunk() {
+  if (_len == 0) return;
+  char head[8];
+  snprintf(head, sizeof(head), "%X\r\n", (unsigned int)_len);
+  _client.write((const uint8_t*)head, strlen(head));
+  _client.write((const uint8_t*)_buf, _len);
+  _client.write((const uint8_t*)"\r\n", 2);
+  _sent += _len;
+  _totalSent += _len;
+  _len = 0;
+}
@@ -0,0 +1,47 @@
+/**************************************************************
+   ChunkedPrint streams an HTTP/1.1 response with chunked transfer
+   encoding straight into the client socket of the config portal.
+   Output is collected in a small fixed buffer that lives with the
+   writer (on the stack of the handler), PROGMEM text is copied
+   through it, so a page of any size costs no heap.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef ChunkedPrint_h
+#define ChunkedPrint_h
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#define WM_CHUNK_SIZE 256 // bytes buffered before a chunk is written to the socket
+
+class ChunkedPrint : public Print {
+  public:
+    ChunkedPrint(WiFiClient client);
+    ~ChunkedPrint();
+
+    //writes the status line and headers, the body follows through print()/write()
+    void          begin(int code, const char *contentType, boolean noCache = true);
+    //flushes what is left and writes the terminating chunk
+    void          end();
+
+    size_t        write(uint8_t c) override;
+    size_t        write(const uint8_t *buf, size_t size) override;
+    using Print::write;
+
+    size_t        bytesSent() { return _sent; }
+    //body bytes written by every writer so far, for the portal metrics
+    static uint32_t totalSent() { return _totalSent; }
+
+  private:
+    WiFiClient    _client;
+    uint8_t       _buf[WM_CHUNK_SIZE];
+    size_t        _len     = 0;
+    size_t        _sent    = 0;
+    boolean       _started = false;
+    boolean       _ended   = false;
+    static uint32_t _totalSent;
+
+    void          flushChunk();
+    static const char* statusText(int code);
+};
+#endif
@@ -0,0 +1,95 @@
+/**************************************************************
+   ConfigRecord - versioned, CRC protected settings record
+   Licensed under MIT license
+ **************************************************************/
+
+#include "ConfigRecord.h"
+#include <string.h>
+
+static const uint8_t CONFIG_MAGIC[4] = {'W', 'M', 'C', 'F'};
+
+#define CONFIG_FLAGS_AT    5
+#define CONFIG_SSID_AT     6
+#define CONFIG_PASS_AT     (CONFIG_SSID_AT + 1 + WM_CONFIG_SSID_MAX)
+#define CONFIG_IP_AT       (CONFIG_PASS_AT + 1 + WM_CONFIG_PASS_MAX)
+#define CONFIG_CRC_AT      (CONFIG_IP_AT + 12)
+
+static_assert(CONFIG_CRC_AT + 4 <= WM_CONFIG_SIZE, "config record does not fit WM_CONFIG_SIZE");
+
+//bitwise, the record is checked once per boot so a 1KB table is not worth the flash
+uint32_t configCrc32(const uint8_t *data, size_t len, uint32_t crc) {
+  crc = ~crc;
+  while (len--) {
+    crc ^= *data++;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static void putField(uint8_t *at, const char *value, size_t max) {
+  size_t len = 0;
+  while (len < max && value[len]) len++;
+  at[0] = (uint8_t)len;
+  memcpy(at + 1, value, len);
+}
+
+static bool getField(const uint8_t *at, char *value, size_t max) {
+  size_t len = at[0];
+  if (len > max) return false;
+  memcpy(value, at + 1, len);
+  value[len] = 0;
+  return true;
+}
+
+void encodeConfig(const WM_CONFIG &cfg, uint8_t *buf) {
+  memset(buf, 0, WM_CONFIG_SIZE);
+  memcpy(buf, CONFIG_MAGIC, sizeof(CONFIG_MAGIC));
+  buf[4] = WM_CONFIG_VERSION;
+  buf[CONFIG_FLAGS_AT] = cfg.flags;
+  putField(buf + CONFIG_SSID_AT, cfg.ssid, WM_CONFIG_SSID_MAX);
+  putField(buf + CONFIG_PASS_AT, cfg.pass, WM_CONFIG_PASS_MAX);
+  memcpy(buf + CONFIG_IP_AT, cfg.ip, 4);
+  memcpy(buf + CONFIG_IP_AT + 4, cfg.netmask, 4);
+  memcpy(buf + CONFIG_IP_AT + 8, cfg.gateway, 4);
+  uint32_t crc = configCrc32(buf, CONFIG_CRC_AT);
+  for (uint8_t i = 0; i < 4; i++) {
+    buf[CONFIG_CRC_AT + i] = (uint8_t)(crc >> (8 * i));
+  }
+}
+
+WM_CONFIG_RESULT decodeConfig(const uint8_t *buf, size_t len, WM_CONFIG &cfg) {
+  if (len < WM_CONFIG_SIZE) return WM_CONFIG_SHORT;
+  if (memcmp(buf, CONFIG_MAGIC, sizeof(CONFIG_MAGIC)) != 0) return WM_CONFIG_BAD_MAGIC;
+  if (buf[4] != WM_CONFIG_VERSION) return WM_CONFIG_BAD_VERSION;
+  uint32_t stored = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    stored |= (uint32_t)buf[CONFIG_CRC_AT + i] << (8 * i);
+  }
+  if (configCrc32(buf, CONFIG_CRC_AT) != stored) return WM_CONFIG_BAD_CRC;
+
+  WM_CONFIG out;
+  if (!getField(buf + CONFIG_SSID_AT, out.ssid, WM_CONFIG_SSID_MAX) ||
+      !getField(buf + CONFIG_PASS_AT, out.pass, WM_CONFIG_PASS_MAX)) {
+    return WM_CONFIG_BAD_LENGTH;
+  }
+  out.flags = buf[CONFIG_FLAGS_AT];
+  memcpy(out.ip, buf + CONFIG_IP_AT, 4);
+  memcpy(out.netmask, buf + CONFIG_IP_AT + 4, 4);
+  memcpy(out.gateway, buf + CONFIG_IP_AT + 8, 4);
+  cfg = out;
+  return WM_CONFIG_OK;
+}
+
+const char *configResultText(WM_CONFIG_RESULT result) {
+  switch (result) {
+    case WM_CONFIG_OK:          return "ok";
+    case WM_CONFIG_SHORT:       return "record too short";
+    case WM_CONFIG_BAD_MAGIC:   return "not a config record";
+    case WM_CONFIG_BAD_VERSION: return "unsupported version";
+    case WM_CONFIG_BAD_CRC:     return "CRC mismatch";
+    case WM_CONFIG_BAD_LENGTH:  return "field length out of range";
+  }
+  return "unknown";
+}
@@ -0,0 +1,57 @@
+/**************************************************************
+   ConfigRecord is the binary layout of the portal settings file
+   (WiFi credentials and static IP details). It has no Arduino
+   dependency so the host tool in tools/ encodes and decodes the
+   exact same bytes the module reads at boot.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef ConfigRecord_h
+#define ConfigRecord_h
+#include <stdint.h>
+#include <stddef.h>
+
+#define WM_CONFIG_FILE       "/config.bin"
+#define WM_CONFIG_TEMP_FILE  "/config.tmp" // written first, renamed over WM_CONFIG_FILE once complete
+#define WM_CONFIG_VERSION    1
+#define WM_CONFIG_SIZE       120 // encoded record, bytes
+#define WM_CONFIG_SSID_MAX   32
+#define WM_CONFIG_PASS_MAX   64
+#define WM_CONFIG_STATIC_IP  0x01 // flags bit, ip/netmask/gateway are valid
+
+/*
+   Encoded layout, multi byte values little endian:
+     0   magic "WMCF"
+     4   version
+     5   flags
+     6   ssid length, 7 ssid bytes (32, zero padded)
+     39  password length, 40 password bytes (64, zero padded)
+     104 ip, 108 netmask, 112 gateway (4 bytes each, network order)
+     116 CRC32 of bytes 0..115
+*/
+struct WM_CONFIG {
+  char    ssid[WM_CONFIG_SSID_MAX + 1] = "";
+  char    pass[WM_CONFIG_PASS_MAX + 1] = "";
+  uint8_t flags = 0;
+  uint8_t ip[4] = {};
+  uint8_t netmask[4] = {};
+  uint8_t gateway[4] = {};
+};
+
+enum WM_CONFIG_RESULT {
+  WM_CONFIG_OK = 0,
+  WM_CONFIG_SHORT,     // fewer than WM_CONFIG_SIZE bytes
+  WM_CONFIG_BAD_MAGIC,
+  WM_CONFIG_BAD_VERSION,
+  WM_CONFIG_BAD_CRC,
+  WM_CONFIG_BAD_LENGTH // a length prefix larger than its field
+};
+
+//IEEE 802.3 CRC32, pass the previous result as crc to continue over several buffers
+uint32_t         configCrc32(const uint8_t *data, size_t len, uint32_t crc = 0);
+//fill buf (WM_CONFIG_SIZE bytes) from cfg, strings longer than their field are cut
+void             encodeConfig(const WM_CONFIG &cfg, uint8_t *buf);
+//check and unpack len bytes of buf into cfg, cfg is untouched unless WM_CONFIG_OK is returned
+WM_CONFIG_RESULT decodeConfig(const uint8_t *buf, size_t len, WM_CONFIG &cfg);
+const char      *configResultText(WM_CONFIG_RESULT result);
+#endif
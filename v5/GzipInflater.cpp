@@ -0,0 +1,398 @@
+/**************************************************************
+   GzipInflater - streaming gzip decoder for OTA images
+   Licensed under MIT license
+ **************************************************************/
+
+#include "GzipInflater.h"
+#include "ConfigRecord.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define GZ_FHCRC    0x02
+#define GZ_FEXTRA   0x04
+#define GZ_FNAME    0x08
+#define GZ_FCOMMENT 0x10
+
+static_assert((WM_INFLATE_BLOCK & (WM_INFLATE_BLOCK - 1)) == 0, "sink block must be a power of two");
+static_assert(WM_INFLATE_LOOKAHEAD < WM_INFLATE_INPUT, "input buffer must hold a block header");
+
+static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                         35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                         3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distBase[30]   = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                         513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distExtra[30]   = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7,
+                                         8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+bool GzipInflater::begin(Sink sink, uint8_t windowBits) {
+  end();
+  if (windowBits < 12) windowBits = 12; // a window holds at least one sink block
+  if (windowBits > 15) windowBits = 15;
+  _window = (uint8_t*)malloc((size_t)1 << windowBits);
+  if (_window == NULL) {
+    _result = WM_INFLATE_NO_MEMORY;
+    return false;
+  }
+  _sink = sink;
+  _mask = ((uint32_t)1 << windowBits) - 1;
+  _state = S_HEADER;
+  _result = WM_INFLATE_OK;
+  _out = _flushed = _crc = _inTotal = 0;
+  _inLen = _inPos = 0;
+  alignByte();
+  return true;
+}
+
+void GzipInflater::end() {
+  free(_window);
+  _window = NULL;
+  _sink = NULL;
+}
+
+bool GzipInflater::write(const uint8_t *data, size_t len) {
+  while (len > 0 && _result == WM_INFLATE_OK) {
+    if (_inPos > 0) { // keep the unread bytes at the front
+      memmove(_in, _in + _inPos, _inLen - _inPos);
+      _inLen -= _inPos;
+      _inPos = 0;
+    }
+    size_t n = WM_INFLATE_INPUT - _inLen;
+    if (n > len) n = len;
+    memcpy(_in + _inLen, data, n);
+    _inLen += n;
+    _inTotal += n;
+    data += n;
+    len -= n;
+    run(false);
+  }
+  return _result == WM_INFLATE_OK;
+}
+
+bool GzipInflater::finish() {
+  if (_result == WM_INFLATE_OK) run(true);
+  if (_result == WM_INFLATE_OK && _state != S_DONE) fail(WM_INFLATE_TRUNCATED);
+  return _result == WM_INFLATE_OK;
+}
+
+void GzipInflater::fail(WM_INFLATE_RESULT result) {
+  if (_result == WM_INFLATE_OK) _result = result;
+}
+
+//decode while the buffered input is enough for the next step; once final, until the end or a failure
+void GzipInflater::run(bool final) {
+  while (_result == WM_INFLATE_OK && _state != S_DONE) {
+    if (!final && _inLen - _inPos < need()) return;
+    if (_state == S_CODES) codes(final);
+    else step();
+  }
+  _inPos = _inLen; // whatever follows the member is ignored
+}
+
+//input bytes one step of the current state may read, so a step never runs dry before the input is final
+size_t GzipInflater::need() {
+  switch (_state) {
+    case S_HEADER:    return 10;
+    case S_EXTRA_LEN: return 2;
+    case S_HCRC:      return 2;
+    case S_BLOCK:     return WM_INFLATE_LOOKAHEAD;
+    case S_CODES:     return 8; // longest literal/length code, extra bits, distance code and extra bits
+    case S_TRAILER:   return 8;
+    default:          return 1;
+  }
+}
+
+void GzipInflater::headerNext(State from) {
+  if (from < S_EXTRA_LEN && (_flags & GZ_FEXTRA)) _state = S_EXTRA_LEN;
+  else if (from < S_NAME && (_flags & GZ_FNAME)) _state = S_NAME;
+  else if (from < S_COMMENT && (_flags & GZ_FCOMMENT)) _state = S_COMMENT;
+  else if (from < S_HCRC && (_flags & GZ_FHCRC)) _state = S_HCRC;
+  else _state = S_BLOCK;
+}
+
+void GzipInflater::step() {
+  switch (_state) {
+    case S_HEADER: {
+      uint8_t id1 = getByte(), id2 = getByte(), method = getByte();
+      _flags = getByte();
+      for (uint8_t i = 0; i < 6; i++) getByte(); // mtime, xfl, os
+      if (id1 != 0x1f || id2 != 0x8b || method != 8 || (_flags & 0xE0)) {
+        fail(WM_INFLATE_BAD_HEADER);
+        return;
+      }
+      headerNext(S_HEADER);
+      break;
+    }
+    case S_EXTRA_LEN:
+      _remaining = getByte();
+      _remaining |= (uint32_t)getByte() << 8;
+      _state = S_EXTRA;
+      break;
+    case S_EXTRA:
+    case S_STORED:
+      stored();
+      break;
+    case S_NAME:
+    case S_COMMENT:
+      while (_result == WM_INFLATE_OK) {
+        if (getByte() == 0) {
+          headerNext(_state);
+          return;
+        }
+        if (_inPos == _inLen) return; // more of the string in the next write
+      }
+      break;
+    case S_HCRC:
+      getByte();
+      getByte();
+      headerNext(S_HCRC);
+      break;
+    case S_BLOCK:
+      blockHeader();
+      break;
+    case S_TRAILER:
+      trailer();
+      break;
+    default:
+      break;
+  }
+}
+
+uint8_t GzipInflater::getByte() {
+  if (_inPos >= _inLen) {
+    fail(WM_INFLATE_TRUNCATED);
+    return 0;
+  }
+  return _in[_inPos++];
+}
+
+//n (up to 16) bits, least significant first as deflate packs them
+uint32_t GzipInflater::getBits(uint8_t n) {
+  while (_bitCount < n) {
+    _bits |= (uint32_t)getByte() << _bitCount;
+    _bitCount += 8;
+  }
+  uint32_t value = _bits & (((uint32_t)1 << n) - 1);
+  _bits >>= n;
+  _bitCount -= n;
+  return value;
+}
+
+//canonical Huffman code from code lengths, false when the lengths describe more codes than fit
+bool GzipInflater::buildTree(Tree &t, const uint8_t *lengths, uint16_t num) {
+  uint16_t offsets[16];
+  memset(t.counts, 0, sizeof(t.counts));
+  for (uint16_t i = 0; i < num; i++) t.counts[lengths[i]]++;
+  t.counts[0] = 0;
+  int32_t left = 1;
+  uint16_t sum = 0;
+  for (uint8_t len = 0; len < 16; len++) {
+    if (len > 0) {
+      left = (left << 1) - t.counts[len];
+      if (left < 0) return false;
+    }
+    offsets[len] = sum;
+    sum += t.counts[len];
+  }
+  for (uint16_t i = 0; i < num; i++) {
+    if (lengths[i]) t.symbols[offsets[lengths[i]]++] = i;
+  }
+  return true;
+}
+
+//next symbol of t, -1 when the bits match no code
+int GzipInflater::decodeSymbol(const Tree &t) {
+  int32_t code = 0, first = 0;
+  uint16_t index = 0;
+  for (uint8_t len = 1; len < 16; len++) {
+    code |= getBits(1);
+    int32_t count = t.counts[len];
+    if (code - first < count) return t.symbols[index + code - first];
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+  }
+  return -1;
+}
+
+void GzipInflater::blockHeader() {
+  _last = getBits(1);
+  uint8_t type = getBits(2);
+  if (type == 0) {
+    alignByte();
+    uint16_t len = getByte();
+    len |= (uint16_t)getByte() << 8;
+    uint16_t nlen = getByte();
+    nlen |= (uint16_t)getByte() << 8;
+    if ((uint16_t)~nlen != len) {
+      fail(WM_INFLATE_BAD_DATA);
+      return;
+    }
+    _remaining = len;
+    _state = S_STORED;
+  } else if (type == 1) {
+    fixedTrees();
+    _state = S_CODES;
+  } else if (type == 2) {
+    if (!dynamicTrees()) {
+      fail(WM_INFLATE_BAD_DATA);
+      return;
+    }
+    _state = S_CODES;
+  } else {
+    fail(WM_INFLATE_BAD_DATA);
+  }
+}
+
+void GzipInflater::fixedTrees() {
+  uint8_t lengths[288];
+  memset(lengths, 8, 144);
+  memset(lengths + 144, 9, 112);
+  memset(lengths + 256, 7, 24);
+  memset(lengths + 280, 8, 8);
+  buildTree(_lit, lengths, 288);
+  memset(lengths, 5, 30);
+  buildTree(_dist, lengths, 30);
+}
+
+bool GzipInflater::dynamicTrees() {
+  static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+  uint8_t lengths[286 + 30];
+  uint16_t hlit = getBits(5) + 257;
+  uint16_t hdist = getBits(5) + 1;
+  uint8_t hclen = getBits(4) + 4;
+  if (hlit > 286 || hdist > 30) return false;
+  memset(lengths, 0, 19);
+  for (uint8_t i = 0; i < hclen; i++) lengths[order[i]] = getBits(3);
+  if (!buildTree(_lit, lengths, 19)) return false; // the code length code, for the moment
+
+  for (uint16_t num = 0; num < hlit + hdist;) {
+    int sym = decodeSymbol(_lit);
+    if (sym < 0 || _result != WM_INFLATE_OK) return false;
+    uint8_t len = 0;
+    uint8_t repeat = 1;
+    if (sym < 16) {
+      len = sym;
+    } else if (sym == 16) {
+      if (num == 0) return false;
+      len = lengths[num - 1];
+      repeat = 3 + getBits(2);
+    } else if (sym == 17) {
+      repeat = 3 + getBits(3);
+    } else {
+      repeat = 11 + getBits(7);
+    }
+    if (num + repeat > hlit + hdist) return false;
+    memset(lengths + num, len, repeat);
+    num += repeat;
+  }
+  if (lengths[256] == 0) return false; // no end of block code
+  return buildTree(_lit, lengths, hlit) && buildTree(_dist, lengths + hlit, hdist);
+}
+
+//literals and back references until the end of the block, or until the input may run short
+void GzipInflater::codes(bool final) {
+  while (_result == WM_INFLATE_OK) {
+    if (!final && _inLen - _inPos < need()) return;
+    int sym = decodeSymbol(_lit);
+    if (sym < 256) {
+      if (sym < 0) fail(WM_INFLATE_BAD_DATA);
+      else put(sym);
+      continue;
+    }
+    if (sym == 256) {
+      if (_last) {
+        alignByte();
+        _state = S_TRAILER;
+      } else {
+        _state = S_BLOCK;
+      }
+      return;
+    }
+    sym -= 257;
+    if (sym >= 29) {
+      fail(WM_INFLATE_BAD_DATA);
+      return;
+    }
+    uint16_t len = lengthBase[sym] + getBits(lengthExtra[sym]);
+    int dsym = decodeSymbol(_dist);
+    if (dsym < 0 || dsym >= 30) {
+      fail(WM_INFLATE_BAD_DATA);
+      return;
+    }
+    uint32_t dist = distBase[dsym] + getBits(distExtra[dsym]);
+    if (dist > _out || dist > _mask + 1) {
+      fail(WM_INFLATE_FAR_DISTANCE);
+      return;
+    }
+    while (len-- && _result == WM_INFLATE_OK) put(_window[(_out - dist) & _mask]);
+  }
+}
+
+//bytes of a stored block, or of a gzip extra field that is skipped
+void GzipInflater::stored() {
+  if (_remaining == 0) {
+    if (_state == S_EXTRA) headerNext(S_EXTRA);
+    else if (_last) _state = S_TRAILER;
+    else _state = S_BLOCK;
+    return;
+  }
+  size_t n = _inLen - _inPos;
+  if (n == 0) {
+    fail(WM_INFLATE_TRUNCATED);
+    return;
+  }
+  if (n > _remaining) n = _remaining;
+  _remaining -= n;
+  if (_state == S_EXTRA) {
+    _inPos += n;
+    return;
+  }
+  while (n-- && _result == WM_INFLATE_OK) put(_in[_inPos++]);
+}
+
+//the last partial block goes out before the CRC and size of the whole output are checked
+void GzipInflater::trailer() {
+  uint32_t crc = 0, size = 0;
+  for (uint8_t i = 0; i < 4; i++) crc |= (uint32_t)getByte() << (8 * i);
+  for (uint8_t i = 0; i < 4; i++) size |= (uint32_t)getByte() << (8 * i);
+  if (_result != WM_INFLATE_OK) return;
+  if (_out > _flushed && !flush(_out - _flushed)) return;
+  if (crc != _crc) fail(WM_INFLATE_BAD_CRC);
+  else if (size != _out) fail(WM_INFLATE_BAD_LENGTH);
+  else _state = S_DONE;
+}
+
+void GzipInflater::put(uint8_t b) {
+  _window[_out & _mask] = b;
+  _out++;
+  if ((_out & (WM_INFLATE_BLOCK - 1)) == 0) flush(WM_INFLATE_BLOCK);
+}
+
+//hand len bytes from the first not yet flushed one to the sink; blocks start on a block boundary of the
+//window, so they never wrap
+bool GzipInflater::flush(size_t len) {
+  const uint8_t *block = _window + (_flushed & _mask);
+  _crc = configCrc32(block, len, _crc);
+  _flushed += len;
+  if (!_sink(block, len)) {
+    fail(WM_INFLATE_SINK);
+    return false;
+  }
+  return true;
+}
+
+const char *GzipInflater::resultText(WM_INFLATE_RESULT result) {
+  switch (result) {
+    case WM_INFLATE_OK:           return "ok";
+    case WM_INFLATE_BAD_HEADER:   return "not a gzip stream";
+    case WM_INFLATE_BAD_DATA:     return "corrupt deflate data";
+    case WM_INFLATE_FAR_DISTANCE: return "compressed with a larger window";
+    case WM_INFLATE_TRUNCATED:    return "stream ends early";
+    case WM_INFLATE_BAD_CRC:      return "CRC mismatch";
+    case WM_INFLATE_BAD_LENGTH:   return "size mismatch";
+    case WM_INFLATE_SINK:         return "write failed";
+    case WM_INFLATE_NO_MEMORY:    return "out of memory";
+  }
+  return "unknown";
+}
@@ -0,0 +1,110 @@
+/**************************************************************
+   GzipInflater decodes a gzip member (RFC 1952, deflate RFC 1951)
+   as it arrives in pieces of any size, the way an OTA upload comes
+   in. Output goes through a circular window of 2^windowBits bytes
+   that doubles as the write buffer: every time WM_INFLATE_BLOCK
+   bytes (one flash sector) are complete the sink gets them, the
+   last partial block follows at the end. The stream must have been
+   compressed with a window no larger than the one given here,
+   tools/wmota takes care of that. No Arduino dependency, the host
+   tool runs the same decoder to check what it produced.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef GzipInflater_h
+#define GzipInflater_h
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+#define WM_INFLATE_WINDOW_BITS 13    // default window, 8 KB; 12..15
+#define WM_INFLATE_BLOCK       4096  // sink block, the flash sector size
+#define WM_INFLATE_INPUT       1024  // compressed bytes buffered between two writes
+#define WM_INFLATE_LOOKAHEAD   640   // bytes a block header (dynamic code tables included) may take
+
+enum WM_INFLATE_RESULT {
+  WM_INFLATE_OK = 0,
+  WM_INFLATE_BAD_HEADER,   // not a gzip member, or not deflate
+  WM_INFLATE_BAD_DATA,     // invalid block type, code or length
+  WM_INFLATE_FAR_DISTANCE, // back reference past the window, compressed with a larger window
+  WM_INFLATE_TRUNCATED,    // input ended inside the stream
+  WM_INFLATE_BAD_CRC,
+  WM_INFLATE_BAD_LENGTH,   // trailer size differs from the output
+  WM_INFLATE_SINK,         // the sink refused a block
+  WM_INFLATE_NO_MEMORY
+};
+
+class GzipInflater {
+  public:
+    //takes one block of output, false stops the stream
+    typedef std::function<bool(const uint8_t *data, size_t len)> Sink;
+
+    ~GzipInflater() { end(); }
+
+    //allocate the window and wait for the gzip header
+    bool          begin(Sink sink, uint8_t windowBits = WM_INFLATE_WINDOW_BITS);
+    //decode as far as len more input bytes allow; false once the stream failed
+    bool          write(const uint8_t *data, size_t len);
+    //input is complete: decode the rest, hand over the last block and check the trailer
+    bool          finish();
+    //release the window, also after a failure
+    void          end();
+
+    WM_INFLATE_RESULT result() { return _result; }
+    bool          done() { return _state == S_DONE; }
+    uint32_t      inputBytes() { return _inTotal; }
+    uint32_t      outputBytes() { return _out; }
+
+    //true when data starts with the gzip magic
+    static bool   isGzip(const uint8_t *data, size_t len) { return len >= 2 && data[0] == 0x1f && data[1] == 0x8b; }
+    static const char *resultText(WM_INFLATE_RESULT result);
+
+  private:
+    enum State { S_HEADER, S_EXTRA_LEN, S_EXTRA, S_NAME, S_COMMENT, S_HCRC, S_BLOCK, S_STORED, S_CODES, S_TRAILER, S_DONE };
+    struct Tree {
+      uint16_t      counts[16];   // codes of each length
+      uint16_t      symbols[288]; // symbols ordered by code
+    };
+
+    Sink          _sink;
+    uint8_t      *_window = NULL;
+    uint32_t      _mask = 0;
+    State         _state = S_DONE;
+    WM_INFLATE_RESULT _result = WM_INFLATE_OK;
+    uint8_t       _flags = 0;       // gzip FLG
+    bool          _last = false;    // the block being decoded is the final one
+    uint32_t      _remaining = 0;   // bytes left of a stored block or a gzip extra field
+    uint32_t      _out = 0;         // bytes decoded
+    uint32_t      _flushed = 0;     // bytes handed to the sink
+    uint32_t      _crc = 0;
+    uint32_t      _inTotal = 0;
+    uint8_t       _in[WM_INFLATE_INPUT];
+    size_t        _inLen = 0;
+    size_t        _inPos = 0;
+    uint32_t      _bits = 0;
+    uint8_t       _bitCount = 0;
+    Tree          _lit, _dist;
+
+    void          run(bool final);
+    size_t        need();
+    void          step();
+    void          fail(WM_INFLATE_RESULT result);
+    void          headerNext(State from);
+
+    uint32_t      getBits(uint8_t n);
+    uint8_t       getByte();
+    void          alignByte() { _bits = 0; _bitCount = 0; }
+
+    bool          buildTree(Tree &t, const uint8_t *lengths, uint16_t num);
+    int           decodeSymbol(const Tree &t);
+    void          blockHeader();
+    bool          dynamicTrees();
+    void          fixedTrees();
+    void          codes(bool final);
+    void          stored();
+    void          trailer();
+
+    void          put(uint8_t b);
+    bool          flush(size_t len);
+};
+#endif
@@ -0,0 +1,146 @@
+/**************************************************************
+   JsonWriter - allocation free streaming JSON for the config portal
+   Licensed under MIT license
+ **************************************************************/
+
+#include "JsonWriter.h"
+
+//comma before every item but the first of its level, nothing right after a key
+void JsonWriter::separate() {
+  if (_afterKey) {
+    _afterKey = false;
+    return;
+  }
+  if (_depth == 0) return;
+  uint16_t bit = 1 << (_depth - 1);
+  if (_used & bit) _out.write(',');
+  _used |= bit;
+}
+
+void JsonWriter::open(char c) {
+  separate();
+  _out.write(c);
+  if (_depth < WM_JSON_DEPTH) {
+    _depth++;
+    _used &= ~(1 << (_depth - 1));
+  }
+}
+
+void JsonWriter::close(char c) {
+  if (_depth > 0) _depth--;
+  _out.write(c);
+}
+
+void JsonWriter::beginObject() { open('{'); }
+void JsonWriter::endObject()   { close('}'); }
+void JsonWriter::beginArray()  { open('['); }
+void JsonWriter::endArray()    { close(']'); }
+
+void JsonWriter::key(const char *name) {
+  separate();
+  writeEscaped(name, false);
+  _out.write(':');
+  _afterKey = true;
+}
+
+void JsonWriter::value(const char *s) {
+  separate();
+  if (s == NULL) {
+    _out.print(F("null"));
+    return;
+  }
+  writeEscaped(s, false);
+}
+
+void JsonWriter::value(const __FlashStringHelper *s) {
+  separate();
+  writeEscaped((const char*)s, true);
+}
+
+void JsonWriter::value(long n) {
+  char buf[WM_JSON_NUMBER_LEN];
+  separate();
+  _out.write((const uint8_t*)buf, formatInt(n, buf));
+}
+
+void JsonWriter::value(unsigned long n) {
+  char buf[WM_JSON_NUMBER_LEN];
+  separate();
+  _out.write((const uint8_t*)buf, formatUInt(n, buf));
+}
+
+void JsonWriter::value(boolean b) {
+  separate();
+  if (b) _out.print(F("true"));
+  else   _out.print(F("false"));
+}
+
+void JsonWriter::value(const IPAddress &ip) {
+  char buf[16];
+  size_t len = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (i) buf[len++] = '.';
+    len += formatUInt(ip[i], buf + len);
+  }
+  separate();
+  _out.write('"');
+  _out.write((const uint8_t*)buf, len);
+  _out.write('"');
+}
+
+void JsonWriter::null() {
+  separate();
+  _out.print(F("null"));
+}
+
+size_t JsonWriter::formatUInt(unsigned long n, char *buf) {
+  char tmp[3 * sizeof(unsigned long)]; // 10 digits on the module, 20 where long is 64 bit
+  size_t len = 0;
+  do {
+    tmp[len++] = '0' + n % 10;
+    n /= 10;
+  } while (n);
+  for (size_t i = 0; i < len; i++) buf[i] = tmp[len - 1 - i];
+  buf[len] = '\0';
+  return len;
+}
+
+size_t JsonWriter::formatInt(long n, char *buf) {
+  if (n >= 0) return formatUInt(n, buf);
+  buf[0] = '-';
+  return formatUInt(0UL - (unsigned long)n, buf + 1) + 1;
+}
+
+//quoted and escaped per RFC 8259, bytes >= 0x80 (UTF-8) pass through
+void JsonWriter::writeEscaped(const char *s, boolean progmem) {
+  static const char hex[] = "0123456789abcdef";
+  _out.write('"');
+  const char *run = s;  // start of the bytes that need no escaping
+  for (;; s++) {
+    char c = progmem ? pgm_read_byte(s) : *s;
+    if (c != '\0' && c != '"' && c != '\\' && (uint8_t)c >= 0x20) {
+      if (progmem) _out.write(c); // flash strings go out byte by byte
+      continue;
+    }
+    if (!progmem && s > run) _out.write((const uint8_t*)run, s - run);
+    if (c == '\0') break;
+    char esc[6] = { '\\', c, 0, 0, 0, 0 };
+    size_t len = 2;
+    switch (c) {
+      case '"':  case '\\': break;
+      case '\n': esc[1] = 'n'; break;
+      case '\r': esc[1] = 'r'; break;
+      case '\t': esc[1] = 't'; break;
+      case '\b': esc[1] = 'b'; break;
+      case '\f': esc[1] = 'f'; break;
+      default:
+        esc[1] = 'u'; esc[2] = '0'; esc[3] = '0';
+        esc[4] = hex[(uint8_t)c >> 4];
+        esc[5] = hex[c & 0x0F];
+        len = 6;
+    }
+    _out.write((const uint8_t*)esc, len);
+    run = s + 1;
+  }
+  _out.write('"');
+}
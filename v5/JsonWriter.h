@@ -0,0 +1,57 @@
+/**************************************************************
+   JsonWriter streams JSON into any Print, normally a ChunkedPrint
+   so the document goes out in fixed size chunks while it is
+   written. Strings are escaped, numbers are formatted in place,
+   commas between members and elements are inserted automatically.
+   Nothing is allocated on the heap.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef JsonWriter_h
+#define JsonWriter_h
+#include <Arduino.h>
+
+#define WM_JSON_DEPTH 16 // deepest object/array nesting
+#define WM_JSON_NUMBER_LEN (3 * sizeof(long) + 2) // sign, digits and NUL of any long, 14 on the module
+
+class JsonWriter {
+  public:
+    JsonWriter(Print &out) : _out(out) {}
+
+    void          beginObject();
+    void          endObject();
+    void          beginArray();
+    void          endArray();
+    //member name inside an object, the value (or a nested object/array) follows
+    void          key(const char *name);
+
+    void          value(const char *s);
+    void          value(const __FlashStringHelper *s);
+    void          value(long n);
+    void          value(unsigned long n);
+    void          value(int n)          { value((long)n); }
+    void          value(unsigned int n) { value((unsigned long)n); }
+    void          value(boolean b);
+    void          value(const IPAddress &ip);
+    void          null();
+
+    //key(name) followed by value(v)
+    template <typename T>
+    void          member(const char *name, T v) { key(name); value(v); }
+
+    //decimal text of n into buf (WM_JSON_NUMBER_LEN bytes is enough), returns its length
+    static size_t formatInt(long n, char *buf);
+    static size_t formatUInt(unsigned long n, char *buf);
+
+  private:
+    Print         &_out;
+    uint16_t      _used  = 0;   // one bit per level, set once the level holds an item
+    uint8_t       _depth = 0;
+    boolean       _afterKey = false;
+
+    void          separate();
+    void          open(char c);
+    void          close(char c);
+    void          writeEscaped(const char *s, boolean progmem);
+};
+#endif
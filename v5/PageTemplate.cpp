@@ -0,0 +1,36 @@
+/**************************************************************
+   PageTemplate - compile time placeholder templates for the portal
+   Licensed under MIT license
+ **************************************************************/
+
+#include "PageTemplate.h"
+
+void printP(Print &out, PGM_P text, size_t len) {
+  uint8_t buf[32];
+  while (len > 0) {
+    size_t n = (len > sizeof(buf)) ? sizeof(buf) : len;
+    memcpy_P(buf, text, n);
+    out.write(buf, n);
+    text += n;
+    len -= n;
+  }
+}
+
+void renderTemplate(Print &out, const PageTemplate &tpl, const TemplateArg *args, uint8_t argCount) {
+  uint16_t pos = 0;
+  for (uint8_t i = 0; i < tpl.count; i++) {
+    printP(out, tpl.text + pos, tpl.at[i] - pos);
+    for (uint8_t a = 0; a < argCount; a++) {
+      if (args[a].key == tpl.key[i]) {
+        if (args[a].value != NULL) out.print(args[a].value);
+        break;
+      }
+    }
+    pos = tpl.at[i] + 3;
+  }
+  printP(out, tpl.text + pos, tpl.length - pos);
+}
+
+void renderTemplate(Print &out, const PageTemplate &tpl, std::initializer_list<TemplateArg> args) {
+  renderTemplate(out, tpl, args.begin(), args.size());
+}
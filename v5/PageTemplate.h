@@ -0,0 +1,70 @@
+/**************************************************************
+   PageTemplate resolves the "{x}" placeholders of the PROGMEM
+   HTTP_* fragments at compile time. A template is a table of
+   placeholder offsets and keys built by constexpr functions, so
+   rendering is one pass that copies the flash segments between the
+   placeholders and prints the values in their place. Nothing is
+   copied into a String and nothing is searched at run time.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef PageTemplate_h
+#define PageTemplate_h
+#include <Arduino.h>
+#include <initializer_list>
+
+#define WM_TEMPLATE_MAX_SLOTS 8 // placeholders a single template may hold
+
+namespace wm_template {
+  // a placeholder is '{', one lower case letter, '}'
+  constexpr bool isSlot(const char *s, int i) {
+    return s[i] == '{' && s[i + 1] >= 'a' && s[i + 1] <= 'z' && s[i + 2] == '}';
+  }
+  constexpr int length(const char *s, int i = 0) {
+    return s[i] == 0 ? i : length(s, i + 1);
+  }
+  constexpr int count(const char *s, int i = 0) {
+    return s[i] == 0 ? 0 : isSlot(s, i) ? 1 + count(s, i + 3) : count(s, i + 1);
+  }
+  // offset of the n-th placeholder, -1 if there is none
+  constexpr int slot(const char *s, int n, int i = 0) {
+    return s[i] == 0 ? -1 : isSlot(s, i) ? (n == 0 ? i : slot(s, n - 1, i + 3)) : slot(s, n, i + 1);
+  }
+  constexpr char key(const char *s, int n) {
+    return slot(s, n) < 0 ? 0 : s[slot(s, n) + 1];
+  }
+}
+
+struct PageTemplate {
+  PGM_P    text;
+  uint16_t length;
+  uint8_t  count;
+  int16_t  at[WM_TEMPLATE_MAX_SLOTS];  // offset of each placeholder in text
+  char     key[WM_TEMPLATE_MAX_SLOTS]; // letter of each placeholder
+};
+
+constexpr PageTemplate makeTemplate(const char *s) {
+  using namespace wm_template;
+  return PageTemplate{ s, (uint16_t)length(s), (uint8_t)count(s),
+    { (int16_t)slot(s, 0), (int16_t)slot(s, 1), (int16_t)slot(s, 2), (int16_t)slot(s, 3),
+      (int16_t)slot(s, 4), (int16_t)slot(s, 5), (int16_t)slot(s, 6), (int16_t)slot(s, 7) },
+    { key(s, 0), key(s, 1), key(s, 2), key(s, 3), key(s, 4), key(s, 5), key(s, 6), key(s, 7) } };
+}
+
+// declares a template over a constexpr PROGMEM fragment
+#define WM_TEMPLATE(name, text) \
+  constexpr PageTemplate name = makeTemplate(text); \
+  static_assert(name.count <= WM_TEMPLATE_MAX_SLOTS, "too many placeholders in " #text)
+
+// value printed in place of the placeholder {key}
+struct TemplateArg {
+  char        key;
+  const char *value;
+};
+
+//copy len bytes of PROGMEM to out through a small stack buffer
+void printP(Print &out, PGM_P text, size_t len);
+//print tpl with every placeholder replaced by the value of the matching argument, unknown keys print nothing
+void renderTemplate(Print &out, const PageTemplate &tpl, const TemplateArg *args, uint8_t argCount);
+void renderTemplate(Print &out, const PageTemplate &tpl, std::initializer_list<TemplateArg> args);
+#endif
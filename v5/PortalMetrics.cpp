@@ -0,0 +1,81 @@
+/**************************************************************
+   PortalMetrics - latency histograms and Prometheus text output for the config portal
+   Licensed under MIT license
+ **************************************************************/
+
+#include "PortalMetrics.h"
+
+void LatencyHistogram::record(uint32_t us) {
+  uint32_t bound = _first;
+  for (uint8_t i = 0; i < WM_METRIC_BUCKETS; i++, bound <<= 2) {
+    if (us <= bound) {
+      _bucket[i]++;
+      break;
+    }
+  }
+  _count++;
+  _sumUs += us;
+}
+
+void LatencyHistogram::print(Print &out, const char *name, const char *labels) const {
+  uint32_t cumulative = 0;
+  uint32_t bound = _first;
+  for (uint8_t i = 0; i <= WM_METRIC_BUCKETS; i++, bound <<= 2) {
+    out.print(name);
+    out.print(F("_bucket{"));
+    if (labels) {
+      out.print(labels);
+      out.print(',');
+    }
+    out.print(F("le=\""));
+    if (i < WM_METRIC_BUCKETS) {
+      cumulative += _bucket[i];
+      printSeconds(out, bound);
+    } else {
+      cumulative = _count;
+      out.print(F("+Inf"));
+    }
+    out.print(F("\"} "));
+    out.print(cumulative);
+    out.print('\n');
+  }
+  out.print(name);
+  out.print(F("_sum"));
+  printLabels(out, labels);
+  printSeconds(out, _sumUs);
+  out.print('\n');
+  out.print(name);
+  out.print(F("_count"));
+  printLabels(out, labels);
+  out.print(_count);
+  out.print('\n');
+}
+
+//"{labels} " or just the separating space
+void LatencyHistogram::printLabels(Print &out, const char *labels) {
+  if (labels) {
+    out.print('{');
+    out.print(labels);
+    out.print('}');
+  }
+  out.print(' ');
+}
+
+void printSeconds(Print &out, uint64_t us) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lu.%06lu", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000));
+  out.print(buf);
+}
+
+void printMetricHeader(Print &out, const char *name, const char *type, const char *help) {
+  out.print(F("# HELP "));
+  out.print(name);
+  out.print(' ');
+  out.print(help);
+  out.print('\n');
+  out.print(F("# TYPE "));
+  out.print(name);
+  out.print(' ');
+  out.print(type);
+  out.print('\n');
+}
@@ -0,0 +1,37 @@
+/**************************************************************
+   PortalMetrics keeps fixed size, log bucketed latency histograms
+   and writes them in the Prometheus text exposition format.
+   Lines end in a bare \n as that format requires, so println()
+   (which adds \r\n) is not used for metrics output.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef PortalMetrics_h
+#define PortalMetrics_h
+#include <Arduino.h>
+
+#define WM_METRIC_BUCKETS 8 // histogram buckets, each bound is 4x the one before
+
+class LatencyHistogram {
+  public:
+    LatencyHistogram(uint32_t firstBoundUs = 500) : _first(firstBoundUs) {}
+
+    void          record(uint32_t us);
+    uint32_t      count() const { return _count; }
+    //bucket, sum and count lines of one Prometheus histogram series, labels like "route=\"/\"" or NULL
+    void          print(Print &out, const char *name, const char *labels) const;
+
+  private:
+    uint32_t      _first;
+    uint32_t      _bucket[WM_METRIC_BUCKETS] = {}; // not cumulative, print() adds them up
+    uint32_t      _count = 0;
+    uint64_t      _sumUs = 0;
+
+    static void   printLabels(Print &out, const char *labels);
+};
+
+//µs as decimal seconds, "0.000500"
+void printSeconds(Print &out, uint64_t us);
+//"# HELP" and "# TYPE" lines of a metric family
+void printMetricHeader(Print &out, const char *name, const char *type, const char *help);
+#endif
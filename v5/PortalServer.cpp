@@ -0,0 +1,643 @@
+/**************************************************************
+   PortalServer - pooled, interleaving connection layer for the config portal
+   Licensed under MIT license
+ **************************************************************/
+
+#include "PortalServer.h"
+#include "ChunkedPrint.h"
+#include <Hash.h>
+
+#define WS_OP_TEXT   0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE  0x8
+#define WS_OP_PING   0x9
+#define WS_OP_PONG   0xA
+
+void PortalServer::handleClients() {
+  acceptClients();
+
+  // requests are short, answer all of them before any bulk slice goes out
+  for (uint8_t i = 0; i < WM_HTTP_SLOTS; i++) {
+    Slot &slot = _slots[i];
+    if (slot.state != SLOT_READ) continue;
+    if (!slot.client.connected()) {
+      release(slot);
+    } else if (slot.client.available()) {
+      serviceRequest(i);
+    } else if (millis() - slot.since > HTTP_MAX_DATA_WAIT) {
+      release(slot);
+    }
+  }
+
+  for (uint8_t k = 0; k < WM_HTTP_SLOTS; k++) {
+    Slot &slot = _slots[(_next + k) % WM_HTTP_SLOTS];
+    if (slot.state == SLOT_SEND) {
+      sendSlice(slot);
+    } else if (slot.state == SLOT_CLOSE) {
+      if (!slot.client.connected() || millis() - slot.since > HTTP_MAX_CLOSE_WAIT) {
+        release(slot);
+      }
+    } else if (slot.state == SLOT_EVENTS) {
+      keepEventAlive(slot);
+    } else if (slot.state == SLOT_SOCKET) {
+      serviceSocket((_next + k) % WM_HTTP_SLOTS);
+    }
+  }
+  _next = (_next + 1) % WM_HTTP_SLOTS;
+}
+
+void PortalServer::acceptClients() {
+  for (uint8_t i = 0; i < WM_HTTP_SLOTS; i++) {
+    if (_slots[i].state != SLOT_FREE) continue;
+    // connections beyond the pool wait in the listen backlog
+    WiFiClient client = _server.available();
+    if (!client) return;
+    _slots[i].client = client;
+    _slots[i].state = SLOT_READ;
+    _slots[i].since = millis();
+  }
+}
+
+// connectivity probes, path and (if not NULL) Host of the request have to match
+struct ProbeEntry {
+  const char *host;
+  const char *path;
+};
+static const char probeGstatic[] PROGMEM  = "/generate_204";
+static const char probeGen204[] PROGMEM   = "/gen_204";
+static const char probeApple[] PROGMEM    = "/hotspot-detect.html";
+static const char probeAppleOld[] PROGMEM = "/library/test/success.html";
+static const char probeNcsi[] PROGMEM     = "/ncsi.txt";
+static const char probeMsft[] PROGMEM     = "/connecttest.txt";
+static const char probeMsftHost[] PROGMEM = "www.msftconnecttest.com";
+static const char probeRedirect[] PROGMEM = "/redirect";
+static const char probeFfxHost[] PROGMEM  = "detectportal.firefox.com";
+static const char probeFfx[] PROGMEM      = "/success.txt";
+static const char probeFfxPage[] PROGMEM  = "/canonical.html";
+static const char probeKindle[] PROGMEM   = "/kindle-wifi/wifistub.html";
+static const char probeGnomeHost[] PROGMEM = "nmcheck.gnome.org";
+static const char probeGnome[] PROGMEM    = "/check_network_status.txt";
+static const ProbeEntry probes[] PROGMEM = {
+  { NULL,           probeGstatic },  // Android, ChromeOS
+  { NULL,           probeGen204 },
+  { NULL,           probeApple },    // iOS, macOS
+  { NULL,           probeAppleOld },
+  { NULL,           probeNcsi },     // Windows
+  { NULL,           probeMsft },
+  { probeMsftHost,  probeRedirect },
+  { probeFfxHost,   probeFfx },      // Firefox
+  { probeFfxHost,   probeFfxPage },
+  { NULL,           probeKindle },
+  { probeGnomeHost, probeGnome },    // NetworkManager
+};
+
+//answers slot from flash when its request is a known probe, false leaves the request untouched
+boolean PortalServer::answerProbe(Slot &slot) {
+  char head[WM_PROBE_PEEK + 1];
+  size_t len = slot.client.peekBytes((uint8_t*)head, WM_PROBE_PEEK);
+  head[len] = '\0';
+  if (strncmp(head, "GET ", 4) != 0) return false;
+  char *path = head + 4;
+  char *pathEnd = path + strcspn(path, " ?\r\n");
+  if (*pathEnd == '\0') return false; // request line longer than what we peeked
+  char *host = strstr(pathEnd, "\r\nHost:");
+  if (host) {
+    host += 7;
+    while (*host == ' ') host++;
+    host[strcspn(host, ":\r\n")] = '\0'; // drop the port
+  }
+  *pathEnd = '\0';
+
+  for (uint8_t i = 0; i < sizeof(probes) / sizeof(probes[0]); i++) {
+    const char *probePath = (const char*)pgm_read_ptr(&probes[i].path);
+    const char *probeHost = (const char*)pgm_read_ptr(&probes[i].host);
+    if (strcmp_P(path, probePath) != 0) continue;
+    if (probeHost && (!host || strcasecmp_P(host, probeHost) != 0)) continue;
+    slot.client.write_P(_probeResponse, strlen_P(_probeResponse));
+    return true;
+  }
+  return false;
+}
+
+static const char uploadBusy[] PROGMEM = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\n"
+                                          "Content-Length: 0\r\nConnection: close\r\n\r\n";
+
+//the request waiting in slot is a POST or PUT to a route with an upload handler,
+//told from its request line like a probe
+boolean PortalServer::isUpload(Slot &slot) {
+  char head[WM_PROBE_PEEK + 1];
+  size_t len = slot.client.peekBytes((uint8_t*)head, WM_PROBE_PEEK);
+  head[len] = '\0';
+  char *path = strchr(head, ' ');
+  if (!path) return false;
+  *path++ = '\0';
+  if (strcmp(head, "POST") != 0 && strcmp(head, "PUT") != 0) return false;
+  path[strcspn(path, " ?\r\n")] = '\0';
+  for (uint8_t i = 0; i < _uploadCount; i++) {
+    if (strcmp(path, _uploadRoutes[i]) == 0) return true;
+  }
+  return false;
+}
+
+//a slot other than except is sending a body or has a request waiting
+boolean PortalServer::poolBusy(uint8_t except) {
+  for (uint8_t i = 0; i < WM_HTTP_SLOTS; i++) {
+    if (i == except) continue;
+    if (_slots[i].state == SLOT_SEND) return true;
+    if (_slots[i].state == SLOT_READ && _slots[i].client.available()) return true;
+  }
+  return false;
+}
+
+void PortalServer::serviceRequest(uint8_t i) {
+  Slot &slot = _slots[i];
+  slot.state = SLOT_CLOSE;
+  slot.since = millis();
+  if (_probeResponse) {
+    unsigned long started = micros();
+    if (answerProbe(slot)) {
+      _routes[1].latency.record(micros() - started);
+      _routes[1].bytes += strlen_P(_probeResponse);
+      return;
+    }
+  }
+  // an upload body is read in one go, it has to wait until nobody else is being served
+  if (_uploadCount && isUpload(slot) && poolBusy(i)) {
+    slot.client.write_P(uploadBusy, strlen_P(uploadBusy));
+    return;
+  }
+  _currentClient = slot.client;
+  _serving = i;
+  _route = 0;
+  _sentBytes = 0;
+  uint32_t heapBefore = ESP.getFreeHeap();
+  uint32_t chunkedBefore = ChunkedPrint::totalSent();
+  unsigned long started = micros();
+  if (_parseRequest(_currentClient)) {
+    _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
+    _contentLength = CONTENT_LENGTH_NOT_SET;
+    _handleRequest();
+    // parse (uploads included) and handler, a deferred body only adds its bytes later
+    RouteStats &route = _routes[_route];
+    uint32_t heapAfter = ESP.getFreeHeap();
+    route.latency.record(micros() - started);
+    route.bytes += _sentBytes + (ChunkedPrint::totalSent() - chunkedBefore);
+    route.heapDelta = (int32_t)(heapAfter - heapBefore);
+    if (heapAfter < _heapLow) _heapLow = heapAfter;
+    slot.route = _route;
+  } else {
+    release(slot);
+  }
+  _serving = -1;
+  _currentClient = WiFiClient();
+}
+
+boolean PortalServer::deferFile(File &file, size_t start, size_t len, boolean shared) {
+  if (_serving < 0) return false;
+  Slot &slot = _slots[_serving];
+  slot.file = file;
+  if (!shared) file = File();
+  slot.shared = shared;
+  slot.offset = start;
+  slot.file.seek(start, SeekSet);
+  slot.remaining = len;
+  slot.state = SLOT_SEND;
+  return true;
+}
+
+void PortalServer::sendSlice(Slot &slot) {
+  if (!slot.client.connected()) {
+    release(slot);
+    return;
+  }
+  // only what the socket takes right now, a slow reader must not stall the loop
+  size_t n = slot.client.availableForWrite();
+  if (n == 0) return;
+  uint8_t buf[WM_HTTP_SLICE];
+  if (n > sizeof(buf)) n = sizeof(buf);
+  if (n > slot.remaining) n = slot.remaining;
+  // another slot may have moved a shared handle since the last slice
+  if (slot.shared) slot.file.seek(slot.offset, SeekSet);
+  n = slot.file.read(buf, n);
+  if (n > 0) {
+    slot.client.write((const uint8_t*)buf, n);
+    slot.offset += n;
+    slot.remaining -= n;
+    _routes[slot.route].bytes += n;
+  }
+  if (n == 0 || slot.remaining == 0) {
+    closeFile(slot);
+    slot.state = SLOT_CLOSE;
+    slot.since = millis();
+  }
+}
+
+boolean PortalServer::beginEvents() {
+  if (_serving < 0 || eventClients() + socketClients() >= WM_EVENT_CLIENTS) return false;
+  Slot &slot = _slots[_serving];
+  char head[160];
+  int n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                   "Cache-Control: no-cache\r\nConnection: keep-alive\r\n\r\nretry: %d\n\n", WM_EVENT_RETRY);
+  slot.client.write((const uint8_t*)head, n);
+  slot.client.setNoDelay(true);
+  slot.state = SLOT_EVENTS;
+  slot.since = millis();
+  return true;
+}
+
+//whole event or nothing, a subscriber without room for it is released
+boolean PortalServer::writeEvent(Slot &slot, const char *event, const char *data) {
+  size_t eventLen = strlen(event);
+  size_t dataLen = strlen(data);
+  size_t total = eventLen + dataLen + 16; // "event: " "\ndata: " "\n\n"
+  if (!slot.client.connected() || slot.client.availableForWrite() < total) {
+    release(slot);
+    return false;
+  }
+  slot.client.write((const uint8_t*)"event: ", 7);
+  slot.client.write((const uint8_t*)event, eventLen);
+  slot.client.write((const uint8_t*)"\ndata: ", 7);
+  slot.client.write((const uint8_t*)data, dataLen);
+  slot.client.write((const uint8_t*)"\n\n", 2);
+  slot.since = millis();
+  return true;
+}
+
+uint8_t PortalServer::sendEvent(const char *event, const char *data) {
+  uint8_t reached = 0;
+  for (uint8_t i = 0; i < WM_HTTP_SLOTS; i++) {
+    Slot &slot = _slots[i];
+    if (slot.state != SLOT_EVENTS) continue;
+    if (writeEvent(slot, event, data)) reached++;
+  }
+  return reached;
+}
+
+boolean PortalServer::eventReply(const char *event, const char *data) {
+  if (_serving < 0 || _slots[_serving].state != SLOT_EVENTS) return false;
+  return writeEvent(_slots[_serving], event, data);
+}
+
+void PortalServer::keepEventAlive(Slot &slot) {
+  if (!slot.client.connected()) {
+    release(slot);
+    return;
+  }
+  while (slot.client.available()) slot.client.read(); // subscribers have nothing to say
+  if (millis() - slot.since < WM_EVENT_KEEPALIVE) return;
+  if (slot.client.availableForWrite() < 2) {
+    release(slot);
+    return;
+  }
+  slot.client.write((const uint8_t*)":\n", 2);
+  slot.since = millis();
+}
+
+uint8_t PortalServer::eventClients() {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < WM_HTTP_SLOTS; i++) {
+    if (_slots[i].state == SLOT_EVENTS) count++;
+  }
+  return count;
+}
+
+boolean PortalServer::beginSocket() {
+  if (_serving < 0 || eventClients() + socketClients() >= WM_EVENT_CLIENTS) return false;
+  RequestView req = request();
+  const char *key = req.header("Sec-WebSocket-Key");
+  if (strcasecmp(req.header("Upgrade"), "websocket") != 0 || strlen(key) != 24
+      || strcmp(req.header("Sec-WebSocket-Version"), "13") != 0) {
+    return false;
+  }
+
+  // Sec-WebSocket-Accept = base64(sha1(key + GUID)), RFC 6455 4.2.2
+  static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+  static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  char keyed[24 + sizeof(guid)];
+  memcpy(keyed, key, 24);
+  memcpy(keyed + 24, guid, sizeof(guid));
+  uint8_t digest[20];
+  sha1((uint8_t*)keyed, 24 + sizeof(guid) - 1, digest);
+  char accept[29];
+  uint8_t o = 0;
+  for (uint8_t i = 0; i < 20; i += 3) {
+    uint32_t v = (uint32_t)digest[i] << 16 | (i + 1 < 20 ? digest[i + 1] << 8 : 0) | (i + 2 < 20 ? digest[i + 2] : 0);
+    accept[o++] = b64[(v >> 18) & 0x3F];
+    accept[o++] = b64[(v >> 12) & 0x3F];
+    accept[o++] = (i + 1 < 20) ? b64[(v >> 6) & 0x3F] : '=';
+    accept[o++] = (i + 2 < 20) ? b64[v & 0x3F] : '=';
+  }
+  accept[o] = '\0';
+
+  Slot &slot = _slots[_serving];
+  char head[160];
+  int n = snprintf(head, sizeof(head), "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                   "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", accept);
+  slot.client.write((const uint8_t*)head, n);
+  slot.client.setNoDelay(true);
+  slot.state = SLOT_SOCKET;
+  slot.since = millis();
+  slot.pending = 0;
+  return true;
+}
+
+void PortalServer::serviceSocket(uint8_t i) {
+  Slot &slot = _slots[i];
+  if (!slot.client.connected()) {
+    release(slot);
+    return;
+  }
+  _serving = i;
+  // a socket that owes us state is refreshed before it may send anything new,
+  // so a client flooding toggles is throttled by its own reading speed
+  for (uint8_t key = 0; slot.pending && key < 32; key++) {
+    if (!(slot.pending & (1UL << key))) continue;
+    slot.pending &= ~(1UL << key);
+    if (_socketRefresh) _socketRefresh(key);
+    if (slot.pending & (1UL << key)) break; // still no room
+  }
+  if (!slot.pending && slot.client.available() >= 2) {
+    if (!readSocketFrame(slot)) release(slot);
+  } else if (slot.state == SLOT_SOCKET && millis() - slot.since > WM_EVENT_KEEPALIVE) {
+    writeSocketFrame(slot, WS_OP_PING, NULL, 0);
+  }
+  _serving = -1;
+}
+
+//reads and handles one client frame, false when the socket has to go
+boolean PortalServer::readSocketFrame(Slot &slot) {
+  uint8_t head[2];
+  slot.client.setTimeout(100);
+  if (slot.client.readBytes((char*)head, 2) != 2) return false;
+  uint8_t opcode = head[0] & 0x0F;
+  size_t len = head[1] & 0x7F;
+  // client frames are masked and, here, small and never fragmented
+  if (!(head[0] & 0x80) || !(head[1] & 0x80) || len > WM_SOCKET_PAYLOAD) {
+    uint8_t status[2] = { 0x03, 0xF1 }; // 1009 message too big
+    writeSocketFrame(slot, WS_OP_CLOSE, status, sizeof(status));
+    return false;
+  }
+  uint8_t mask[4];
+  uint8_t payload[WM_SOCKET_PAYLOAD];
+  if (slot.client.readBytes((char*)mask, 4) != 4) return false;
+  if (len && slot.client.readBytes((char*)payload, len) != len) return false;
+  for (size_t i = 0; i < len; i++) payload[i] ^= mask[i & 3];
+  slot.since = millis();
+
+  switch (opcode) {
+    case WS_OP_BINARY:
+    case WS_OP_TEXT:
+      if (_socketMessage) _socketMessage(payload, len);
+      return true;
+    case WS_OP_PING:
+      writeSocketFrame(slot, WS_OP_PONG, payload, len);
+      return true;
+    case WS_OP_PONG:
+      return true;
+    case WS_OP_CLOSE:
+      writeSocketFrame(slot, WS_OP_CLOSE, payload, len > 2 ? 2 : len);
+      return false;
+    default:
+      return false;
+  }
+}
+
+boolean PortalServer::writeSocketFrame(Slot &slot, uint8_t opcode, const uint8_t *payload, size_t len) {
+  uint8_t head[4];
+  size_t headLen = 2;
+  head[0] = 0x80 | opcode;
+  if (len < 126) {
+    head[1] = len;
+  } else {
+    head[1] = 126;
+    head[2] = len >> 8;
+    head[3] = len & 0xFF;
+    headLen = 4;
+  }
+  if (slot.client.availableForWrite() < headLen + len) return false;
+  slot.client.write((const uint8_t*)head, headLen);
+  if (len) slot.client.write(payload, len);
+  slot.since = millis();
+  return true;
+}
+
+boolean PortalServer::socketReply(const uint8_t *payload, size_t len, uint8_t key) {
+  if (_serving < 0 || _slots[_serving].state != SLOT_SOCKET) return false;
+  Slot &slot = _slots[_serving];
+  if (writeSocketFrame(slot, WS_OP_BINARY, payload, len)) return true;
+  slot.pending |= 1UL << (key & 31);
+  return false;
+}
+
+uint8_t PortalServer::socketBroadcast(const uint8_t *payload, size_t len, uint8_t key) {
+  uint8_t reached = 0;
+  for (uint8_t i = 0; i < WM_HTTP_SLOTS; i++) {
+    Slot &slot = _slots[i];
+    if (slot.state != SLOT_SOCKET) continue;
+    // an older message for the same key would only be overtaken, refresh it later instead
+    if (!(slot.pending & (1UL << (key & 31))) && writeSocketFrame(slot, WS_OP_BINARY, payload, len)) {
+      reached++;
+    } else {
+      slot.pending |= 1UL << (key & 31);
+    }
+  }
+  return reached;
+}
+
+uint8_t PortalServer::socketClients() {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < WM_HTTP_SLOTS; i++) {
+    if (_slots[i].state == SLOT_SOCKET) count++;
+  }
+  return count;
+}
+
+//a shared handle is only let go of, its owner keeps using it
+void PortalServer::closeFile(Slot &slot) {
+  if (slot.file && !slot.shared) slot.file.close();
+  slot.file = File();
+  slot.shared = false;
+}
+
+void PortalServer::release(Slot &slot) {
+  closeFile(slot);
+  slot.client.stop();
+  slot.client = WiFiClient();
+  slot.state = SLOT_FREE;
+  slot.pending = 0;
+}
+
+uint8_t PortalServer::activeClients() {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < WM_HTTP_SLOTS; i++) {
+    if (_slots[i].state != SLOT_FREE) count++;
+  }
+  return count;
+}
+
+const String* PortalServer::RequestView::find(const char *name) const {
+  for (int i = 0; i < _server->_currentArgCount; i++) {
+    if (strcmp(_server->_currentArgs[i].key.c_str(), name) == 0) return &_server->_currentArgs[i].value;
+  }
+  return NULL;
+}
+
+const char* PortalServer::RequestView::arg(const char *name) const {
+  const String *value = find(name);
+  return value ? value->c_str() : "";
+}
+
+const char* PortalServer::RequestView::arg(int i) const {
+  if (i < 0 || i >= _server->_currentArgCount) return "";
+  return _server->_currentArgs[i].value.c_str();
+}
+
+const char* PortalServer::RequestView::argName(int i) const {
+  if (i < 0 || i >= _server->_currentArgCount) return "";
+  return _server->_currentArgs[i].key.c_str();
+}
+
+int PortalServer::RequestView::args() const {
+  return _server->_currentArgCount;
+}
+
+boolean PortalServer::RequestView::hasArg(const char *name) const {
+  return find(name) != NULL;
+}
+
+boolean PortalServer::RequestView::argIs(const char *name, const char *value) const {
+  const String *found = find(name);
+  return found && strcmp(found->c_str(), value) == 0;
+}
+
+long PortalServer::RequestView::argInt(const char *name, long fallback) const {
+  const String *value = find(name);
+  if (!value || value->length() == 0) return fallback;
+  char *end;
+  long n = strtol(value->c_str(), &end, 10);
+  return (*end == '\0') ? n : fallback;
+}
+
+boolean PortalServer::RequestView::argBool(const char *name, boolean fallback) const {
+  const String *value = find(name);
+  if (!value) return fallback;
+  const char *v = value->c_str();
+  if (!strcasecmp(v, "1") || !strcasecmp(v, "true") || !strcasecmp(v, "on") || !strcasecmp(v, "yes")) return true;
+  if (!strcasecmp(v, "0") || !strcasecmp(v, "false") || !strcasecmp(v, "off") || !strcasecmp(v, "no")) return false;
+  return fallback;
+}
+
+boolean PortalServer::RequestView::argIP(const char *name, IPAddress &ip) const {
+  const String *value = find(name);
+  if (!value || value->length() == 0) return false;
+  IPAddress parsed;
+  if (!parsed.fromString(value->c_str())) return false;
+  ip = parsed;
+  return true;
+}
+
+size_t PortalServer::RequestView::argCopy(const char *name, char *buf, size_t size) const {
+  if (size == 0) return 0;
+  const String *value = find(name);
+  size_t n = value ? value->length() : 0;
+  if (n > size - 1) n = size - 1;
+  if (n) memcpy(buf, value->c_str(), n);
+  buf[n] = '\0';
+  return n;
+}
+
+const char* PortalServer::RequestView::header(const char *name) const {
+  for (int i = 0; i < _server->_headerKeysCount; i++) {
+    if (strcasecmp(_server->_currentHeaders[i].key.c_str(), name) == 0) return _server->_currentHeaders[i].value.c_str();
+  }
+  return "";
+}
+
+PortalServer::THandlerFunction PortalServer::track(const char *uri, HTTPMethod method, THandlerFunction handler) {
+  uint8_t index = 0;
+  if (_routeCount < WM_ROUTE_METRICS) {
+    index = _routeCount++;
+    _routes[index].uri = uri;
+    _routes[index].method = method;
+  }
+  return [this, index, handler]() {
+    _route = index;
+    handler();
+  };
+}
+
+void PortalServer::on(const char *uri, THandlerFunction handler) {
+  on(uri, HTTP_ANY, handler);
+}
+
+void PortalServer::on(const char *uri, HTTPMethod method, THandlerFunction handler) {
+  ESP8266WebServer::on(uri, method, track(uri, method, handler));
+}
+
+void PortalServer::on(const char *uri, HTTPMethod method, THandlerFunction handler, THandlerFunction upload) {
+  if (_uploadCount < WM_UPLOAD_ROUTES) _uploadRoutes[_uploadCount++] = uri;
+  ESP8266WebServer::on(uri, method, track(uri, method, handler), upload);
+}
+
+void PortalServer::onNotFound(THandlerFunction handler) {
+  ESP8266WebServer::onNotFound(track("(not_found)", HTTP_ANY, handler));
+}
+
+void PortalServer::send(int code, const char *contentType, const String &content) {
+  _sentBytes += content.length();
+  ESP8266WebServer::send(code, contentType, content);
+}
+
+void PortalServer::sendBody(int code, const char *contentType, const uint8_t *body, size_t len) {
+  setContentLength(len);
+  ESP8266WebServer::send(code, contentType, "");
+  WiFiClient c = client();
+  _sentBytes += c.write(body, len);
+}
+
+void PortalServer::routeLabels(uint8_t i, char *buf, size_t size) {
+  static const char* const methods[] = { "ANY", "GET", "POST", "PUT", "PATCH", "DELETE", "OPTIONS" };
+  uint8_t method = _routes[i].method;
+  snprintf(buf, size, "route=\"%s\",method=\"%s\"", _routes[i].uri, method < 7 ? methods[method] : "ANY");
+}
+
+void PortalServer::writeMetrics(Print &out) {
+  char labels[80];
+
+  printMetricHeader(out, "wm_http_requests_total", "counter", "Requests answered per route.");
+  for (uint8_t i = 0; i < _routeCount; i++) {
+    routeLabels(i, labels, sizeof(labels));
+    out.print(F("wm_http_requests_total{"));
+    out.print(labels);
+    out.print(F("} "));
+    out.print(_routes[i].latency.count());
+    out.print('\n');
+  }
+  printMetricHeader(out, "wm_http_response_bytes_total", "counter", "Response body bytes sent per route.");
+  for (uint8_t i = 0; i < _routeCount; i++) {
+    routeLabels(i, labels, sizeof(labels));
+    out.print(F("wm_http_response_bytes_total{"));
+    out.print(labels);
+    out.print(F("} "));
+    out.print(_routes[i].bytes);
+    out.print('\n');
+  }
+  printMetricHeader(out, "wm_http_heap_delta_bytes", "gauge", "Free heap change over the last request per route.");
+  for (uint8_t i = 0; i < _routeCount; i++) {
+    routeLabels(i, labels, sizeof(labels));
+    out.print(F("wm_http_heap_delta_bytes{"));
+    out.print(labels);
+    out.print(F("} "));
+    out.print(_routes[i].heapDelta);
+    out.print('\n');
+  }
+  printMetricHeader(out, "wm_http_request_duration_seconds", "histogram", "Time from request to handler return per route.");
+  for (uint8_t i = 0; i < _routeCount; i++) {
+    routeLabels(i, labels, sizeof(labels));
+    _routes[i].latency.print(out, "wm_http_request_duration_seconds", labels);
+  }
+  printMetricHeader(out, "wm_http_clients", "gauge", "Open portal connections.");
+  out.print(F("wm_http_clients "));
+  out.print(activeClients());
+  out.print('\n');
+}
@@ -0,0 +1,192 @@
+/**************************************************************
+   PortalServer keeps a small pool of portal connections open at
+   once. Requests are still parsed and dispatched by
+   ESP8266WebServer, but a handler can hand the body of a large
+   response (a SPIFFS asset) back to the pool, which then sends it
+   in bounded slices between other requests, so a phone pulling
+   ace.js never holds up a /gpio_toggle from another one.
+   Upload bodies (routes registered with an upload handler) are
+   still read by ESP8266WebServer in one go and hold the loop for
+   the whole transfer, so an upload is only taken while no other
+   slot is sending a body or has a request waiting; otherwise it
+   is answered 503 with Retry-After.
+   Connections handed to beginEvents() stay in the pool as
+   Server-Sent Events subscribers and receive every sendEvent().
+   beginSocket() upgrades a connection to a WebSocket that carries
+   small binary messages both ways.
+   RequestView gives handlers typed, allocation-free access to the
+   arguments and headers the server parsed for the current request.
+   Every route registered through on() is timed into a fixed
+   metrics table that writeMetrics() prints for Prometheus.
+   Connectivity probes of phones and laptops are recognised from
+   the first bytes of the request and answered with a response
+   kept in flash, before any header parsing.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef PortalServer_h
+#define PortalServer_h
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+#include <FS.h>
+#include <functional>
+#include "PortalMetrics.h"
+
+#define WM_HTTP_SLOTS 5    // concurrent portal connections, lwIP allows 5 TCP PCBs by default
+#define WM_HTTP_SLICE 512  // most bytes one transfer may send per pass
+#define WM_EVENT_CLIENTS 3 // event streams and sockets, the other slots stay free for requests
+#define WM_SOCKET_PAYLOAD 64 // largest WebSocket message accepted, bigger ones close the socket
+#define WM_ROUTE_METRICS 36  // routes with their own metrics, the rest count as "(other)"
+#define WM_PROBE_PEEK 192    // request bytes looked at to recognise a connectivity probe
+#define WM_EVENT_KEEPALIVE 15000 // ms between comment lines sent to idle subscribers
+#define WM_EVENT_RETRY 2000      // ms a browser waits before reconnecting a dropped stream
+#define WM_UPLOAD_ROUTES 4       // routes with an upload handler that are held back while the pool is busy
+
+class PortalServer : public ESP8266WebServer {
+  public:
+    PortalServer(int port) : ESP8266WebServer(port) {
+      _routes[0].uri = "(other)";
+      _routes[1].uri = "(probe)";
+    }
+
+    //same as ESP8266WebServer::on(), the handler is timed into a metrics entry for uri,
+    //which is kept as a pointer and has to outlive the server (a literal)
+    void          on(const char *uri, THandlerFunction handler);
+    void          on(const char *uri, HTTPMethod method, THandlerFunction handler);
+    void          on(const char *uri, HTTPMethod method, THandlerFunction handler, THandlerFunction upload);
+    void          onNotFound(THandlerFunction handler);
+    //counts the body towards the route being served
+    using ESP8266WebServer::send;
+    void          send(int code, const char *contentType = NULL, const String &content = String());
+    //whole response from a RAM buffer, sent (and counted) before it returns
+    void          sendBody(int code, const char *contentType, const uint8_t *body, size_t len);
+    //request count, body bytes, latency histogram and heap change per route, Prometheus text
+    void          writeMetrics(Print &out);
+    uint32_t      heapLow() { return _heapLow; }
+    //complete raw response (status line, headers, body) in PROGMEM sent to every recognised
+    //connectivity probe, NULL turns the fast path off
+    void          setProbeResponse(PGM_P response) { _probeResponse = response; }
+
+    //read-only view over the argument and header table of the current request,
+    //strings point into that table and stay valid until the handler returns
+    class RequestView {
+      public:
+        //value of the named argument, "" when absent
+        const char*   arg(const char *name) const;
+        const char*   arg(int i) const;
+        const char*   argName(int i) const;
+        int           args() const;
+        boolean       hasArg(const char *name) const;
+        boolean       argIs(const char *name, const char *value) const;
+        //decimal value, fallback when absent or not a number
+        long          argInt(const char *name, long fallback) const;
+        //1/0, true/false, on/off, yes/no in any case, fallback otherwise
+        boolean       argBool(const char *name, boolean fallback) const;
+        //false (ip untouched) when absent or not a dotted quad
+        boolean       argIP(const char *name, IPAddress &ip) const;
+        //copies at most size - 1 bytes and terminates, returns the length copied
+        size_t        argCopy(const char *name, char *buf, size_t size) const;
+        //value of a collected header, "" when absent
+        const char*   header(const char *name) const;
+
+      private:
+        friend class PortalServer;
+        RequestView(const PortalServer *server) : _server(server) {}
+        const PortalServer *_server;
+        const String* find(const char *name) const;
+    };
+    RequestView   request() const { return RequestView(this); }
+
+    //accepts new connections, answers every request that is waiting and
+    //sends one slice of each pending transfer, never blocks on a transfer
+    void          handleClients();
+    //moves len bytes of file from start to the pool as the rest of the current
+    //response, file is taken over. false when not called from a pooled request.
+    //a shared file (one handle read by several slots) is seeked before every
+    //slice and left open
+    boolean       deferFile(File &file, size_t start, size_t len, boolean shared = false);
+    uint8_t       activeClients();
+    //answers the current request with a text/event-stream and keeps the connection as a
+    //subscriber. false (nothing sent) when not pooled or all subscriber places are taken
+    boolean       beginEvents();
+    //pushes one event to every subscriber, one that cannot take it right away is dropped
+    //(the browser reconnects and gets a fresh snapshot). returns the subscribers reached
+    uint8_t       sendEvent(const char *event, const char *data);
+    //one event to the subscriber being served (the snapshot after beginEvents()), checked for room
+    //like sendEvent(). false when it could not take it, the subscriber is dropped then
+    boolean       eventReply(const char *event, const char *data);
+    uint8_t       eventClients();
+
+    //a binary message arrived on the socket being served
+    typedef std::function<void(const uint8_t *payload, size_t len)> TSocketHandler;
+    //the socket being served has room again, send it the latest message for key
+    typedef std::function<void(uint8_t key)> TSocketRefresh;
+    //completes the WebSocket handshake of the current request, the connection stays as a socket.
+    //false (nothing sent) when the request is not an upgrade or all long lived places are taken
+    boolean       beginSocket();
+    void          onSocketMessage(TSocketHandler handler) { _socketMessage = handler; }
+    void          onSocketRefresh(TSocketRefresh handler) { _socketRefresh = handler; }
+    //binary message to the socket being served / to every socket. A socket without room for it
+    //only remembers key (0-31) and is refreshed once it drains, so the newest state per key wins
+    boolean       socketReply(const uint8_t *payload, size_t len, uint8_t key);
+    uint8_t       socketBroadcast(const uint8_t *payload, size_t len, uint8_t key);
+    uint8_t       socketClients();
+
+  private:
+    enum SlotState {
+      SLOT_FREE,
+      SLOT_READ,   // waiting for the request
+      SLOT_SEND,   // streaming a deferred body
+      SLOT_CLOSE,  // answered, waiting for the client to hang up
+      SLOT_EVENTS, // event stream subscriber
+      SLOT_SOCKET  // upgraded to a WebSocket
+    };
+    struct Slot {
+      WiFiClient    client;
+      File          file;
+      size_t        remaining = 0;
+      size_t        offset    = 0;      // next file byte, for shared files
+      boolean       shared    = false;
+      uint8_t       state     = SLOT_FREE;
+      unsigned long since     = 0;
+      uint32_t      pending   = 0;  // socket keys waiting for room
+      uint8_t       route     = 0;  // metrics entry the deferred body counts towards
+    };
+    struct RouteStats {
+      const char       *uri    = NULL;
+      uint8_t          method  = HTTP_ANY;
+      uint32_t         bytes   = 0;
+      int32_t          heapDelta = 0; // free heap change over the last request
+      LatencyHistogram latency;
+    };
+    RouteStats    _routes[WM_ROUTE_METRICS];
+    uint8_t       _routeCount = 2;   // entry 0 is "(other)", 1 the probe fast path
+    uint8_t       _route      = 0;   // entry of the request being served
+    uint32_t      _sentBytes  = 0;   // body bytes of the request being served, besides ChunkedPrint
+    uint32_t      _heapLow    = 0xFFFFFFFF;
+    THandlerFunction track(const char *uri, HTTPMethod method, THandlerFunction handler);
+    void          routeLabels(uint8_t i, char *buf, size_t size);
+    PGM_P         _probeResponse = NULL;
+    boolean       answerProbe(Slot &slot);
+    const char   *_uploadRoutes[WM_UPLOAD_ROUTES];
+    uint8_t       _uploadCount = 0;
+    boolean       isUpload(Slot &slot);
+    boolean       poolBusy(uint8_t except);
+    Slot          _slots[WM_HTTP_SLOTS];
+    int8_t        _serving = -1;  // slot whose request is being handled
+    uint8_t       _next    = 0;   // first slot to get a slice next pass
+
+    void          acceptClients();
+    void          serviceRequest(uint8_t i);
+    void          sendSlice(Slot &slot);
+    void          keepEventAlive(Slot &slot);
+    boolean       writeEvent(Slot &slot, const char *event, const char *data);
+    void          serviceSocket(uint8_t i);
+    boolean       readSocketFrame(Slot &slot);
+    boolean       writeSocketFrame(Slot &slot, uint8_t opcode, const uint8_t *payload, size_t len);
+    TSocketHandler _socketMessage;
+    TSocketRefresh _socketRefresh;
+    void          release(Slot &slot);
+    void          closeFile(Slot &slot);
+};
+#endif
@@ -0,0 +1,145 @@
+/**************************************************************
+   ResponseCache - RAM cache of small response bodies
+   Licensed under MIT license
+ **************************************************************/
+
+#include "ResponseCache.h"
+#include "PortalMetrics.h"
+
+ResponseCache::Entry* ResponseCache::find(const char *key, uint8_t variant) {
+  for (uint8_t i = 0; i < WM_CACHE_SLOTS; i++) {
+    Entry &e = _entries[i];
+    if (e.body != NULL && e.variant == variant && strcmp(e.key, key) == 0) return &e;
+  }
+  return NULL;
+}
+
+//least recently used slot in use, NULL when the cache is empty
+ResponseCache::Entry* ResponseCache::oldest() {
+  Entry *found = NULL;
+  for (uint8_t i = 0; i < WM_CACHE_SLOTS; i++) {
+    Entry &e = _entries[i];
+    if (e.body != NULL && (found == NULL || (int32_t)(e.used - found->used) < 0)) found = &e;
+  }
+  return found;
+}
+
+void ResponseCache::release(Entry &entry) {
+  _bytes -= entry.len;
+  free(entry.body);
+  entry.body = NULL;
+  entry.len = 0;
+}
+
+void ResponseCache::setBudget(size_t bytes) {
+  _budget = bytes;
+  while (_bytes > _budget) {
+    release(*oldest());
+    _evictions++;
+  }
+}
+
+const uint8_t* ResponseCache::get(const char *key, uint8_t variant, size_t &len) {
+  Entry *e = find(key, variant);
+  if (e == NULL) {
+    _misses++;
+    return NULL;
+  }
+  _hits++;
+  e->used = ++_clock;
+  len = e->len;
+  return e->body;
+}
+
+boolean ResponseCache::put(const char *key, uint8_t variant, uint8_t *body, size_t len) {
+  if (body == NULL) return false;
+  if (!fits(len) || strlen(key) >= WM_CACHE_KEY_LEN) {
+    free(body);
+    return false;
+  }
+  Entry *e = find(key, variant);
+  if (e != NULL) release(*e);
+  // make room: evict by age until the body fits the budget and a slot is free
+  while (_bytes + len > _budget) {
+    release(*oldest());
+    _evictions++;
+  }
+  if (e == NULL) {
+    for (uint8_t i = 0; i < WM_CACHE_SLOTS && e == NULL; i++) {
+      if (_entries[i].body == NULL) e = &_entries[i];
+    }
+  }
+  if (e == NULL) {
+    e = oldest();
+    release(*e);
+    _evictions++;
+  }
+  strcpy(e->key, key);
+  e->variant = variant;
+  e->body = body;
+  e->len = len;
+  e->used = ++_clock;
+  _bytes += len;
+  return true;
+}
+
+void ResponseCache::invalidate(const char *key) {
+  for (uint8_t i = 0; i < WM_CACHE_SLOTS; i++) {
+    if (_entries[i].body != NULL && strcmp(_entries[i].key, key) == 0) release(_entries[i]);
+  }
+}
+
+void ResponseCache::clear() {
+  for (uint8_t i = 0; i < WM_CACHE_SLOTS; i++) {
+    if (_entries[i].body != NULL) release(_entries[i]);
+  }
+}
+
+size_t ResponseCache::Capture::write(const uint8_t *buf, size_t size) {
+  if (_failed) return 0;
+  if (_len + size > _size) {
+    size_t grow = _size ? _size * 2 : 256;
+    while (grow < _len + size) grow *= 2;
+    if (grow > WM_CACHE_ITEM_MAX) grow = WM_CACHE_ITEM_MAX;
+    uint8_t *bigger = (_len + size <= grow) ? (uint8_t*)realloc(_buf, grow) : NULL;
+    if (bigger == NULL) {
+      _failed = true;
+      return 0;
+    }
+    _buf = bigger;
+    _size = grow;
+  }
+  memcpy(_buf + _len, buf, size);
+  _len += size;
+  return size;
+}
+
+uint8_t* ResponseCache::Capture::release() {
+  uint8_t *buf = _buf;
+  _buf = NULL;
+  _len = _size = 0;
+  return buf;
+}
+
+void ResponseCache::writeMetrics(Print &out) {
+  printMetricHeader(out, "wm_cache_hits_total", "counter", "Responses answered from the RAM cache.");
+  out.print(F("wm_cache_hits_total "));
+  out.print(_hits);
+  out.print('\n');
+  printMetricHeader(out, "wm_cache_misses_total", "counter", "Cacheable responses not found in the RAM cache.");
+  out.print(F("wm_cache_misses_total "));
+  out.print(_misses);
+  out.print('\n');
+  printMetricHeader(out, "wm_cache_evictions_total", "counter", "Bodies dropped to stay under the cache budget.");
+  out.print(F("wm_cache_evictions_total "));
+  out.print(_evictions);
+  out.print('\n');
+  printMetricHeader(out, "wm_cache_bytes", "gauge", "Bytes of the cached bodies.");
+  out.print(F("wm_cache_bytes "));
+  out.print(_bytes);
+  out.print('\n');
+  printMetricHeader(out, "wm_cache_budget_bytes", "gauge", "Byte budget of the cached bodies.");
+  out.print(F("wm_cache_budget_bytes "));
+  out.print(_budget);
+  out.print('\n');
+}
@@ -0,0 +1,88 @@
+/**************************************************************
+   ResponseCache keeps the bodies of small, often requested
+   responses in RAM: the portal pages served from SPIFFS and the
+   JSON the handlers build. Entries are keyed by route and
+   encoding (the stored variant), the bodies together stay under a
+   byte budget and the least recently used one is dropped to make
+   room. Nothing expires by itself, the owner invalidates a route
+   when the file or the state behind it changes.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef ResponseCache_h
+#define ResponseCache_h
+#include <Arduino.h>
+
+#define WM_CACHE_SLOTS      8      // bodies kept at most
+#define WM_CACHE_KEY_LEN    32     // longest route, including the terminating 0
+#define WM_CACHE_BUDGET     6144   // default byte budget of the bodies
+#define WM_CACHE_ITEM_MAX   2048   // larger bodies are never cached
+#define WM_CACHE_HEAP_SHARE 8      // a budget sized at boot takes at most this fraction of the free heap
+
+class ResponseCache {
+  public:
+    ~ResponseCache() { clear(); }
+
+    //bytes the cached bodies may take together, 0 turns the cache off; shrinking evicts
+    void          setBudget(size_t bytes);
+    size_t        budget() { return _budget; }
+    //true when a body of len bytes may be cached at all
+    boolean       fits(size_t len) { return len > 0 && len <= WM_CACHE_ITEM_MAX && len <= _budget; }
+
+    //body of key/variant and its length, NULL on a miss; valid until the next put, invalidate or clear
+    const uint8_t* get(const char *key, uint8_t variant, size_t &len);
+    //store body (malloc'ed, owned by the cache from now on, freed when it is refused)
+    boolean       put(const char *key, uint8_t variant, uint8_t *body, size_t len);
+    //drop every variant of key
+    void          invalidate(const char *key);
+    void          clear();
+
+    size_t        bytes() { return _bytes; }
+    uint32_t      hits() { return _hits; }
+    uint32_t      misses() { return _misses; }
+    //Prometheus text lines: hits, misses, evictions, cached bytes and budget
+    void          writeMetrics(Print &out);
+
+    //builds a body on the heap through print(), up to WM_CACHE_ITEM_MAX bytes
+    class Capture : public Print {
+      public:
+        ~Capture() { free(_buf); }
+        size_t        write(uint8_t c) override { return write(&c, 1); }
+        size_t        write(const uint8_t *buf, size_t size) override;
+        using Print::write;
+        //false once the body outgrew the limit or the heap
+        boolean       ok() { return !_failed; }
+        const uint8_t* data() { return _buf; }
+        size_t        length() { return _len; }
+        //hands the buffer over (to put()), the capture is empty afterwards
+        uint8_t*      release();
+
+      private:
+        uint8_t      *_buf    = NULL;
+        size_t        _len    = 0;
+        size_t        _size   = 0;
+        boolean       _failed = false;
+    };
+
+  private:
+    struct Entry {
+      char          key[WM_CACHE_KEY_LEN];
+      uint8_t       variant = 0;
+      uint8_t      *body    = NULL;  // NULL when the slot is free
+      size_t        len     = 0;
+      uint32_t      used    = 0;     // _clock at the last hit, the smallest is evicted first
+    };
+
+    Entry         _entries[WM_CACHE_SLOTS];
+    size_t        _budget    = WM_CACHE_BUDGET;
+    size_t        _bytes     = 0;
+    uint32_t      _clock     = 0;
+    uint32_t      _hits      = 0;
+    uint32_t      _misses    = 0;
+    uint32_t      _evictions = 0;
+
+    Entry*        find(const char *key, uint8_t variant);
+    Entry*        oldest();
+    void          release(Entry &entry);
+};
+#endif
@@ -0,0 +1,254 @@
+/**************************************************************
+   SettingsStore - append only key/value log with an in RAM index
+   Licensed under MIT license
+ **************************************************************/
+
+#include "SettingsStore.h"
+#include "ConfigRecord.h"
+#include "PortalMetrics.h"
+
+#define KV_LIVE      'K'
+#define KV_TOMBSTONE 'X'
+
+//FNV-1a
+uint32_t SettingsStore::hashKey(const char *key, size_t len) {
+  uint32_t h = 2166136261UL;
+  while (len--) {
+    h ^= (uint8_t)*key++;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+boolean SettingsStore::begin() {
+  end();
+  SPIFFS.begin();
+  // compaction stopped before the rename: the temp file is whole only if the old log is gone
+  if (SPIFFS.exists(WM_KV_TEMP_FILE)) {
+    if (SPIFFS.exists(WM_KV_FILE)) SPIFFS.remove(WM_KV_TEMP_FILE);
+    else SPIFFS.rename(WM_KV_TEMP_FILE, WM_KV_FILE);
+  }
+  _log = SPIFFS.open(WM_KV_FILE, "a+");
+  if (!_log) return false;
+  _open = true;
+
+  uint32_t size = _log.size();
+  uint8_t record[WM_KV_HEADER + WM_KV_KEY_MAX + WM_KV_VALUE_MAX];
+  _log.seek(0, SeekSet);
+  while (_end + WM_KV_HEADER <= size) {
+    if (_log.read(record, WM_KV_HEADER) != WM_KV_HEADER) break;
+    uint8_t type = record[0];
+    size_t keyLen = record[1], valueLen = record[2];
+    size_t length = WM_KV_HEADER + keyLen + valueLen;
+    if ((type != KV_LIVE && type != KV_TOMBSTONE) || keyLen == 0 || keyLen > WM_KV_KEY_MAX || _end + length > size) break;
+    if (_log.read(record + WM_KV_HEADER, length - WM_KV_HEADER) != length - WM_KV_HEADER) break;
+    uint32_t crc = configCrc32(record, 4);
+    crc = configCrc32(record + WM_KV_HEADER, keyLen + valueLen, crc);
+    if (crc != ((uint32_t)record[4] | (uint32_t)record[5] << 8 | (uint32_t)record[6] << 16 | (uint32_t)record[7] << 24)) break;
+
+    const char *key = (const char*)record + WM_KV_HEADER;
+    uint32_t hash = hashKey(key, keyLen);
+    int slot = find(key, keyLen, hash);
+    if (slot >= 0) {
+      _live -= _index[slot].length;
+      _index[slot].offset = DELETED;
+      _count--;
+    }
+    if (type == KV_LIVE) {
+      insert(hash, _end, length);
+    }
+    _end += length;
+    // find() moved the file position while comparing keys
+    _log.seek(_end, SeekSet);
+  }
+  // a record cut short by a reset: rewrite the log without it, new records must not follow garbage
+  if (_end < size) return compact();
+  return true;
+}
+
+void SettingsStore::end() {
+  if (_open) _log.close();
+  _open = false;
+  for (uint8_t i = 0; i < WM_KV_INDEX; i++) _index[i] = Slot();
+  _count = 0;
+  _end = 0;
+  _live = 0;
+}
+
+//index slot of key, -1 when not stored. Equal hashes are confirmed against the key on flash.
+int SettingsStore::find(const char *key, size_t keyLen, uint32_t hash) {
+  uint8_t stored[WM_KV_HEADER + WM_KV_KEY_MAX];
+  for (uint8_t probe = 0; probe < WM_KV_INDEX; probe++) {
+    uint8_t i = (hash + probe) & (WM_KV_INDEX - 1);
+    const Slot &slot = _index[i];
+    if (slot.offset == EMPTY) return -1;
+    if (slot.offset == DELETED || slot.hash != hash) continue;
+    _log.seek(slot.offset, SeekSet);
+    if (_log.read(stored, WM_KV_HEADER + keyLen) == WM_KV_HEADER + keyLen &&
+        stored[1] == keyLen && memcmp(stored + WM_KV_HEADER, key, keyLen) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void SettingsStore::insert(uint32_t hash, uint32_t offset, uint16_t length) {
+  for (uint8_t probe = 0; probe < WM_KV_INDEX; probe++) {
+    Slot &slot = _index[(hash + probe) & (WM_KV_INDEX - 1)];
+    if (slot.offset != EMPTY && slot.offset != DELETED) continue;
+    slot.hash = hash;
+    slot.offset = offset;
+    slot.length = length;
+    _live += length;
+    _count++;
+    return;
+  }
+}
+
+boolean SettingsStore::append(uint8_t type, const char *key, size_t keyLen, const char *value, size_t valueLen) {
+  uint8_t record[WM_KV_HEADER + WM_KV_KEY_MAX + WM_KV_VALUE_MAX];
+  size_t length = WM_KV_HEADER + keyLen + valueLen;
+  record[0] = type;
+  record[1] = keyLen;
+  record[2] = valueLen;
+  record[3] = 0;
+  memcpy(record + WM_KV_HEADER, key, keyLen);
+  memcpy(record + WM_KV_HEADER + keyLen, value, valueLen);
+  uint32_t crc = configCrc32(record, 4);
+  crc = configCrc32(record + WM_KV_HEADER, keyLen + valueLen, crc);
+  for (uint8_t i = 0; i < 4; i++) record[4 + i] = (uint8_t)(crc >> (8 * i));
+
+  // opened for append, the write lands at the end whatever the read position
+  size_t written = _log.write(record, length);
+  _log.flush();
+  _written += written;
+  if (written != length) {
+    // the partial record is dropped by the next begin()
+    return false;
+  }
+  _appended += length;
+  _end += length;
+  return true;
+}
+
+boolean SettingsStore::put(const char *key, const char *value) {
+  size_t keyLen = strlen(key), valueLen = strlen(value);
+  if (!_open || keyLen == 0 || keyLen > WM_KV_KEY_MAX || valueLen > WM_KV_VALUE_MAX) return false;
+  uint32_t hash = hashKey(key, keyLen);
+  int slot = find(key, keyLen, hash);
+  if (slot >= 0) {
+    // find() left the position on the stored value
+    if (_index[slot].length == WM_KV_HEADER + keyLen + valueLen) {
+      char stored[WM_KV_VALUE_MAX];
+      if (_log.read((uint8_t*)stored, valueLen) == valueLen && memcmp(stored, value, valueLen) == 0) return true;
+    }
+  } else if (_count >= WM_KV_MAX_KEYS) {
+    return false;
+  }
+
+  uint32_t offset = _end;
+  if (!append(KV_LIVE, key, keyLen, value, valueLen)) return false;
+  if (slot >= 0) {
+    _live -= _index[slot].length;
+    _index[slot].offset = DELETED;
+    _count--;
+  }
+  insert(hash, offset, WM_KV_HEADER + keyLen + valueLen);
+  if (_end > WM_KV_COMPACT_AT && _live * 2 < _end) compact();
+  return true;
+}
+
+int SettingsStore::get(const char *key, char *buf, size_t size) {
+  if (!_open || size == 0) return -1;
+  size_t keyLen = strlen(key);
+  if (keyLen == 0 || keyLen > WM_KV_KEY_MAX) return -1;
+  int slot = find(key, keyLen, hashKey(key, keyLen));
+  if (slot < 0) return -1;
+  size_t valueLen = _index[slot].length - WM_KV_HEADER - keyLen;
+  size_t copy = valueLen < size ? valueLen : size - 1;
+  copy = _log.read((uint8_t*)buf, copy);
+  buf[copy] = '\0';
+  return valueLen;
+}
+
+boolean SettingsStore::remove(const char *key) {
+  size_t keyLen = strlen(key);
+  if (!_open || keyLen == 0 || keyLen > WM_KV_KEY_MAX) return false;
+  int slot = find(key, keyLen, hashKey(key, keyLen));
+  if (slot < 0) return true;
+  if (!append(KV_TOMBSTONE, key, keyLen, "", 0)) return false;
+  _live -= _index[slot].length;
+  _index[slot].offset = DELETED;
+  _count--;
+  return true;
+}
+
+//copy the live records to the temp file, then swap it in and rebuild the index without deleted slots
+boolean SettingsStore::compact() {
+  if (!_open) return false;
+  File out = SPIFFS.open(WM_KV_TEMP_FILE, "w");
+  if (!out) return false;
+  Slot moved[WM_KV_INDEX];
+  uint32_t offset = 0;
+  uint8_t record[WM_KV_HEADER + WM_KV_KEY_MAX + WM_KV_VALUE_MAX];
+  for (uint8_t i = 0; i < WM_KV_INDEX; i++) {
+    const Slot &slot = _index[i];
+    if (slot.offset == EMPTY || slot.offset == DELETED) continue;
+    _log.seek(slot.offset, SeekSet);
+    if (_log.read(record, slot.length) != slot.length || out.write(record, slot.length) != slot.length) {
+      out.close();
+      SPIFFS.remove(WM_KV_TEMP_FILE);
+      return false;
+    }
+    moved[i] = slot;
+    moved[i].offset = offset;
+    offset += slot.length;
+  }
+  out.close();
+  _log.close();
+  _open = false;
+  SPIFFS.remove(WM_KV_FILE);
+  // on failure the store stays closed, begin() picks the temp file up
+  if (!SPIFFS.rename(WM_KV_TEMP_FILE, WM_KV_FILE)) return false;
+  _log = SPIFFS.open(WM_KV_FILE, "a+");
+  if (!_log) return false;
+  _open = true;
+
+  for (uint8_t i = 0; i < WM_KV_INDEX; i++) _index[i] = Slot();
+  _count = 0;
+  _live = 0;
+  for (uint8_t i = 0; i < WM_KV_INDEX; i++) {
+    if (moved[i].offset != EMPTY) insert(moved[i].hash, moved[i].offset, moved[i].length);
+  }
+  _end = offset;
+  _written += offset;
+  _compactions++;
+  return true;
+}
+
+void SettingsStore::writeMetrics(Print &out) {
+  printMetricHeader(out, "wm_settings_keys", "gauge", "Keys in the settings store.");
+  out.print(F("wm_settings_keys "));
+  out.print(_count);
+  out.print('\n');
+  printMetricHeader(out, "wm_settings_log_bytes", "gauge", "Bytes of the settings log, dead records included.");
+  out.print(F("wm_settings_log_bytes "));
+  out.print(_end);
+  out.print('\n');
+  printMetricHeader(out, "wm_settings_live_bytes", "gauge", "Bytes of the settings log still referenced.");
+  out.print(F("wm_settings_live_bytes "));
+  out.print(_live);
+  out.print('\n');
+  printMetricHeader(out, "wm_settings_appended_bytes_total", "counter", "Record bytes appended by puts and removes.");
+  out.print(F("wm_settings_appended_bytes_total "));
+  out.print(_appended);
+  out.print('\n');
+  printMetricHeader(out, "wm_settings_written_bytes_total", "counter", "Record bytes written, compaction copies included.");
+  out.print(F("wm_settings_written_bytes_total "));
+  out.print(_written);
+  out.print('\n');
+  printMetricHeader(out, "wm_settings_compactions_total", "counter", "Settings log compactions.");
+  out.print(F("wm_settings_compactions_total "));
+  out.print(_compactions);
+  out.print('\n');
+}
@@ -0,0 +1,70 @@
+/**************************************************************
+   SettingsStore is a small log structured key/value store kept
+   in one SPIFFS file. Every put or remove appends one CRC checked
+   record, nothing is rewritten in place; once the log is mostly
+   dead records it is compacted into a fresh file and renamed over
+   the old one. At mount the log is scanned once into an in RAM
+   hash index from key to record offset, so a read is one probe
+   and one seek. SPIFFS itself spreads the appended pages over the
+   flash, the store only avoids rewriting what did not change.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef SettingsStore_h
+#define SettingsStore_h
+#include <Arduino.h>
+#include <FS.h>
+
+#define WM_KV_FILE        "/settings.log"
+#define WM_KV_TEMP_FILE   "/settings.tmp"  // compaction output, renamed over WM_KV_FILE when whole
+#define WM_KV_INDEX       32               // index slots, a power of two
+#define WM_KV_MAX_KEYS    24               // keys stored at most, keeps probe chains short
+#define WM_KV_KEY_MAX     31
+#define WM_KV_VALUE_MAX   255
+#define WM_KV_COMPACT_AT  4096             // log bytes before compaction is considered
+#define WM_KV_HEADER      8                // type, key length, value length, 0, CRC32
+
+class SettingsStore {
+  public:
+    ~SettingsStore() { end(); }
+
+    //open (or create) the log and build the index, a torn last record is dropped
+    boolean       begin();
+    void          end();
+    //append key=value unless the stored value is already the same
+    boolean       put(const char *key, const char *value);
+    //value of key into buf, NUL terminated and cut to size; returns the stored length, -1 if key is not stored
+    int           get(const char *key, char *buf, size_t size);
+    boolean       remove(const char *key);
+    //rewrite the log with live records only
+    boolean       compact();
+
+    uint16_t      count() { return _count; }
+    //Prometheus text lines: keys, log and live bytes, bytes written and compactions
+    void          writeMetrics(Print &out);
+
+  private:
+    struct Slot {
+      uint32_t      hash   = 0;
+      uint32_t      offset = EMPTY;
+      uint16_t      length = 0;  // whole record, header included
+    };
+    static const uint32_t EMPTY   = 0xFFFFFFFF;
+    static const uint32_t DELETED = 0xFFFFFFFE;
+
+    File          _log;
+    boolean       _open = false;
+    Slot          _index[WM_KV_INDEX];
+    uint16_t      _count = 0;
+    uint32_t      _end = 0;         // log bytes in use, next record goes here
+    uint32_t      _live = 0;        // bytes of records the index points at
+    uint32_t      _appended = 0;    // record bytes asked for by put/remove
+    uint32_t      _written = 0;     // record bytes written, compaction copies included
+    uint32_t      _compactions = 0;
+
+    static uint32_t hashKey(const char *key, size_t len);
+    int           find(const char *key, size_t keyLen, uint32_t hash);
+    void          insert(uint32_t hash, uint32_t offset, uint16_t length);
+    boolean       append(uint8_t type, const char *key, size_t keyLen, const char *value, size_t valueLen);
+};
+#endif
@@ -0,0 +1,85 @@
+/**************************************************************
+   UploadWriter - page payload aligned, buffered SPIFFS writer for uploads
+   Licensed under MIT license
+ **************************************************************/
+
+#include "UploadWriter.h"
+
+boolean UploadWriter::begin(const String &path) {
+  abort();
+  FSInfo info;
+  size_t page = 256; // SPIFFS default, used when info() fails
+  if (SPIFFS.info(info) && info.pageSize > WM_SPIFFS_PAGE_HEADER) page = info.pageSize;
+  // as many page payloads as pages fit the budget
+  size_t pages = WM_UPLOAD_BUFFER / page;
+  size_t size = (pages ? pages : 1) * (page - WM_SPIFFS_PAGE_HEADER);
+
+  _file = SPIFFS.open(path, "w");
+  if (!_file) return false;
+  _buf = new uint8_t[size];
+  _size = size;
+  _path = path;
+  _len = 0;
+  _bytes = 0;
+  _writes = 0;
+  _failed = false;
+  _started = millis();
+  _elapsed = 0;
+  return true;
+}
+
+boolean UploadWriter::flush(const uint8_t *data, size_t len) {
+  if (_file.write(data, len) != len) _failed = true;
+  _writes++;
+  return !_failed;
+}
+
+boolean UploadWriter::write(const uint8_t *data, size_t len) {
+  if (!_buf || _failed) return false;
+  _bytes += len;
+  // top up a partly filled buffer first
+  if (_len > 0) {
+    size_t n = (len < _size - _len) ? len : _size - _len;
+    memcpy(_buf + _len, data, n);
+    _len += n;
+    data += n;
+    len -= n;
+    if (_len < _size) return true;
+    _len = 0;
+    if (!flush(_buf, _size)) return false;
+  }
+  // whole buffers straight from the request, no copy
+  while (len >= _size) {
+    if (!flush(data, _size)) return false;
+    data += _size;
+    len -= _size;
+  }
+  memcpy(_buf, data, len);
+  _len = len;
+  return true;
+}
+
+boolean UploadWriter::end() {
+  if (!_buf) return false;
+  if (_len > 0 && !_failed) flush(_buf, _len);
+  _len = 0;
+  _file.close();
+  _elapsed = millis() - _started;
+  // a short write leaves a truncated file, drop it the way abort() does
+  if (_failed) SPIFFS.remove(_path);
+  release();
+  return !_failed;
+}
+
+void UploadWriter::abort() {
+  if (!_buf) return;
+  _file.close();
+  SPIFFS.remove(_path);
+  release();
+}
+
+void UploadWriter::release() {
+  delete[] _buf;
+  _buf = NULL;
+  _size = 0;
+}
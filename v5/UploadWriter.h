@@ -0,0 +1,56 @@
+/**************************************************************
+   UploadWriter collects the chunks of an editor upload and writes
+   them to SPIFFS in whole data pages. A SPIFFS data page carries
+   a WM_SPIFFS_PAGE_HEADER byte header in front of the file bytes,
+   so the buffer is a whole number of page payloads (page size from
+   FSInfo, minus the header): every write but the last fills its
+   pages completely instead of leaving one half written for the
+   next write to rewrite.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef UploadWriter_h
+#define UploadWriter_h
+#include <Arduino.h>
+#include <FS.h>
+
+#define WM_UPLOAD_BUFFER      4096   // most bytes held before a flash write, cut down to whole page payloads
+#define WM_SPIFFS_PAGE_HEADER 5      // object id, span index and flags in front of the data of a page
+
+class UploadWriter {
+  public:
+    ~UploadWriter() { abort(); }
+
+    //create (or truncate) path and size the buffer to the file system pages
+    boolean       begin(const String &path);
+    //buffer len bytes, whole buffers go to flash; false once a flash write came up short
+    boolean       write(const uint8_t *data, size_t len);
+    //flush what is left and close the file; after a failed write the partial file is removed
+    boolean       end();
+    //close and remove the partial file, for aborted uploads
+    void          abort();
+
+    boolean       active() { return _buf != NULL; }
+    const String& path() { return _path; }
+    uint32_t      bytes() { return _bytes; }
+    //flash writes made for the upload, final partial page included
+    uint16_t      writes() { return _writes; }
+    //ms from begin() to end()
+    unsigned long elapsed() { return _elapsed; }
+
+  private:
+    File          _file;
+    String        _path;
+    uint8_t      *_buf     = NULL;
+    size_t        _size    = 0;   // buffer capacity, whole page payloads
+    size_t        _len     = 0;
+    uint32_t      _bytes   = 0;
+    uint16_t      _writes  = 0;
+    boolean       _failed  = false;
+    unsigned long _started = 0;
+    unsigned long _elapsed = 0;
+
+    boolean       flush(const uint8_t *data, size_t len);
+    void          release();
+};
+#endif
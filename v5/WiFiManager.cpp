@@ -7,6 +7,10 @@
 
 #include "WiFiManager.h"
 #include "Time.h"
+extern "C" {
+  #include "lwip/init.h" // LWIP_VERSION_MAJOR, the NTP lookup differs between lwIP 1.4 and 2
+  #include "lwip/dns.h"
+}
 WiFiManagerParameter::WiFiManagerParameter(const char *custom) {
   _id = NULL;
   _placeholder = NULL;
@@ -64,13 +68,11 @@ const char* WiFiManagerParameter::getCustomHTML() {
 }
 
 WiFiManager::WiFiManager() {
-	//Do a network scan before setting up an access point so as not to close WiFiNetwork while scanning.
-	numberOfNetworks = scanWifiNetworks(networkIndicesptr);
+	//Networks are scanned in the background by the scan task once the portal runs.
 	DEBUG_WM(F("SPIFFS Innitialize"));
 	SPIFFS_List();
 }
 WiFiManager::~WiFiManager() {
-    free(networkIndices); //indices array no longer required so free memory
 }
 
 
@@ -87,8 +89,21 @@ void WiFiManager::setupConfigPortal() {
   but just in case check the setting and turn on autoconnect if it is off.
   Some useful discussion at https://github.com/esp8266/Arduino/issues/1615*/
   if (WiFi.getAutoConnect()==0)WiFi.setAutoConnect(1);
-  dnsServer.reset(new DNSServer());
-  server.reset(new ESP8266WebServer(80));
+  dnsServer.reset(new CaptiveDNS());
+  server.reset(new PortalServer(80));
+  if (_bundle.begin()) {
+    DEBUG_WM(F("Asset bundle loaded, entries:"));
+    DEBUG_WM(_bundle.count());
+  }
+  _cache.clear();
+  _cache.setBudget(_cacheBudgetSet ? _cacheBudget : std::min((size_t)WM_CACHE_BUDGET, (size_t)(ESP.getFreeHeap() / WM_CACHE_HEAP_SHARE)));
+  DEBUG_WM(F("Response cache budget:"));
+  DEBUG_WM(_cache.budget());
+  // the station gets or loses its address outside of any handler, the cached wifi info goes with it.
+  // the events run in the SDK context, possibly while a handler is sending that very body, so they only
+  // raise a flag; the body is dropped from the loop (housekeeping task, or handleState itself)
+  _gotIPHandler = WiFi.onStationModeGotIP([this](const WiFiEventStationModeGotIP&) { _stateChanged = true; });
+  _disconnectedHandler = WiFi.onStationModeDisconnected([this](const WiFiEventStationModeDisconnected&) { _stateChanged = true; });
 
   DEBUG_WM(F(""));
   _configPortalStart = millis();
@@ -121,8 +136,7 @@ void WiFiManager::setupConfigPortal() {
   DEBUG_WM(WiFi.softAPIP());
 
   /* Setup the DNS server redirecting all the domains to the apIP */
-  dnsServer->setErrorReplyCode(DNSReplyCode::NoError);
-  dnsServer->start(DNS_PORT, "*", WiFi.softAPIP());
+  dnsServer->start(DNS_PORT, WiFi.softAPIP());
 
   /* setup server handler */
   server->on("/", std::bind(&WiFiManager::handleRoot, this));
@@ -133,9 +147,15 @@ void WiFiManager::setupConfigPortal() {
   server->on("/factory_reset", std::bind(&WiFiManager::handleReset, this));
   server->on("/json_module_wifi_info", std::bind(&WiFiManager::handleState, this));
   server->on("/json_wifi_scan_result", std::bind(&WiFiManager::handleScan, this));
+  server->on("/json_connect_status", std::bind(&WiFiManager::handleConnectStatus, this));
   server->on("/gpio_control",std::bind(&WiFiManager::handleGPIOControl,this));
   server->on("/gpio_toggle",std::bind(&WiFiManager::handleGPIOToggle,this));
   server->on("/gpio_status",std::bind(&WiFiManager::handleGPIOStatus,this));
+  server->on("/events",HTTP_GET,std::bind(&WiFiManager::handleEvents,this));
+  server->on("/ws",HTTP_GET,std::bind(&WiFiManager::handleSocket,this));
+  server->on("/metrics",HTTP_GET,std::bind(&WiFiManager::handleMetrics,this));
+  server->onSocketMessage(std::bind(&WiFiManager::handleSocketMessage, this, std::placeholders::_1, std::placeholders::_2));
+  server->onSocketRefresh(std::bind(&WiFiManager::sendGPIOFrame, this, std::placeholders::_1));
   server->on("/firmware_update",std::bind(&WiFiManager::handleFirmwareUpdatePage,this));
   server->on("/update",HTTP_POST,std::bind(&WiFiManager::handleUpdateHeader,this),std::bind(&WiFiManager::handleUpdate,this));
   server->on("/time", std::bind(&WiFiManager::handleTime, this));
@@ -158,7 +178,13 @@ void WiFiManager::setupConfigPortal() {
   server->on("/edit",HTTP_DELETE,std::bind(&WiFiManager::handleFileDelete,this));
   
   
+  // request headers the handlers look at, the web server drops every other one
+  static const char* requestHeaders[] = { "If-None-Match", "If-Modified-Since", "Accept-Encoding", "Range", "If-Range",
+                                           "Upgrade", "Sec-WebSocket-Key", "Sec-WebSocket-Version" };
+  server->collectHeaders(requestHeaders, sizeof(requestHeaders) / sizeof(requestHeaders[0]));
+  
   server->onNotFound (std::bind(&WiFiManager::handleNotFound, this));
+  server->setProbeResponse(HTTP_CAPTIVE_REDIRECT); // probe storms never reach the handlers
   server->serveStatic("/", SPIFFS, "/","max-age=86400"); //cache all files in SPIFFS for 24 hrs
   server->begin(); // Web server start
   DEBUG_WM(F("HTTP server started"));
@@ -231,12 +257,12 @@ boolean  WiFiManager::startConfigPortal(char const *apName, char const *apPasswo
   }
 
   connect = false;
+  loadSettings();
   setupConfigPortal();
-  bool TimedOut=true;
   SPIFFS_Credentials(); // if exist wifi credentials from spiffs, load it and save to ssid_, pass_
   if(wifi_credentials_ok)
   {	
-	connectWifi(ssid_, pass_); // connect to wifi network.
+	beginConnect(ssid_, pass_, false); // connect to wifi network, the connect task steps it from the portal loop.
 	// this code test if any trail character like x0d in the ssid string.
 	// if trailing exist server cannot connect to network since wrong credentials.
 	//for (int i = 0; i < strlen(ssid_.c_str()); ++i) {
@@ -245,55 +271,17 @@ boolean  WiFiManager::startConfigPortal(char const *apName, char const *apPasswo
     //    Serial.println("");
   }
   
-  while (_configPortalTimeout == 0 || millis() < _configPortalStart + _configPortalTimeout) {
-    //DNS
-    dnsServer->processNextRequest();
-    //HTTP
-    server->handleClient();
-	//indicator led blinking in AP mode
-	AP_Led_Indicator(ap_mode);
-	
-    if (connect) {
-      connect = false;
-      TimedOut=false;
-      delay(2000);
-      DEBUG_WM(F("Connecting to new AP"));
-
-		// using user-provided  _ssid, _pass in place of system-stored ssid and pass
-      if (connectWifi(_ssid, _pass) != WL_CONNECTED) {
-        DEBUG_WM(F("Failed to connect."));
-		// Dual mode becomes flaky if not connected to a WiFi network. could be because too much 
-		// processor resources used for network connecting.
-        WiFi.mode(WIFI_AP); 
-      } 
-	  else{
-        //notify that configuration has changed and any optional parameters should be saved
-        if ( _savecallback != NULL) {
-          //todo: check if any custom parameters actually exist, and check if they really changed maybe
-          _savecallback();
-        }
-        //break;
-      }
-
-	   //flag set to exit after config
-      if (_shouldBreakAfterConfig)
-	  {
-        if ( _savecallback != NULL) {
-          //todo: check if any custom parameters actually exist, and check if they really changed maybe
-          _savecallback();
-        }
-        break;
-      }
-    }
-	
-    if (stopConfigPortal) {
-	  stopConfigPortal = false;
-	  break;
-    }
+  // DNS, HTTP, LED, connect and housekeeping are all driven by the scheduler.
+  // No task blocks so every request is served within a loop pass.
+  setupTasks();
+  while (!_portalDone) {
+    unsigned long started = micros();
+    runTasks();
+    _loopTime.record(micros() - started);
     yield();
   }
   WiFi.mode(WIFI_STA);
-  if (TimedOut & WiFi.status() != WL_CONNECTED) {
+  if (_portalTimedOut && WiFi.status() != WL_CONNECTED) {
 	WiFi.begin();
     int connRes = waitForConnectResult();
     DEBUG_WM ("Timed out connection result: ");
@@ -305,55 +293,232 @@ boolean  WiFiManager::startConfigPortal(char const *apName, char const *apPasswo
   return  WiFi.status() == WL_CONNECTED;
 }
 
-int WiFiManager::connectWifi(String ssid, String pass) {
+void WiFiManager::setupTasks()
+{
+  unsigned long now = millis();
+  _tasks[TASK_LED]          = { "led",          &WiFiManager::taskLed,          1000, now };
+  _tasks[TASK_DNS]          = { "dns",          &WiFiManager::taskDns,          0,    now };
+  _tasks[TASK_HTTP]         = { "http",         &WiFiManager::taskHttp,         0,    now };
+  _tasks[TASK_CONNECT]      = { "connect",      &WiFiManager::taskConnect,      50,   now };
+  _tasks[TASK_HOUSEKEEPING] = { "housekeeping", &WiFiManager::taskHousekeeping, 100,  now };
+  _tasks[TASK_SCAN]         = { "scan",         &WiFiManager::taskScan,         250,  now };
+  _tasks[TASK_NTP]          = { "ntp",          &WiFiManager::taskNtp,          50,   now };
+  _tasks[TASK_REBOOT]       = { "reboot",       &WiFiManager::taskReboot,       100,  now };
+  _tasks[TASK_TAG]          = { "tag",          &WiFiManager::taskTag,          0,    now };
+  _reboot = REBOOT_NONE;
+  _portalDone = false;
+  _portalTimedOut = true;
+}
+
+// run every task whose deadline has passed, then move its deadline one interval ahead.
+// deadlines are compared as a signed difference so millis() rollover is harmless.
+void WiFiManager::runTasks()
+{
+  for (uint8_t i = 0; i < TASK_COUNT && !_portalDone; i++) {
+    WM_TASK &task = _tasks[i];
+    unsigned long now = millis();
+    if ((long)(now - task.deadline) < 0) continue;
+    task.deadline = now + task.interval;
+    (this->*task.handler)();
+  }
+}
+
+// push a task deadline ms into the future (e.g. give a response time to leave before acting)
+void WiFiManager::deferTask(uint8_t id, unsigned long ms)
+{
+  if (id < TASK_COUNT) _tasks[id].deadline = millis() + ms;
+}
+
+unsigned long WiFiManager::getTaskDeadline(uint8_t id)
+{
+  return (id < TASK_COUNT) ? _tasks[id].deadline : 0;
+}
+
+void WiFiManager::taskLed()
+{
+  //indicator led blinking in AP mode
+  AP_Led_Indicator(ap_mode);
+}
+
+void WiFiManager::taskDns()
+{
+  dnsServer->processRequests();
+}
+
+void WiFiManager::taskHttp()
+{
+  server->handleClients();
+}
+
+void WiFiManager::taskConnect()
+{
+  if (connect) {
+    connect = false;
+    _portalTimedOut = false;
+    DEBUG_WM(F("Connecting to new AP"));
+    // using user-provided  _ssid, _pass in place of system-stored ssid and pass
+    beginConnect(_ssid, _pass, true);
+  }
+  stepConnect();
+}
+
+// start an async scan when the cache is due for a refresh and merge the results once it completes.
+// no scan is started while a connect attempt owns the radio.
+void WiFiManager::taskScan()
+{
+  if (_scanRunning)
+  {
+    int n = WiFi.scanComplete();
+    if (n == WIFI_SCAN_RUNNING) return;
+    _scanRunning = false;
+    if (n >= 0) mergeScanResults(n);
+    else DEBUG_WM(F("Scan failed"));
+    WiFi.scanDelete();
+    return;
+  }
+  if (_connectState == CONNECT_RESET || _connectState == CONNECT_WAIT) return;
+  if (_scanLastStart != 0 && millis() - _scanLastStart < _scanInterval) return;
+  DEBUG_WM(F("Scan start"));
+  _scanLastStart = millis();
+  if (_scanLastStart == 0) _scanLastStart = 1; // 0 means never scanned
+  WiFi.scanNetworks(true);
+  _scanRunning = true;
+}
+
+void WiFiManager::taskHousekeeping()
+{
+  if (_configPortalTimeout != 0 && millis() - _configPortalStart >= _configPortalTimeout) {
+    DEBUG_WM(F("Config portal timed out"));
+    _portalDone = true;
+  }
+  if (stopConfigPortal) {
+    stopConfigPortal = false;
+    _portalDone = true;
+  }
+  if (_stateChanged) invalidateState();
+}
+
+// restart (or reset, wiping the credentials) once the page telling so had WM_REBOOT_DELAY to reach the browser;
+// the portal keeps serving until then
+void WiFiManager::scheduleReboot(RebootMode mode)
+{
+  _reboot = mode;
+  deferTask(TASK_REBOOT, WM_REBOOT_DELAY);
+}
+
+void WiFiManager::taskReboot()
+{
+  if (_reboot == REBOOT_NONE) return;
+  if (_reboot == REBOOT_RESET) {
+    DEBUG_WM(F("Resetting"));
+    WiFi.disconnect(true); // Wipe out WiFi credentials.
+    ESP.reset();
+  } else {
+    DEBUG_WM(F("Restarting"));
+    ESP.restart();
+  }
+}
+
+// Start a connect attempt. Nothing here waits on the radio, stepConnect() moves the
+// attempt forward from the connect task and the progress is visible on /json_connect_status.
+void WiFiManager::beginConnect(String ssid, String pass, bool userRequested)
+{
   DEBUG_WM(F("Connecting wifi with new parameters..."));
+  _connectSSID = ssid;
+  _connectPass = pass;
+  _connectUserRequested = userRequested;
+  _connectTriedWPS = false;
+  _connectResult = WL_IDLE_STATUS;
+  _connectStart = millis();
+  invalidateState();
   if (ssid != "")
   {
 	//Disconnect from network and wipe out old credentials.
 	//if either ssid or password not provided on submit, esp8266 sometimes locked up if new values different to
 	//previous stored values and device in the process of trying connecting to the network
-	resetSettings();
-	
-	//check if we've got static_ip settings, if we do, use those.
-	//using this way user only can change to dhcp/static ip on the first time logging to local network
-	//after module already in local network, SPIFFS_IP_Innitialize function below 
-	//will help user change to dhcp/static ip when needed.
-	
-	/*
-	if (_sta_static_ip)
-	{
-	  DEBUG_WM(F("Custom STA IP/GW/Subnet"));
-	  WiFi.config(_sta_static_ip, _sta_static_gw, _sta_static_sn);
-	  DEBUG_WM(WiFi.localIP());
-	}
-	*/
-	
-	WiFi.mode(WIFI_AP_STA); //It will start in station mode if it was previously in AP mode.
-	// interface for user manage ip address (dhcp/static) when module already in local network.
-	SPIFFS_IP_Innitialize();
-	if(is_Static_IP)
-	{
-		//WiFi.mode(WIFI_STA);
-		WiFi.begin(ssid.c_str(), pass.c_str());
-		WiFi.config(stringToIP(ip_info.static_ip), stringToIP(ip_info.gateway), stringToIP(ip_info.netmask));
-	}
-	else
-	{
-		WiFi.begin(ssid.c_str(), pass.c_str());// Start wifi with new values.
-	}
+	//same as resetSettings() but the settle time is waited out by the state machine.
+	DEBUG_WM(F("previous settings invalidated"));
+	WiFi.disconnect(true);
+	WiFi.softAPdisconnect();
+	WiFi.mode(WIFI_OFF);
+	setConnectState(CONNECT_RESET);
+  }
+  else
+  {
+	if (WiFi.SSID() == "") DEBUG_WM(F("No saved credentials"));
+	setConnectState(CONNECT_WAIT);
   }
-  else if(!WiFi.SSID()) 
+}
+
+void WiFiManager::setConnectState(ConnectState state)
+{
+  _connectState = state;
+  _connectStateAt = millis();
+  DEBUG_WM(F("Connect state: "));
+  DEBUG_WM(getConnectStateName(state));
+}
+
+void WiFiManager::stepConnect()
+{
+  switch (_connectState)
   {
-      DEBUG_WM(F("No saved credentials"));
+	case CONNECT_RESET:
+	  if (millis() - _connectStateAt < WM_CONNECT_RESET_SETTLE) return;
+	  WiFi.mode(WIFI_AP_STA); //It will start in station mode if it was previously in AP mode.
+	  // interface for user manage ip address (dhcp/static) when module already in local network.
+	  SPIFFS_IP_Innitialize();
+	  WiFi.begin(_connectSSID.c_str(), _connectPass.c_str());// Start wifi with new values.
+	  if (is_Static_IP)
+	  {
+		WiFi.config(ip_info.static_ip, ip_info.gateway, ip_info.netmask);
+	  }
+	  setConnectState(CONNECT_WAIT);
+	  break;
+
+	case CONNECT_WAIT:
+	{
+	  int connRes = WiFi.status();
+	  unsigned long timeout = (_connectTimeout == 0) ? WM_CONNECT_DEFAULT_TIMEOUT : _connectTimeout;
+	  if (connRes == WL_CONNECTED || connRes == WL_CONNECT_FAILED || connRes == WL_NO_SSID_AVAIL)
+	  {
+		finishConnect(connRes);
+	  }
+	  else if (millis() - _connectStateAt >= timeout)
+	  {
+		DEBUG_WM(F("Connection timed out"));
+		finishConnect(connRes);
+	  }
+	  break;
+	}
+
+	default: // idle or finished, nothing to drive
+	  break;
   }
-  int connRes = waitForConnectResult();
+}
+
+void WiFiManager::finishConnect(int connRes)
+{
+  _connectResult = connRes;
+  invalidateState();
+  DEBUG_WM(F("After waiting..."));
+  DEBUG_WM((millis() - _connectStart) / 1000.0);
+  DEBUG_WM(F("seconds"));
   DEBUG_WM ("Connection result: ");
   DEBUG_WM ( getStatus(connRes));
-  if(WiFi.status() == WL_CONNECTED)
+
+  if (connRes != WL_CONNECTED && _tryWPS && !_connectTriedWPS && _connectPass == "") //not connected, WPS enabled, no pass - first attempt
+  {
+	_connectTriedWPS = true;
+	startWPS();
+	setConnectState(CONNECT_WAIT); //should be connected at the end of WPS
+	return;
+  }
+
+  if (connRes == WL_CONNECTED)
   {
 	if(!wifi_credentials_ok) // this credentials not exists in SPIFFS so it's new one, should save it.
 	{
-		SPIFFS_Credentials(ssid,pass);
+		SPIFFS_Credentials(_connectSSID, _connectPass);
 		DEBUG_WM(F("Wifi credentials saved to SPIFFS."));
 	}
 	else
@@ -363,13 +528,51 @@ int WiFiManager::connectWifi(String ssid, String pass) {
 	ap_mode = false;
 	DEBUG_WM("Module can be accessed on local IP: ");
 	DEBUG_WM(WiFi.localIP());
+	setConnectState(CONNECT_CONNECTED);
+  }
+  else
+  {
+	setConnectState(CONNECT_FAILED);
+  }
+
+  if (!_connectUserRequested) return;
+
+  if (connRes != WL_CONNECTED) {
+    DEBUG_WM(F("Failed to connect."));
+    // Dual mode becomes flaky if not connected to a WiFi network. could be because too much 
+    // processor resources used for network connecting.
+    WiFi.mode(WIFI_AP); 
+  } 
+  else{
+    //notify that configuration has changed and any optional parameters should be saved
+    if ( _savecallback != NULL) {
+      //todo: check if any custom parameters actually exist, and check if they really changed maybe
+      _savecallback();
+    }
+  }
+
+  //flag set to exit after config
+  if (_shouldBreakAfterConfig)
+  {
+    if ( _savecallback != NULL) {
+      //todo: check if any custom parameters actually exist, and check if they really changed maybe
+      _savecallback();
+    }
+    _portalDone = true;
   }
-  if (_tryWPS && connRes != WL_CONNECTED && pass == "") //not connected, WPS enabled, no pass - first attempt
+}
+
+const char* WiFiManager::getConnectStateName(ConnectState state)
+{
+  switch (state)
   {
-    startWPS();
-    connRes = waitForConnectResult();//should be connected at the end of WPS
+	case CONNECT_IDLE: return "IDLE";
+	case CONNECT_RESET: return "RESET";
+	case CONNECT_WAIT: return "CONNECTING";
+	case CONNECT_CONNECTED: return "CONNECTED";
+	case CONNECT_FAILED: return "FAILED";
+	default: return "UNKNOWN";
   }
-  return connRes;
 }
 
 uint8_t WiFiManager::waitForConnectResult() 
@@ -436,6 +639,13 @@ void WiFiManager::resetSettings() {
   delay(500);
   return;
 }
+boolean WiFiManager::clearCredentials() {
+  DEBUG_WM(F("WiFi credentials cleared"));
+  loadConfig();
+  _config.ssid[0] = 0;
+  _config.pass[0] = 0;
+  return saveConfig();
+}
 void WiFiManager::setTimeout(unsigned long seconds) {
   setConfigPortalTimeout(seconds);
 }
@@ -464,6 +674,12 @@ void WiFiManager::setSTAStaticIPConfig(IPAddress ip, IPAddress gw, IPAddress sn)
   _sta_static_sn = sn;
 }
 
+void WiFiManager::setResponseCacheBudget(size_t bytes) {
+  _cacheBudget = bytes;
+  _cacheBudgetSet = true;
+  _cache.setBudget(bytes);
+}
+
 void WiFiManager::setMinimumSignalQuality(int quality) {
   _minimumQuality = quality;
 }
@@ -472,29 +688,40 @@ void WiFiManager::setBreakAfterConfig(boolean shouldBreak) {
   _shouldBreakAfterConfig = shouldBreak;
 }
 
-void WiFiManager::reportStatus(String &page)
+void WiFiManager::reportStatus(Print &page)
 {
   if (WiFi.SSID() != "")
   {
-	  page += F("Module has connected to AP <strong>");
-	  page += WiFi.SSID();
+	  page.print(F("Module has connected to AP <strong>"));
+	  page.print(WiFi.SSID());
 	  if (WiFi.status() == WL_CONNECTED){
-		  page += F(" </strong> and currently running on <strong>IP: </strong> <a href=\"http://");
-		  page += WiFi.localIP().toString();
-		  page += F("/\">");
-		  page += WiFi.localIP().toString();
-		  page += F("</a>");
+		  page.print(F(" </strong> and currently running on <strong>IP: </strong> <a href=\"http://"));
+		  page.print(WiFi.localIP());
+		  page.print(F("/\">"));
+		  page.print(WiFi.localIP());
+		  page.print(F("</a>"));
 	   }
 	  else {
-		  page += F(" but <strong>not currently connected</strong> to network.");
+		  page.print(F(" but <strong>not currently connected</strong> to network."));
 	  }
   }
   else 
   {
-	page += F("No network currently configured.");
+	page.print(F("No network currently configured."));
   }
 }
 
+/** Common head of the portal pages: title, script, styles and the custom head element */
+void WiFiManager::pageHead(Print &page, const char *title, boolean customStyle)
+{
+  renderTemplate(page, TPL_HEAD, {{'v', title}});
+  page.print(FPSTR(HTTP_SCRIPT));
+  page.print(FPSTR(HTTP_STYLE));
+  if (customStyle) page.print(FPSTR(HTTP_CUSTOM_STYLE));
+  page.print(_customHeadElement);
+  page.print(FPSTR(HTTP_HEAD_END));
+}
+
 /** Handle root or redirect to captive portal */
 void WiFiManager::handleRoot() {
   DEBUG_WM(F("Load WiFi credentials from spiffs."));
@@ -502,155 +729,108 @@ void WiFiManager::handleRoot() {
   if (captivePortal()) { // If caprive portal redirect instead of displaying the error page.
       return;
   }
-  server->sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
-  server->sendHeader("Pragma", "no-cache");
-  server->sendHeader("Expires", "-1");
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "ESP8266 Captive Portal");
-  page += FPSTR(HTTP_SCRIPT);
-  page += FPSTR(HTTP_STYLE);
-  page += _customHeadElement;
-  page += FPSTR(HTTP_HEAD_END);
-  page += "<h2>";
-  page += _apName;
-  page += "</h2>";
-  page += FPSTR(HTTP_PORTAL_OPTIONS);
-  page += F("<div class=\"msg\">");
+  ChunkedPrint page(server->client());
+  page.begin(200, "text/html");
+  pageHead(page, "ESP8266 Captive Portal", false);
+  page.print(F("<h2>"));
+  page.print(_apName);
+  page.print(F("</h2>"));
+  page.print(FPSTR(HTTP_PORTAL_OPTIONS));
+  page.print(F("<div class=\"msg\">"));
   reportStatus(page);
-  page += F("</div>");
-  page += FPSTR(HTTP_END);
-
-  server->send(200, "text/html", page);
+  page.print(F("</div>"));
+  page.print(FPSTR(HTTP_END));
+  page.end();
 
 }
 
 /** Wifi config page handler */
 void WiFiManager::handleWifi() {
-  server->sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
-  server->sendHeader("Pragma", "no-cache");
-  server->sendHeader("Expires", "-1");
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "WiFi Configuration");
-  page += FPSTR(HTTP_SCRIPT);
-  page += FPSTR(HTTP_STYLE);
-  page += FPSTR(HTTP_CUSTOM_STYLE);
-  page += _customHeadElement;
-  page += FPSTR(HTTP_HEAD_END);
-  page += F("<div>");
-  page += F("<ul class=\"breadcrumb\">");
-  page += F("<li><a href=\"/\">Home</a></li>");
-  page += F("<li><a href=\"#\">WiFi Configuration</a></li>");
-  page += F("</ul>");
-  page += F("</div>");
-  page += F("<h2>WiFi Configuration</h2>");
-  //Print list of WiFi networks that were found in earlier scan
-    if (numberOfNetworks == 0) {
-      page += F("WiFi scan found no networks. Restart configuration portal to scan again.");
+  ChunkedPrint page(server->client());
+  page.begin(200, "text/html");
+  pageHead(page, "WiFi Configuration", true);
+  page.print(F("<div>"));
+  page.print(F("<ul class=\"breadcrumb\">"));
+  page.print(F("<li><a href=\"/\">Home</a></li>"));
+  page.print(F("<li><a href=\"#\">WiFi Configuration</a></li>"));
+  page.print(F("</ul>"));
+  page.print(F("</div>"));
+  page.print(F("<h2>WiFi Configuration</h2>"));
+  //Print list of WiFi networks from the background scan cache
+    if (_scanCount == 0) {
+      page.print((_scanLastStart == 0 || _scanRunning) ? F("Scanning for WiFi networks, reload the page in a few seconds.") : F("WiFi scan found no networks."));
     } else {
-      //display networks in page
-      for (int i = 0; i < numberOfNetworks; i++) {
-        if(networkIndices[i] == -1) continue; // skip dups and those that are below the required quality
-
-        DEBUG_WM(WiFi.SSID(networkIndices[i]));
-        DEBUG_WM(WiFi.RSSI(networkIndices[i]));
-        int quality = getRSSIasQuality(WiFi.RSSI(networkIndices[i]));
-
-        String item = FPSTR(HTTP_ITEM);
-        String rssiQ;
-        rssiQ += quality;
-        item.replace("{v}", WiFi.SSID(networkIndices[i]));
-        item.replace("{r}", rssiQ);
-        if (WiFi.encryptionType(networkIndices[i]) != ENC_TYPE_NONE) {
-          item.replace("{i}", "l");
-        } else {
-            item.replace("{i}", "");
-        }
-        //DEBUG_WM(item);
-        page += item;
+      //display networks in page, the cache is kept sorted by signal strength
+      for (int i = 0; i < _scanCount; i++) {
+        const WM_SCAN_ENTRY &ap = _scanCache[i];
+        int quality = getRSSIasQuality(ap.rssi);
+        if (!(_minimumQuality == -1 || _minimumQuality < quality)) continue; // skip those below the required quality
+
+        char rssiQ[5];
+        snprintf(rssiQ, sizeof(rssiQ), "%d", quality);
+        renderTemplate(page, TPL_ITEM, {{'v', ap.ssid}, {'r', rssiQ}, {'i', ap.encrypted ? "l" : ""}});
         delay(0);
         }
-    page += "<br/>";
+    page.print(F("<br/>"));
     }
 
-  page += FPSTR(HTTP_FORM_START);
-  char parLength[2];
+  page.print(FPSTR(HTTP_FORM_START));
+  char parLength[5];
   // add the extra parameters to the form
   for (int i = 0; i < _paramsCount; i++) {
     if (_params[i] == NULL) {
       break;
     }
 
-	String pitem;
-	switch (_params[i]->getLabelPlacement()) {
-    case WFM_LABEL_BEFORE:
-	  pitem = FPSTR(HTTP_FORM_LABEL);
-	  pitem += FPSTR(HTTP_FORM_PARAM);
-      break;
-    case WFM_LABEL_AFTER:
-	  pitem = FPSTR(HTTP_FORM_PARAM);
-	  pitem += FPSTR(HTTP_FORM_LABEL);
-      break;
-    default:
-	  // WFM_NO_LABEL
-      pitem = FPSTR(HTTP_FORM_PARAM);
-    break;
-  }
-
-    if (_params[i]->getID() != NULL) {
-      pitem.replace("{i}", _params[i]->getID());
-      pitem.replace("{n}", _params[i]->getID());
-      pitem.replace("{p}", _params[i]->getPlaceholder());
-      snprintf(parLength, 2, "%d", _params[i]->getValueLength());
-      pitem.replace("{l}", parLength);
-      pitem.replace("{v}", _params[i]->getValue());
-      pitem.replace("{c}", _params[i]->getCustomHTML());
-    } else {
-      pitem = _params[i]->getCustomHTML();
+    if (_params[i]->getID() == NULL) {
+      page.print(_params[i]->getCustomHTML());
+      continue;
     }
 
-    page += pitem;
+    snprintf(parLength, sizeof(parLength), "%d", _params[i]->getValueLength());
+    const TemplateArg args[] = {
+      {'i', _params[i]->getID()},
+      {'n', _params[i]->getID()},
+      {'p', _params[i]->getPlaceholder()},
+      {'l', parLength},
+      {'v', _params[i]->getValue()},
+      {'c', _params[i]->getCustomHTML()}
+    };
+    switch (_params[i]->getLabelPlacement()) {
+      case WFM_LABEL_BEFORE:
+        renderTemplate(page, TPL_FORM_LABEL, args, 6);
+        renderTemplate(page, TPL_FORM_PARAM, args, 6);
+        break;
+      case WFM_LABEL_AFTER:
+        renderTemplate(page, TPL_FORM_PARAM, args, 6);
+        renderTemplate(page, TPL_FORM_LABEL, args, 6);
+        break;
+      default:
+        // WFM_NO_LABEL
+        renderTemplate(page, TPL_FORM_PARAM, args, 6);
+        break;
+    }
   }
   if (_params[0] != NULL) {
-    page += "<br/>";
+    page.print(F("<br/>"));
   }
 
   if (_sta_static_ip) {
+    char ip[16];
+    toCharsIP(_sta_static_ip, ip);
+    renderTemplate(page, TPL_FORM_PARAM, {{'i', "ip"}, {'n', "ip"}, {'p', "Static IP"}, {'l', "15"}, {'v', ip}});
+    toCharsIP(_sta_static_gw, ip);
+    renderTemplate(page, TPL_FORM_PARAM, {{'i', "gw"}, {'n', "gw"}, {'p', "Static Gateway"}, {'l', "15"}, {'v', ip}});
+    toCharsIP(_sta_static_sn, ip);
+    renderTemplate(page, TPL_FORM_PARAM, {{'i', "sn"}, {'n', "sn"}, {'p', "Subnet"}, {'l', "15"}, {'v', ip}});
 
-    String item = FPSTR(HTTP_FORM_PARAM);
-    item.replace("{i}", "ip");
-    item.replace("{n}", "ip");
-    item.replace("{p}", "Static IP");
-    item.replace("{l}", "15");
-    item.replace("{v}", _sta_static_ip.toString());
-
-    page += item;
-
-    item = FPSTR(HTTP_FORM_PARAM);
-    item.replace("{i}", "gw");
-    item.replace("{n}", "gw");
-    item.replace("{p}", "Static Gateway");
-    item.replace("{l}", "15");
-    item.replace("{v}", _sta_static_gw.toString());
-
-    page += item;
-
-    item = FPSTR(HTTP_FORM_PARAM);
-    item.replace("{i}", "sn");
-    item.replace("{n}", "sn");
-    item.replace("{p}", "Subnet");
-    item.replace("{l}", "15");
-    item.replace("{v}", _sta_static_sn.toString());
-
-    page += item;
-
-    page += "<br/>";
+    page.print(F("<br/>"));
   }
 
-  page += FPSTR(HTTP_FORM_END);
+  page.print(FPSTR(HTTP_FORM_END));
 
-  page += FPSTR(HTTP_END);
-
-  server->send(200, "text/html", page);
+  page.print(FPSTR(HTTP_END));
+  page.end();
 
   DEBUG_WM(F("Config page sent"));
 }
@@ -659,83 +839,66 @@ void WiFiManager::handleWifi() {
 void WiFiManager::handleWifiSave() {
   DEBUG_WM(F("WiFi save"));
 
-  _ssid = server->arg("s").c_str();
-  _pass = server->arg("p").c_str();
+  PortalServer::RequestView req = server->request();
+  _ssid = req.arg("s");
+  _pass = req.arg("p");
 
   //parameters
   for (int i = 0; i < _paramsCount; i++) {
     if (_params[i] == NULL) {
       break;
     }
-    //read parameter
-    String value = server->arg(_params[i]->getID()).c_str();
-    //store it in array
-    value.toCharArray(_params[i]->_value, _params[i]->_length);
+    //read parameter straight into its array
+    req.argCopy(_params[i]->getID(), _params[i]->_value, _params[i]->_length);
+    if (_params[i]->getID()) _settings.put(_params[i]->getID(), _params[i]->_value);
     DEBUG_WM(F("Parameter"));
     DEBUG_WM(_params[i]->getID());
-    DEBUG_WM(value);
+    DEBUG_WM(_params[i]->_value);
   }
 
-  if (server->arg("ip") != "") {
+  if (req.argIP("ip", _sta_static_ip)) {
     DEBUG_WM(F("static ip"));
-    DEBUG_WM(server->arg("ip"));
-    //_sta_static_ip.fromString(server->arg("ip"));
-    String ip = server->arg("ip");
-    optionalIPFromString(&_sta_static_ip, ip.c_str());
+    DEBUG_WM(req.arg("ip"));
   }
-  if (server->arg("gw") != "") {
+  if (req.argIP("gw", _sta_static_gw)) {
     DEBUG_WM(F("static gateway"));
-    DEBUG_WM(server->arg("gw"));
-    String gw = server->arg("gw");
-    optionalIPFromString(&_sta_static_gw, gw.c_str());
+    DEBUG_WM(req.arg("gw"));
   }
-  if (server->arg("sn") != "") {
+  if (req.argIP("sn", _sta_static_sn)) {
     DEBUG_WM(F("static netmask"));
-    DEBUG_WM(server->arg("sn"));
-    String sn = server->arg("sn");
-    optionalIPFromString(&_sta_static_sn, sn.c_str());
+    DEBUG_WM(req.arg("sn"));
   }
 
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "Credentials Saved");
-  page += FPSTR(HTTP_SCRIPT);
-  page += FPSTR(HTTP_STYLE);
-  page += _customHeadElement;
-  page += FPSTR(HTTP_HEAD_END);
-  page += FPSTR(HTTP_SAVED);
-  page.replace("{v}", _apName);
-  page.replace("{x}", _ssid);
-  page += FPSTR(HTTP_END);
-
-  server->send(200, "text/html", page);
+  ChunkedPrint page(server->client());
+  page.begin(200, "text/html");
+  pageHead(page, "Credentials Saved", false);
+  renderTemplate(page, TPL_SAVED, {{'v', _apName}, {'x', _ssid.c_str()}});
+  page.print(FPSTR(HTTP_CONNECT_POLL));
+  page.print(FPSTR(HTTP_END));
+  page.end();
 
   DEBUG_WM(F("WiFi save page sent."));
 
   connect = true; //signal ready to connect/reset
+  deferTask(TASK_CONNECT, 2000); // let the saved page reach the client before the radio is reconfigured
 }
 /** Handle shut down the server page */
 void WiFiManager::handleServerClose() {
     DEBUG_WM(F("Server Close"));
-    server->sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
-    server->sendHeader("Pragma", "no-cache");
-    server->sendHeader("Expires", "-1");
-    String page = FPSTR(HTTP_HEAD);
-    page.replace("{v}", "Close Server");
-    page += FPSTR(HTTP_SCRIPT);
-    page += FPSTR(HTTP_STYLE);
-    page += _customHeadElement;
-    page += FPSTR(HTTP_HEAD_END);
-    page += F("<div class=\"msg\">");
-    page += F("My network is <strong>");
-    page += WiFi.SSID();
-    page += F("</strong><br>");
-    page += F("My IP address is <strong>");
-    page += WiFi.localIP().toString();
-    page += F("</strong><br><br>");
-    page += F("Configuration server closed...<br><br>");
+    ChunkedPrint page(server->client());
+    page.begin(200, "text/html");
+    pageHead(page, "Close Server", false);
+    page.print(F("<div class=\"msg\">"));
+    page.print(F("My network is <strong>"));
+    page.print(WiFi.SSID());
+    page.print(F("</strong><br>"));
+    page.print(F("My IP address is <strong>"));
+    page.print(WiFi.localIP());
+    page.print(F("</strong><br><br>"));
+    page.print(F("Configuration server closed...<br><br>"));
     //page += F("Push button on device to restart configuration server!");
-    page += FPSTR(HTTP_END);
-    server->send(200, "text/html", page);
+    page.print(FPSTR(HTTP_END));
+    page.end();
     stopConfigPortal = true; //signal ready to shutdown config portal
 	DEBUG_WM(F("Server close page sent."));
 
@@ -743,175 +906,209 @@ void WiFiManager::handleServerClose() {
 /** Handle the info page */
 void WiFiManager::handleInfo() {
   DEBUG_WM(F("Info"));
-  server->sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
-  server->sendHeader("Pragma", "no-cache");
-  server->sendHeader("Expires", "-1");
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "Extra Functions");
-  page += FPSTR(HTTP_SCRIPT);
-  page += FPSTR(HTTP_STYLE);
-  page += FPSTR(HTTP_CUSTOM_STYLE);
-  page += _customHeadElement;
-  page += FPSTR(HTTP_HEAD_END);
-  page += F("<div>");
-  page += F("<ul class=\"breadcrumb\">");
-  page += F("<li><a href=\"/\">Home</a></li>");
-  page += F("<li><a href=\"#\">Extra Functions</a></li>");
-  page += F("</ul>");
-  page += F("</div>");
+  ChunkedPrint page(server->client());
+  page.begin(200, "text/html");
+  pageHead(page, "Extra Functions", true);
+  page.print(F("<div>"));
+  page.print(F("<ul class=\"breadcrumb\">"));
+  page.print(F("<li><a href=\"/\">Home</a></li>"));
+  page.print(F("<li><a href=\"#\">Extra Functions</a></li>"));
+  page.print(F("</ul>"));
+  page.print(F("</div>"));
   
   
-  page += F("<h2>WiFi Information</h2>");
+  page.print(F("<h2>WiFi Information</h2>"));
   reportStatus(page);
-  page += F("<h3>Device Data</h3>");
-  page += F("<table class=\"gpio_table\" width=\"100%\">");
-  page += F("<thead><tr><th>Name</th><th>Value</th></tr></thead><tbody><tr><td>Chip ID</td><td>");
-  page += ESP.getChipId();
-  page += F("</td></tr>");
-  page += F("<tr><td>Flash Chip ID</td><td>");
-  page += ESP.getFlashChipId();
-  page += F("</td></tr>");
-  page += F("<tr><td>IDE Flash Size</td><td>");
-  page += ESP.getFlashChipSize();
-  page += F(" bytes</td></tr>");
-  page += F("<tr><td>Real Flash Size</td><td>");
-  page += ESP.getFlashChipRealSize();
-  page += F(" bytes</td></tr>");
-  page += F("<tr><td>Access Point IP</td><td>");
-  page += WiFi.softAPIP().toString();
-  page += F("</td></tr>");
-  page += F("<tr><td>Access Point MAC</td><td>");
-  page += WiFi.softAPmacAddress();
-  page += F("</td></tr>");
-
-  page += F("<tr><td>SSID</td><td>");
-  page += WiFi.SSID();
-  page += F("</td></tr>");
-  page += F("<tr><td>Station IP</td><td>");
-  page += WiFi.localIP().toString();
-  page += F("</td></tr>");
-  page += F("<tr><td>Station MAC</td><td>");
-  page += WiFi.macAddress();
-  page += F("</td></tr>");
-  page += F("</tbody></table>");
-  page += F("<h3>Extra Functions</h3>");
-  page += F("<table class=\"gpio_table\">");
-  page += F("<thead><tr><th width=\"150px\">Functions</th><th>Description</th></tr></thead><tbody>");
+  page.print(F("<h3>Device Data</h3>"));
+  page.print(F("<table class=\"gpio_table\" width=\"100%\">"));
+  page.print(F("<thead><tr><th>Name</th><th>Value</th></tr></thead><tbody><tr><td>Chip ID</td><td>"));
+  page.print(ESP.getChipId());
+  page.print(F("</td></tr>"));
+  page.print(F("<tr><td>Flash Chip ID</td><td>"));
+  page.print(ESP.getFlashChipId());
+  page.print(F("</td></tr>"));
+  page.print(F("<tr><td>IDE Flash Size</td><td>"));
+  page.print(ESP.getFlashChipSize());
+  page.print(F(" bytes</td></tr>"));
+  page.print(F("<tr><td>Real Flash Size</td><td>"));
+  page.print(ESP.getFlashChipRealSize());
+  page.print(F(" bytes</td></tr>"));
+  page.print(F("<tr><td>Access Point IP</td><td>"));
+  page.print(WiFi.softAPIP());
+  page.print(F("</td></tr>"));
+  page.print(F("<tr><td>Access Point MAC</td><td>"));
+  page.print(WiFi.softAPmacAddress());
+  page.print(F("</td></tr>"));
+
+  page.print(F("<tr><td>SSID</td><td>"));
+  page.print(WiFi.SSID());
+  page.print(F("</td></tr>"));
+  page.print(F("<tr><td>Station IP</td><td>"));
+  page.print(WiFi.localIP());
+  page.print(F("</td></tr>"));
+  page.print(F("<tr><td>Station MAC</td><td>"));
+  page.print(WiFi.macAddress());
+  page.print(F("</td></tr>"));
+  page.print(F("</tbody></table>"));
+  page.print(F("<h3>Extra Functions</h3>"));
+  page.print(F("<table class=\"gpio_table\">"));
+  page.print(F("<thead><tr><th width=\"150px\">Functions</th><th>Description</th></tr></thead><tbody>"));
   //page += F("<tr><td><a href=\"/\">/</a></td>");
   //page += F("<td>Menu page.</td></tr>");
-  page += F("<tr><td><a href=\"/json_module_wifi_info\"> WiFi Info</a></td>");
-  page += F("<td>Return the wifi configuration details of the module in JSON format. Interface for programmatic wifi configuration.</td></tr>");
-  page += F("<tr><td><a href=\"/json_wifi_scan_result\"> WiFi Scan Result</a></td>");
-  page += F("<td>Return the wifi scan result in JSON format. Interface for programmatic wifi configuration.</td></tr>");
-  page += F("<tr><td><a href=\"/time\"> NTP Time</a></td>");
-  page += F("<td>Return local time (GMT+7) in JSON format. Interface for programmatic time configuration.</td></tr>");
-  page += F("<tr><td><a href=\"/restart\"> Restart</a></td>");
-  page += F("<td>Restart the ESP device. All the WiFi configuration will be retained. The esp8266 module will automatically connect to previous known WiFi network.</td></tr>");  
-  page += F("<tr><td><a href=\"/exit_portal\"> Exit Portal </a></td>");
-  page += F("<td>Exit the captive portal, close the configuration server and configuration WiFi network.</td></tr>");
-  page += F("<tr><td><a href=\"/factory_reset\"> Factory Reset</a></td>");
-  page += F("<td>Factory reset esp8266 module, delete all wifi configuration and reboot. The esp8266 module will not reconnect to a network until new WiFi configuration data is entered.</td></tr>");
-  page += F("</table>");
-  page += F("<p/>");
-  page += FPSTR(HTTP_END);
-  server->send(200, "text/html", page);
+  page.print(F("<tr><td><a href=\"/json_module_wifi_info\"> WiFi Info</a></td>"));
+  page.print(F("<td>Return the wifi configuration details of the module in JSON format. Interface for programmatic wifi configuration.</td></tr>"));
+  page.print(F("<tr><td><a href=\"/json_wifi_scan_result\"> WiFi Scan Result</a></td>"));
+  page.print(F("<td>Return the wifi scan result in JSON format. Interface for programmatic wifi configuration.</td></tr>"));
+  page.print(F("<tr><td><a href=\"/time\"> NTP Time</a></td>"));
+  page.print(F("<td>Return local time (GMT+7) in JSON format. Interface for programmatic time configuration.</td></tr>"));
+  page.print(F("<tr><td><a href=\"/restart\"> Restart</a></td>"));
+  page.print(F("<td>Restart the ESP device. All the WiFi configuration will be retained. The esp8266 module will automatically connect to previous known WiFi network.</td></tr>"));  
+  page.print(F("<tr><td><a href=\"/exit_portal\"> Exit Portal </a></td>"));
+  page.print(F("<td>Exit the captive portal, close the configuration server and configuration WiFi network.</td></tr>"));
+  page.print(F("<tr><td><a href=\"/factory_reset\"> Factory Reset</a></td>"));
+  page.print(F("<td>Factory reset esp8266 module, delete all wifi configuration and reboot. The esp8266 module will not reconnect to a network until new WiFi configuration data is entered.</td></tr>"));
+  page.print(F("</table>"));
+  page.print(F("<p/>"));
+  page.print(FPSTR(HTTP_END));
+  page.end();
   DEBUG_WM(F("Sent info page"));
 }
 /** Handle the state page */
 void WiFiManager::handleState() {
   DEBUG_WM(F("State - json"));
+  if (_stateChanged) invalidateState();
+  size_t len;
+  const uint8_t *body = _cache.get("/json_module_wifi_info", 0, len);
+  if (body != NULL) {
+    server->sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
+    server->sendBody(200, "application/json", body, len);
+    return;
+  }
+  ResponseCache::Capture capture;
+  writeState(capture);
+  if (!capture.ok()) { // out of heap, stream it
+    ChunkedPrint page(server->client());
+    page.begin(200, "application/json");
+    writeState(page);
+    page.end();
+    return;
+  }
   server->sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
-  server->sendHeader("Pragma", "no-cache");
-  server->sendHeader("Expires", "-1");
-  String page = F("{\"Soft_AP_IP\":\"");
-  page += WiFi.softAPIP().toString();
-  page += F("\",\"Soft_AP_MAC\":\"");
-  page += WiFi.softAPmacAddress();
-  page += F("\",\"Station_IP\":\"");
-  page += WiFi.localIP().toString();
-  page += F("\",\"Station_MAC\":\"");
-  page += WiFi.macAddress();
-  page += F("\",");
-  if (WiFi.psk()!=""){
-  	  page += F("\"Password\":true,");
-    }
-  else {
-  	  page += F("\"Password\":false,");
-    }
-  page += F("\"SSID\":\"");
-  page += WiFi.SSID();
-  page += F("\"}");
-  server->send(200, "application/json", page);
+  server->sendBody(200, "application/json", capture.data(), capture.length());
+  len = capture.length();
+  _cache.put("/json_module_wifi_info", 0, capture.release(), len);
   DEBUG_WM(F("States page in json format sent."));
 }
 
+//the wifi info, cached until invalidateState()
+void WiFiManager::writeState(Print &out) {
+  JsonWriter json(out);
+  uint8_t mac[6];
+  char macText[18];
+  json.beginObject();
+  json.member("Soft_AP_IP", WiFi.softAPIP());
+  toCharsMac(WiFi.softAPmacAddress(mac), macText);
+  json.member("Soft_AP_MAC", (const char*)macText);
+  json.member("Station_IP", WiFi.localIP());
+  toCharsMac(WiFi.macAddress(mac), macText);
+  json.member("Station_MAC", (const char*)macText);
+  json.member("Password", WiFi.psk().length() > 0);
+  json.member("SSID", WiFi.SSID().c_str());
+  json.endObject();
+}
+
+//drop the cached answers that show the station state
+void WiFiManager::invalidateState() {
+  _stateChanged = false;
+  _cache.invalidate("/json_module_wifi_info");
+}
+
+/** Prometheus metrics: per route requests, bytes, latency and heap change, scheduler pass time and heap */
+void WiFiManager::handleMetrics() {
+  ChunkedPrint page(server->client());
+  page.begin(200, "text/plain; version=0.0.4");
+  server->writeMetrics(page);
+  printMetricHeader(page, "wm_loop_duration_seconds", "histogram", "Time of one portal scheduler pass.");
+  _loopTime.print(page, "wm_loop_duration_seconds", NULL);
+  dnsServer->writeMetrics(page);
+  _settings.writeMetrics(page);
+  _cache.writeMetrics(page);
+  printMetricHeader(page, "wm_heap_free_bytes", "gauge", "Free heap now.");
+  page.print(F("wm_heap_free_bytes "));
+  page.print(ESP.getFreeHeap());
+  page.print('\n');
+  printMetricHeader(page, "wm_heap_min_free_bytes", "gauge", "Lowest free heap seen after a request.");
+  page.print(F("wm_heap_min_free_bytes "));
+  page.print(server->heapLow());
+  page.print('\n');
+  page.end();
+}
+
+/** Handle the connect progress, polled by the saved page while the connect state machine runs */
+void WiFiManager::handleConnectStatus() {
+  ChunkedPrint page(server->client());
+  page.begin(200, "application/json");
+  JsonWriter json(page);
+  json.beginObject();
+  json.member("State", getConnectStateName(_connectState));
+  json.member("SSID", _connectSSID.c_str());
+  json.member("Elapsed", (_connectState == CONNECT_IDLE) ? 0UL : (unsigned long)(millis() - _connectStart));
+  json.member("Status", getStatus(WiFi.status()));
+  json.key("Station_IP");
+  if (WiFi.status() == WL_CONNECTED) json.value(WiFi.localIP());
+  else json.value("");
+  json.endObject();
+  page.end();
+}
+
 /** Handle the scan page */
 void WiFiManager::handleScan() {
   DEBUG_WM(F("State - json"));
-  server->sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
-  server->sendHeader("Pragma", "no-cache");
-  server->sendHeader("Expires", "-1");
-
-  int n;
-  int *indices;
-  int **indicesptr = &indices;
-  //Space for indices array allocated on heap in scanWifiNetworks
-  //and should be freed when indices no longer required.
-  n = scanWifiNetworks(indicesptr);
-  DEBUG_WM(F("In handleScan, scanWifiNetworks done"));
-  String page = F("{\"Access_Points\":[");
-  //display networks in page
-  for (int i = 0; i < n; i++) {
-          if(indices[i] == -1) continue; // skip duplicates and those that are below the required quality
-          if(i != 0) page += F(", ");
-          DEBUG_WM(WiFi.SSID(indices[i]));
-          DEBUG_WM(WiFi.RSSI(indices[i]));
-          int quality = getRSSIasQuality(WiFi.RSSI(indices[i]));
-          String item = FPSTR(JSON_ITEM);
-          String rssiQ;
-          rssiQ += quality;
-          item.replace("{v}", WiFi.SSID(indices[i]));
-          item.replace("{r}", rssiQ);
-          if (WiFi.encryptionType(indices[i]) != ENC_TYPE_NONE) {
-            item.replace("{i}", "true");
-          } else {
-            item.replace("{i}", "false");
-          }
-          //DEBUG_WM(item);
-          page += item;
+  ChunkedPrint page(server->client());
+  page.begin(200, "application/json");
+  JsonWriter json(page);
+
+  //served from the background scan cache, Age is the number of seconds since the AP was last seen
+  unsigned long now = millis();
+  json.beginObject();
+  json.key("Access_Points");
+  json.beginArray();
+  for (int i = 0; i < _scanCount; i++) {
+          const WM_SCAN_ENTRY &ap = _scanCache[i];
+          int quality = getRSSIasQuality(ap.rssi);
+          if (!(_minimumQuality == -1 || _minimumQuality < quality)) continue; // skip those below the required quality
+          char rssiQ[12];
+          JsonWriter::formatInt(quality, rssiQ);
+          json.beginObject();
+          json.member("SSID", (const char*)ap.ssid);
+          json.member("Encryption", ap.encrypted);
+          json.member("Quality", (const char*)rssiQ); // a string, as it always was
+          json.member("Age", (now - ap.seen) / 1000);
+          json.endObject();
           delay(0);
   }
-  free(indices); //indices array no longer required so free memory
-  page += F("]}");
-  server->send(200, "application/json", page);
+  json.endArray();
+  json.endObject();
+  page.end();
   DEBUG_WM(F("Sent WiFi scan data ordered by signal strength in json format"));
 }
 
 /** Handle the reset page */
 void WiFiManager::handleReset() {
   DEBUG_WM(F("Reset"));
-  server->sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
-  server->sendHeader("Pragma", "no-cache");
-  server->sendHeader("Expires", "-1");
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "WiFi Information");
-  page += FPSTR(HTTP_SCRIPT);
-  page += FPSTR(HTTP_STYLE);
-  page += _customHeadElement;
-  page += FPSTR(HTTP_HEAD_END);
-  page += F("ESP module will be reset in a few seconds.");
-  page += FPSTR(HTTP_END);
-  server->send(200, "text/html", page);
+  ChunkedPrint page(server->client());
+  page.begin(200, "text/html");
+  pageHead(page, "WiFi Information", false);
+  page.print(F("ESP module will be reset in a few seconds."));
+  page.print(FPSTR(HTTP_END));
+  page.end();
 
   DEBUG_WM(F("Reset page sent."));
-  delay(5000);
-  WiFi.disconnect(true); // Wipe out WiFi credentials.
-  ESP.reset();
-  delay(2000);
+  scheduleReboot(REBOOT_RESET);
 }
 
 String WiFiManager::getContentType(String filename){
-  if(server->hasArg(F("download"))) return F("application/octet-stream");
+  if(server->request().hasArg("download")) return F("application/octet-stream");
   else if(filename.endsWith(F(".htm"))) return F("text/html");
   else if(filename.endsWith(F(".html"))) return F("text/html");
   else if(filename.endsWith(F(".css"))) return F("text/css");
@@ -927,245 +1124,972 @@ String WiFiManager::getContentType(String filename){
   return F("text/plain");
 }
 
-void WiFiManager::handleGPIOControl(){
-  DEBUG_WM(F("GPIO Control"));
-  String path = F("/gpio.html");
-  String contentType = getContentType(path);
-  String pathWithGz = path + F(".gz");
-  if(SPIFFS.exists(pathWithGz) || SPIFFS.exists(path))
-  {
-    if(SPIFFS.exists(pathWithGz))
-    {
-      path += F(".gz");
-    }
-    File file = SPIFFS.open(path, "r");
-    size_t sent = server->streamFile(file, contentType);
-    file.close();
+// Logical asset paths ("/gpio.html") are resolved to the files that back them ("/gpio.html",
+// "/gpio.html.gz", "/gpio.html.br") once, the answer (including "missing") is kept in a small table so
+// a later hit costs a single SPIFFS open. Entries are dropped by invalidateAsset() whenever the editor
+// changes a file. The table also holds the ETag of every variant so conditional requests are answered
+// without touching SPIFFS at all.
+WiFiManager::WM_ASSET_ENTRY* WiFiManager::findAsset(const char *path)
+{
+  for (uint8_t i = 0; i < WM_ASSET_CACHE_SIZE; i++) {
+    if (_assetCache[i].path[0] != 0 && strcmp(_assetCache[i].path, path) == 0) return &_assetCache[i];
   }
-  DEBUG_WM(F("GPIO page sent"));
+  return NULL;
 }
 
-void WiFiManager::handleGPIOToggle(){
-	DEBUG_WM("GPIO Toggle");
-	if(server->arg("status") == "On")
-	{
-		digitalWrite(atoi(server->arg("pin").c_str()), HIGH);
-		DEBUG_WM(F("GPIO turn HIGH"));
-		DEBUG_WM(server->arg("pin").c_str());
-	}
-	else
-	{
-		digitalWrite(atoi(server->arg("pin").c_str()), LOW);
-		DEBUG_WM(F("GPIO turn LOW"));
-		DEBUG_WM(server->arg("pin").c_str());
-	}
-	switch(atoi(server->arg("pin").c_str()))
-	{
-		case 0:
-			gpio0.status = server->arg("status");
-			gpio0.alias = server->arg("alias");
-			break;
-		case 2:
-			gpio2.status = server->arg("status");
-			gpio2.alias = server->arg("alias");
-			break;
-		case 5:
-			gpio5.status = server->arg("status");
-			gpio5.alias = server->arg("alias");
-			break;
-		case 12:
-			gpio12.status = server->arg("status");
-			gpio12.alias = server->arg("alias");
-			break;
-		case 14:
-			gpio14.status = server->arg("status");
-			gpio14.alias = server->arg("alias");
-			break;
-		case 15:
-			gpio15.status = server->arg("status");
-			gpio15.alias = server->arg("alias");
-			break;
-		case 16:
-			gpio16.status = server->arg("status");
-			gpio16.alias = server->arg("alias");
-			break;
-	}
-	server->send(200,"text/html","");
+static const char* const assetSuffix[]   = { "", ".gz", ".br" };
+static const char* const assetEncoding[] = { NULL, "gzip", "br" };
+
+void WiFiManager::assetPhysicalPath(const WM_ASSET_ENTRY *entry, uint8_t variant, char *physical, size_t size)
+{
+  snprintf(physical, size, "%s%s", entry->path, assetSuffix[variant]);
 }
 
-void WiFiManager::handleFirmwareUpdatePage()
+WiFiManager::WM_ASSET_ENTRY* WiFiManager::resolveAsset(const String &path)
 {
-  DEBUG_WM(F("Firmare Update"));
-  String path = F("/firmware_update.html");
-  String contentType = getContentType(path);
-  String pathWithGz = path + F(".gz");
-  if(SPIFFS.exists(pathWithGz) || SPIFFS.exists(path))
-  {
-    if(SPIFFS.exists(pathWithGz))
-    {
-      path += F(".gz");
-    }
-    File file = SPIFFS.open(path, "r");
-    size_t sent = server->streamFile(file, contentType);
-    file.close();
-  }
-  DEBUG_WM(F("Firmare update page sent"));
+  if (path.length() >= WM_ASSET_PATH_LEN) return NULL; // too long for SPIFFS anyway
+  WM_ASSET_ENTRY *entry = findAsset(path.c_str());
+  if (entry != NULL) return entry;
+
+  entry = &_assetCache[_assetCacheNext];
+  _assetCacheNext = (_assetCacheNext + 1) % WM_ASSET_CACHE_SIZE;
+  strcpy(entry->path, path.c_str());
+  entry->variants = 0;
+  entry->modified = 0;
+
+  char physical[WM_ASSET_PATH_LEN + 3];
+  for (uint8_t v = 0; v < ASSET_VARIANTS; v++) {
+    assetPhysicalPath(entry, v, physical, sizeof(physical));
+    if (SPIFFS.exists(physical)) entry->variants |= (1 << v);
+  }
+  // a variant missing from the manifest (copied to SPIFFS without wmimage) is sent without an ETag
+  // until the tag task has hashed it in the background
+  entry->pending = entry->variants & ~readAssetTags(entry);
+  return entry;
+}
+
+//pick the variant to send: brotli, then gzip when the client accepts them, else identity.
+//a compressed only asset is still sent compressed to clients that do not say they accept it.
+uint8_t WiFiManager::negotiateAsset(const WM_ASSET_ENTRY *entry)
+{
+  const char *accept = server->request().header("Accept-Encoding");
+  if ((entry->variants & (1 << ASSET_BROTLI)) && acceptsEncoding(accept, "br")) return ASSET_BROTLI;
+  if ((entry->variants & (1 << ASSET_GZIP)) && acceptsEncoding(accept, "gzip")) return ASSET_GZIP;
+  if (entry->variants & (1 << ASSET_PLAIN)) return ASSET_PLAIN;
+  return (entry->variants & (1 << ASSET_GZIP)) ? ASSET_GZIP : ASSET_BROTLI;
 }
 
-void WiFiManager::handleUpdateHeader()
+//true when the Accept-Encoding list names coding (or "*") without q=0
+boolean WiFiManager::acceptsEncoding(const char *accept, const char *coding)
 {
-	server->sendHeader("Connection", "close");
-    server->sendHeader("Access-Control-Allow-Origin", "*");
-    server->send(200, "text/plain", (Update.hasError())?"Fail To Update Firmware.":"Firmware Updated Successfully.");
-    ESP.restart();
+  size_t clen = strlen(coding);
+  const char *p = accept;
+  while (*p) {
+    while (*p == ' ' || *p == ',') p++;
+    const char *token = p;
+    while (*p && *p != ',' && *p != ';' && *p != ' ') p++;
+    size_t tlen = p - token;
+    boolean match = (tlen == clen && strncasecmp(token, coding, clen) == 0) || (tlen == 1 && *token == '*');
+    const char *q = NULL;
+    while (*p && *p != ',') {
+      if (*p == 'q' && p[1] == '=') q = p + 2;
+      p++;
+    }
+    if (match && tlen > 0) return q == NULL || atof(q) > 0;
+  }
+  return false;
 }
 
-void WiFiManager::handleUpdate()
+//forget the resolution of path, given as a logical or a physical (.gz) file name
+void WiFiManager::invalidateAsset(const String &path)
 {
-	DEBUG_WM(F("Handle Firmare Update"));
-	HTTPUpload& upload = server->upload();
-      if(upload.status == UPLOAD_FILE_START)
-	  {
-		DEBUG_WM(F("Upload file start"));
-        uint32_t maxSketchSpace = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
-        if(!Update.begin(maxSketchSpace))//start with max available size
-		{
-          Update.printError(Serial);
-        }
-      }
-	  else if(upload.status == UPLOAD_FILE_WRITE)
-	  {
-        if(Update.write(upload.buf, upload.currentSize) != upload.currentSize)
-		{
-          Update.printError(Serial);
-        }
-      }
-	  else if(upload.status == UPLOAD_FILE_END)
-	  {
-        if(Update.end(true))//true to set the size to the current progress
-		{ 
-          DEBUG_WM(F("Update done. Rebooting..."));
-        }
-		else 
-		{
-          Update.printError(Serial);
-        }
-      }
-	  yield();
+  if (path == WM_BUNDLE_FILE) {
+    _bundle.begin(); // reload, or drop it while it is being replaced or after a delete
+    _cache.clear();
+    return;
+  }
+  String logical = path;
+  if (logical.endsWith(".gz") || logical.endsWith(".br")) logical = logical.substring(0, logical.length() - 3);
+  _cache.invalidate(logical.c_str());
+  WM_ASSET_ENTRY *entry = findAsset(logical.c_str());
+  if (entry != NULL) entry->path[0] = 0;
+  if (_tagFile && strncmp(_tagPath, logical.c_str(), logical.length()) == 0) _tagFile.close();
 }
 
-void WiFiManager::handleGPIOStatus()
+//true when the request validators say the client copy of entry is current (RFC 7232, If-None-Match wins)
+boolean WiFiManager::assetNotModified(const WM_ASSET_ENTRY *entry, uint8_t variant)
 {
-	String json = "{\"GPIO0\":{\"Status\":\"" + gpio0.status + F("\",\"Alias\":\"") + gpio0.alias
-		+ F("\"},\"GPIO2\":{\"Status\":\"") + gpio2.status + F("\",\"Alias\":\"") + gpio2.alias
-		+ F("\"},\"GPIO5\":{\"Status\":\"") + gpio5.status + F("\",\"Alias\":\"") + gpio5.alias
-        + F("\"},\"GPIO12\":{\"Status\":\"") + gpio12.status + F("\",\"Alias\":\"") + gpio12.alias
-        + F("\"},\"GPIO14\":{\"Status\":\"") + gpio14.status + F("\",\"Alias\":\"") + gpio14.alias
-		+ F("\"},\"GPIO15\":{\"Status\":\"") + gpio15.status + F("\",\"Alias\":\"") + gpio15.alias
-		+ F("\"},\"GPIO16\":{\"Status\":\"") + gpio16.status + F("\",\"Alias\":\"") + gpio16.alias
-        + "\"}}";
-	server->send(200,"text/html", json);
-	DEBUG_WM("GPIO status sent");
+  PortalServer::RequestView req = server->request();
+  const char *inm = req.header("If-None-Match");
+  if (*inm) {
+    if (strcmp(inm, "*") == 0) return true;
+    if (entry->pending & (1 << variant)) return false;
+    char quoted[WM_ETAG_LEN + 3];
+    quoted[0] = '"';
+    hashToETag(entry->etag[variant], quoted + 1);
+    strcat(quoted, "\"");
+    return strstr(inm, quoted) != NULL;
+  }
+  const char *ims = req.header("If-Modified-Since");
+  if (entry->modified != 0 && *ims) {
+    time_t since = parseHttpDate(ims);
+    return since != 0 && since >= (time_t)entry->modified;
+  }
+  return false;
 }
 
-void WiFiManager::handleTime()
+void WiFiManager::sendAssetHeaders(const WM_ASSET_ENTRY *entry, uint8_t variant)
 {
-	ntpInnitialize();
-	String hr, min, sec;
-	if(hour() > 9) hr = hour(); else hr = '0' + hour();
-	if(minute() > 9) min = minute(); else min = '0' + minute();
-	if(second() > 9) sec = second(); else sec = '0' + second();
-	String json = "{\"Day\":\"" + String(day())
-				  + F("\",\"Month\":\"") + String(month())
-				  + F("\",\"Year\":\"") + String(year())
-				  + F("\",\"Hour\":\"") + String(hour())
-				  + F("\",\"Minute\":\"") + String(minute())
-				  + F("\",\"Second\":\"") + String(second())
-				  + "\"}";
-	server->send(200,"text/html",json);
-	DEBUG_WM(F("Time request done."));
+  char value[32];
+  if (!(entry->pending & (1 << variant))) {
+    value[0] = '"';
+    hashToETag(entry->etag[variant], value + 1);
+    strcat(value, "\"");
+    server->sendHeader("ETag", value);
+  }
+  if (assetEncoding[variant] != NULL) {
+    server->sendHeader("Content-Encoding", assetEncoding[variant]);
+  }
+  if (entry->variants != (1 << variant)) {
+    server->sendHeader("Vary", "Accept-Encoding"); // another client may get another variant
+  }
+  if (entry->modified != 0) {
+    formatHttpDate(entry->modified, value);
+    server->sendHeader("Last-Modified", value);
+  }
+  // cacheable, but always revalidated so an edited file shows up on the next load
+  server->sendHeader("Cache-Control", "no-cache");
 }
 
-void WiFiManager::handleRestart()
+//send the asset behind a logical path, or 404 when nothing backs it
+void WiFiManager::serveAsset(const String &path, bool download)
 {
-  DEBUG_WM(F("Module Restart"));
-  server->sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
-  server->sendHeader("Pragma", "no-cache");
-  server->sendHeader("Expires", "-1");
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "WiFi Information");
-  page += FPSTR(HTTP_SCRIPT);
-  page += FPSTR(HTTP_STYLE);
-  page += _customHeadElement;
-  page += FPSTR(HTTP_HEAD_END);
-  page += F("ESP module will be restarted in a few seconds.");
-  page += FPSTR(HTTP_END);
-  server->send(200, "text/html", page);
+  if (serveBundled(path, download)) return;
+  for (uint8_t attempt = 0; attempt < 2; attempt++) {
+    WM_ASSET_ENTRY *entry = resolveAsset(path);
+    if (entry == NULL || entry->variants == 0) break;
+    uint8_t variant = negotiateAsset(entry);
+
+    if (!download && assetNotModified(entry, variant)) {
+      sendAssetHeaders(entry, variant);
+      server->send(304);
+      return;
+    }
+    if (sendCachedAsset(path, entry, variant, download)) return;
+
+    char physical[WM_ASSET_PATH_LEN + 3];
+    assetPhysicalPath(entry, variant, physical, sizeof(physical));
+    File file = SPIFFS.open(physical, "r");
+    if (!file) {
+      entry->path[0] = 0; // file went away behind the cache, resolve it again
+      continue;
+    }
+    String contentType = getContentType(path);
+    sendAssetStart(path, entry, variant, download);
+    sendAssetBody(file, 0, file.size(), false, contentType.c_str(), entry, variant);
+    file.close();
+    return;
+  }
+  server->send(404, "text/plain", "FileNotFound");
+}
 
-  DEBUG_WM(F("Restart page sent."));
-  delay(5000);
-  ESP.restart();
-  delay(2000);
+//answer from the asset bundle when it holds path: a binary search of the RAM index and a seek
+//into the bundle handle, no SPIFFS lookup. false when the bundle does not have path
+boolean WiFiManager::serveBundled(const String &path, bool download)
+{
+  const WM_BUNDLE_ENTRY *first;
+  uint8_t n = _bundle.find(path.c_str(), &first);
+  if (n == 0) return false;
+  // a transient cache entry lets negotiation and the validators work as for loose files
+  WM_ASSET_ENTRY entry;
+  const WM_BUNDLE_ENTRY *stored[ASSET_VARIANTS] = {};
+  strcpy(entry.path, first->path);
+  entry.variants = 0;
+  entry.pending = 0;
+  entry.modified = first->modified;
+  for (uint8_t i = 0; i < n; i++) {
+    uint8_t v = first[i].encoding; // WM_BUNDLE_* follow the ASSET_* order
+    stored[v] = &first[i];
+    entry.variants |= (1 << v);
+    entry.etag[v] = first[i].etag;
+  }
+  uint8_t variant = negotiateAsset(&entry);
+  if (!download && assetNotModified(&entry, variant)) {
+    sendAssetHeaders(&entry, variant);
+    server->send(304);
+    return true;
+  }
+  if (sendCachedAsset(path, &entry, variant, download)) return true;
+  String contentType = getContentType(path);
+  sendAssetStart(path, &entry, variant, download);
+  sendAssetBody(_bundle.file(), stored[variant]->offset, stored[variant]->length, true, contentType.c_str(), &entry, variant);
+  return true;
 }
 
-void WiFiManager::handleIPConfigurationPage()
+//status line and body of an asset stored as size bytes of file from base, honouring Range
+void WiFiManager::sendAssetBody(File &file, size_t base, size_t size, boolean shared, const char *contentType, const WM_ASSET_ENTRY *entry, uint8_t variant)
 {
-  DEBUG_WM(F("IP Configuration"));
-  String path = F("/ip_configuration.html");
+  if (*server->request().header("Range") && assetRangeValid(entry, variant)) {
+    sendAssetRanges(file, base, size, shared, contentType);
+    return;
+  }
+  if (cacheAssetBody(file, base, size, contentType, entry, variant)) return;
+  server->setContentLength(size);
+  server->send(200, contentType, "");
+  if (!server->deferFile(file, base, size, shared)) {
+    WiFiClient client = server->client();
+    sendFileRange(client, file, base, size);
+  }
+}
+
+//headers every 200 answer of an asset carries, the body follows
+void WiFiManager::sendAssetStart(const String &path, const WM_ASSET_ENTRY *entry, uint8_t variant, bool download)
+{
+  if (download) {
+    server->sendHeader("Content-Disposition", "attachment;filename=" + path.substring(1));
+  }
+  sendAssetHeaders(entry, variant);
+  server->sendHeader("Accept-Ranges", "bytes");
+}
+
+//answer a whole-body request from the RAM cache, no SPIFFS access. false on a miss or for a Range request
+boolean WiFiManager::sendCachedAsset(const String &path, const WM_ASSET_ENTRY *entry, uint8_t variant, bool download)
+{
+  if (*server->request().header("Range") && assetRangeValid(entry, variant)) return false;
+  size_t len;
+  const uint8_t *body = _cache.get(entry->path, variant, len);
+  if (body == NULL) return false;
   String contentType = getContentType(path);
-  String pathWithGz = path + F(".gz");
-  if(SPIFFS.exists(pathWithGz) || SPIFFS.exists(path))
-  {
-    if(SPIFFS.exists(pathWithGz))
-    {
-      path += F(".gz");
+  sendAssetStart(path, entry, variant, download);
+  server->sendBody(200, contentType.c_str(), body, len);
+  return true;
+}
+
+//read a body small enough for the cache into it and send it from there, false (nothing sent) when it
+//does not fit the budget or the heap
+boolean WiFiManager::cacheAssetBody(File &file, size_t base, size_t size, const char *contentType, const WM_ASSET_ENTRY *entry, uint8_t variant)
+{
+  if (!_cache.fits(size)) return false;
+  uint8_t *body = (uint8_t*)malloc(size);
+  if (body == NULL) return false;
+  file.seek(base, SeekSet);
+  if (file.read(body, size) != size) {
+    free(body);
+    return false;
+  }
+  server->sendBody(200, contentType, body, size);
+  _cache.put(entry->path, variant, body, size);
+  return true;
+}
+
+//a Range request is only honoured when If-Range (if any) still names the stored variant
+boolean WiFiManager::assetRangeValid(const WM_ASSET_ENTRY *entry, uint8_t variant)
+{
+  const char *ifRange = server->request().header("If-Range");
+  if (!*ifRange) return true;
+  if (ifRange[0] == '"') {
+    if (entry->pending & (1 << variant)) return false;
+    char quoted[WM_ETAG_LEN + 3];
+    quoted[0] = '"';
+    hashToETag(entry->etag[variant], quoted + 1);
+    strcat(quoted, "\"");
+    return strcmp(ifRange, quoted) == 0;
+  }
+  time_t since = parseHttpDate(ifRange);
+  return entry->modified != 0 && since != 0 && (time_t)entry->modified <= since;
+}
+
+//parse "bytes=a-b,c-,-n" into inclusive ranges clipped to size, unsatisfiable parts are dropped.
+//returns the number of ranges kept, -1 when the header is not a byte range (send the whole file)
+int WiFiManager::parseRanges(const char *header, size_t size, WM_RANGE *ranges)
+{
+  if (strncmp(header, "bytes=", 6) != 0) return -1;
+  const char *p = header + 6;
+  int count = 0;
+  while (*p) {
+    while (*p == ' ' || *p == ',') p++;
+    if (!*p) break;
+    if (count == WM_MAX_RANGES) return -1; // too many pieces, the whole file is cheaper
+    char *end;
+    long first = -1, last = -1;
+    if (*p != '-') {
+      first = strtol(p, &end, 10);
+      p = end;
     }
-    File file = SPIFFS.open(path, "r");
-    size_t sent = server->streamFile(file, contentType);
-    file.close();
+    if (*p != '-') return -1;
+    p++;
+    if (*p >= '0' && *p <= '9') {
+      last = strtol(p, &end, 10);
+      p = end;
+    }
+    while (*p == ' ') p++;
+    if (*p && *p != ',') return -1;
+    if (first < 0) { // suffix range, the last n bytes
+      if (last <= 0) continue;
+      first = (size > (size_t)last) ? size - last : 0;
+      last = size - 1;
+    } else {
+      if (last >= 0 && last < first) return -1;
+      if (last < 0 || (size_t)last >= size) last = size - 1;
+    }
+    if ((size_t)first >= size) continue;
+    ranges[count].start = first;
+    ranges[count].end = last;
+    count++;
+  }
+  return count;
+}
+
+//answer a Range request with 206 (one part, or multipart/byteranges of at most WM_HTTP_SLICE bytes),
+//or 416 when nothing is satisfiable
+void WiFiManager::sendAssetRanges(File &file, size_t base, size_t size, boolean shared, const char *contentType)
+{
+  WM_RANGE ranges[WM_MAX_RANGES];
+  int count = parseRanges(server->request().header("Range"), size, ranges);
+  // a multipart part header: 62 fixed bytes, the content type and three 10 digit numbers
+  char line[160];
+  WiFiClient client = server->client();
+
+  // multipart: the length is known up front since every part header is formatted the same way.
+  // the parts are written here and not sliced by the pool, so a set spanning more than one
+  // slice (bytes=0-1,2- is all of the file) gets the whole file, which the pool does slice
+  static const char boundary[] = "WM_BYTERANGES";
+  size_t total = 0;
+  size_t span = 0;
+  for (int i = 0; count > 1 && i < count; i++) {
+    span += ranges[i].end - ranges[i].start + 1;
+    if (span > WM_HTTP_SLICE) count = -1;
+    int n = snprintf(line, sizeof(line), "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %u-%u/%u\r\n\r\n", boundary, contentType,
+                     (unsigned int)ranges[i].start, (unsigned int)ranges[i].end, (unsigned int)size);
+    if (n < 0 || (size_t)n >= sizeof(line)) count = -1; // never send a cut part header, the whole file instead
+    total += n + ranges[i].end - ranges[i].start + 1;
+  }
+
+  if (count < 0) {
+    server->setContentLength(size);
+    server->send(200, contentType, "");
+    if (!server->deferFile(file, base, size, shared)) {
+      sendFileRange(client, file, base, size);
+    }
+    return;
+  }
+  if (count == 0) {
+    snprintf(line, sizeof(line), "bytes */%u", (unsigned int)size);
+    server->sendHeader("Content-Range", line);
+    server->send(416, "text/plain", "");
+    return;
+  }
+  if (count == 1) {
+    snprintf(line, sizeof(line), "bytes %u-%u/%u", (unsigned int)ranges[0].start, (unsigned int)ranges[0].end, (unsigned int)size);
+    server->sendHeader("Content-Range", line);
+    server->setContentLength(ranges[0].end - ranges[0].start + 1);
+    server->send(206, contentType, "");
+    if (!server->deferFile(file, base + ranges[0].start, ranges[0].end - ranges[0].start + 1, shared)) {
+      sendFileRange(client, file, base + ranges[0].start, ranges[0].end - ranges[0].start + 1);
+    }
+    return;
+  }
+
+  total += snprintf(line, sizeof(line), "\r\n--%s--\r\n", boundary);
+  snprintf(line, sizeof(line), "multipart/byteranges; boundary=%s", boundary);
+  server->setContentLength(total);
+  server->send(206, line, "");
+  for (int i = 0; i < count; i++) {
+    int n = snprintf(line, sizeof(line), "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %u-%u/%u\r\n\r\n", boundary, contentType,
+                     (unsigned int)ranges[i].start, (unsigned int)ranges[i].end, (unsigned int)size);
+    client.write((const uint8_t*)line, n);
+    sendFileRange(client, file, base + ranges[i].start, ranges[i].end - ranges[i].start + 1);
   }
+  int n = snprintf(line, sizeof(line), "\r\n--%s--\r\n", boundary);
+  client.write((const uint8_t*)line, n);
+}
+
+void WiFiManager::sendFileRange(WiFiClient &client, File &file, size_t start, size_t len)
+{
+  uint8_t buf[256];
+  file.seek(start, SeekSet);
+  while (len > 0) {
+    size_t n = file.read(buf, (len > sizeof(buf)) ? sizeof(buf) : len);
+    if (n == 0) break;
+    if (client.write((const uint8_t*)buf, n) != n) break; // client went away
+    len -= n;
+    yield();
+  }
+}
+
+// ETags are a 64 bit FNV-1a hash of the stored bytes, kept in the SPIFFS manifest WM_ETAG_FILE
+// as "<physical path> <etag> <last modified, UTC seconds or 0>" lines.
+uint64_t WiFiManager::hashBytes(uint64_t hash, const uint8_t *buf, size_t len)
+{
+  while (len--) {
+    hash ^= *buf++;
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+//hash one slice of a file that has no ETag yet, picking the next such file from the resolution table.
+//a finished tag goes to the entry and to the manifest, so the file is never hashed again
+void WiFiManager::taskTag()
+{
+  if (!_tagFile) {
+    for (uint8_t i = 0; i < WM_ASSET_CACHE_SIZE; i++) {
+      WM_ASSET_ENTRY &entry = _assetCache[i];
+      if (entry.path[0] == 0 || entry.pending == 0) continue;
+      uint8_t v = 0;
+      while (!(entry.pending & (1 << v))) v++;
+      assetPhysicalPath(&entry, v, _tagPath, sizeof(_tagPath));
+      _tagFile = SPIFFS.open(_tagPath, "r");
+      if (!_tagFile) {
+        entry.path[0] = 0; // gone, resolve it again on the next request
+        return;
+      }
+      _tagHash = WM_HASH_SEED;
+      return;
+    }
+    return;
+  }
+  uint8_t buf[WM_ETAG_SLICE];
+  size_t n = _tagFile.read(buf, sizeof(buf));
+  if (n > 0) {
+    _tagHash = hashBytes(_tagHash, buf, n);
+    return;
+  }
+  _tagFile.close();
+  String logical = _tagPath;
+  uint8_t v = ASSET_PLAIN;
+  if (logical.endsWith(".gz")) v = ASSET_GZIP;
+  else if (logical.endsWith(".br")) v = ASSET_BROTLI;
+  if (v != ASSET_PLAIN) logical = logical.substring(0, logical.length() - 3);
+  WM_ASSET_ENTRY *entry = findAsset(logical.c_str());
+  if (entry == NULL || !(entry->pending & (1 << v))) return; // changed meanwhile, the upload tagged it
+  entry->etag[v] = _tagHash;
+  entry->pending &= ~(1 << v);
+  writeAssetTag(_tagPath, &_tagHash, 0);
+  DEBUG_WM(F("ETag computed for"));
+  DEBUG_WM(_tagPath);
+}
+
+void WiFiManager::hashToETag(uint64_t hash, char *etag)
+{
+  snprintf(etag, WM_ETAG_LEN + 1, "%08lx%08lx", (unsigned long)(hash >> 32), (unsigned long)hash);
+}
+
+//read one manifest line into line (without the newline), false at the end of the file
+static bool readManifestLine(File &f, char *line, size_t size)
+{
+  size_t len = 0;
+  int c;
+  while ((c = f.read()) >= 0 && c != '\n') {
+    if (len + 1 < size) line[len++] = (char)c;
+  }
+  line[len] = 0;
+  return c >= 0 || len > 0;
+}
+
+//tags of every stored variant of entry in one pass over the manifest, the newest modification time of
+//them becomes the one of the asset. returns the variants that have a tag
+uint8_t WiFiManager::readAssetTags(WM_ASSET_ENTRY *entry)
+{
+  File f = SPIFFS.open(WM_ETAG_FILE, "r");
+  if (!f) return 0;
+  char line[WM_ASSET_PATH_LEN + WM_ETAG_LEN + 16];
+  size_t plen = strlen(entry->path);
+  uint8_t found = 0;
+  while (found != entry->variants && readManifestLine(f, line, sizeof(line))) {
+    if (strncmp(line, entry->path, plen) != 0) continue;
+    for (uint8_t v = 0; v < ASSET_VARIANTS; v++) {
+      size_t slen = strlen(assetSuffix[v]);
+      if (!(entry->variants & (1 << v)) || strncmp(line + plen, assetSuffix[v], slen) != 0 || line[plen + slen] != ' ') continue;
+      unsigned long mtime = 0;
+      char tag[WM_ETAG_LEN + 1];
+      if (sscanf(line + plen + slen + 1, "%16s %lu", tag, &mtime) >= 1 && strlen(tag) == WM_ETAG_LEN) {
+        entry->etag[v] = strtoull(tag, NULL, 16);
+        if (mtime > entry->modified) entry->modified = mtime;
+        found |= (1 << v);
+      }
+      break;
+    }
+  }
+  f.close();
+  return found;
+}
+
+//rewrite the manifest without the line of physical, adding a new one when etag is given
+void WiFiManager::writeAssetTag(const char *physical, const uint64_t *etag, uint32_t modified)
+{
+  File in = SPIFFS.open(WM_ETAG_FILE, "r");
+  File out = SPIFFS.open(WM_ETAG_TEMP_FILE, "w");
+  if (!out) {
+    DEBUG_WM(F("ETag manifest write failed"));
+    return;
+  }
+  char line[WM_ASSET_PATH_LEN + WM_ETAG_LEN + 16];
+  size_t plen = strlen(physical);
+  if (in) {
+    while (readManifestLine(in, line, sizeof(line))) {
+      if (line[0] == 0 || (strncmp(line, physical, plen) == 0 && line[plen] == ' ')) continue;
+      out.print(line);
+      out.print('\n');
+    }
+    in.close();
+  }
+  if (etag != NULL) {
+    char tag[WM_ETAG_LEN + 1];
+    hashToETag(*etag, tag);
+    snprintf(line, sizeof(line), "%s %s %lu\n", physical, tag, (unsigned long)modified);
+    out.print(line);
+  }
+  out.close();
+  SPIFFS.remove(WM_ETAG_FILE);
+  SPIFFS.rename(WM_ETAG_TEMP_FILE, WM_ETAG_FILE);
+}
+
+//current time as UTC seconds, 0 while the clock has not been set by NTP
+uint32_t WiFiManager::utcNow()
+{
+  if (timeStatus() == timeNotSet) return 0;
+  return now() - timeZone * SECS_PER_HOUR;
+}
+
+static const char HTTP_DAYS[] PROGMEM   = "SunMonTueWedThuFriSat";
+static const char HTTP_MONTHS[] PROGMEM = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+//IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT", buf holds 30 bytes
+void WiFiManager::formatHttpDate(uint32_t t, char *buf)
+{
+  tmElements_t tm;
+  breakTime(t, tm);
+  char day[4], mon[4];
+  memcpy_P(day, HTTP_DAYS + (tm.Wday - 1) * 3, 3);
+  memcpy_P(mon, HTTP_MONTHS + (tm.Month - 1) * 3, 3);
+  day[3] = mon[3] = 0;
+  snprintf(buf, 30, "%s, %02d %s %04d %02d:%02d:%02d GMT", day, tm.Day, mon, tmYearToCalendar(tm.Year), tm.Hour, tm.Minute, tm.Second);
+}
+
+time_t WiFiManager::parseHttpDate(const char *text)
+{
+  int dd, yy, hh, mi, ss;
+  char mon[4];
+  if (sscanf(text, "%*[^,], %d %3s %d %d:%d:%d", &dd, mon, &yy, &hh, &mi, &ss) != 6) return 0;
+  for (uint8_t m = 0; m < 12; m++) {
+    if (strncmp_P(mon, HTTP_MONTHS + m * 3, 3) != 0) continue;
+    tmElements_t tm;
+    tm.Year = CalendarYrToTm(yy);
+    tm.Month = m + 1;
+    tm.Day = dd;
+    tm.Hour = hh;
+    tm.Minute = mi;
+    tm.Second = ss;
+    return makeTime(tm);
+  }
+  return 0;
+}
+
+void WiFiManager::handleGPIOControl(){
+  DEBUG_WM(F("GPIO Control"));
+  serveAsset(F("/gpio.html"));
+  DEBUG_WM(F("GPIO page sent"));
+}
+
+void WiFiManager::handleGPIOToggle(){
+	DEBUG_WM("GPIO Toggle");
+	PortalServer::RequestView req = server->request();
+	long pin = req.argInt("pin", -1);
+	boolean on = req.argIs("status", "On");
+	// only the pins the portal exposes, never the indicator or the factory reset button
+	if(!gpioByPin(pin))
+	{
+		server->send(400,"text/plain","Unknown pin");
+		return;
+	}
+	setGPIO(pin, on, req.arg("alias"));
+	DEBUG_WM(on ? F("GPIO turn HIGH") : F("GPIO turn LOW"));
+	DEBUG_WM(pin);
+	server->send(200,"text/html","");
+}
+
+// pins the portal exposes, gpio4 and gpio13 are kept for the indicator and factory reset
+static const uint8_t gpioPins[] = { 0, 2, 5, 12, 14, 15, 16 };
+
+//the record kept for pin, NULL for pins the portal does not expose
+WiFiManager::GPIOP* WiFiManager::gpioByPin(long pin)
+{
+	switch(pin)
+	{
+		case 0:  return &gpio0;
+		case 2:  return &gpio2;
+		case 5:  return &gpio5;
+		case 12: return &gpio12;
+		case 14: return &gpio14;
+		case 15: return &gpio15;
+		case 16: return &gpio16;
+	}
+	return NULL;
+}
+
+void WiFiManager::setGPIO(uint8_t pin, boolean on, const char *alias)
+{
+	GPIOP *gpio = gpioByPin(pin);
+	if(!gpio) return;
+	digitalWrite(pin, on ? HIGH : LOW);
+	gpio->status = on ? "On" : "Off";
+	if(alias && gpio->alias != alias)
+	{
+		gpio->alias = alias;
+		char key[12] = "alias.";
+		JsonWriter::formatUInt(pin, key + 6);
+		_settings.put(key, alias);
+	}
+	if(server)
+	{
+		char data[WM_GPIO_EVENT_LEN];
+		formatGPIOEvent(pin, *gpio, data, sizeof(data));
+		server->sendEvent("gpio", data);
+		uint8_t frame[WM_GPIO_EVENT_LEN];
+		server->socketBroadcast(frame, formatGPIOFrame(pin, *gpio, frame, sizeof(frame)), pin);
+	}
+}
+
+// GPIO aliases are kept as "alias.<pin>", custom parameters under their id
+void WiFiManager::loadSettings()
+{
+	if(!_settings.begin())
+	{
+		DEBUG_WM(F("Settings store unavailable"));
+		return;
+	}
+	char value[WM_SOCKET_PAYLOAD];
+	for(uint8_t i = 0; i < sizeof(gpioPins); i++)
+	{
+		char key[12] = "alias.";
+		JsonWriter::formatUInt(gpioPins[i], key + 6);
+		if(_settings.get(key, value, sizeof(value)) >= 0) gpioByPin(gpioPins[i])->alias = value;
+	}
+	for(int i = 0; i < _paramsCount; i++)
+	{
+		if(_params[i] == NULL) break;
+		if(_params[i]->getID() == NULL) continue;
+		_settings.get(_params[i]->getID(), _params[i]->_value, _params[i]->_length + 1);
+	}
+	DEBUG_WM(F("Settings loaded, keys:"));
+	DEBUG_WM(_settings.count());
+}
+
+//one pin as the JSON payload of a "gpio" event: {"pin":5,"status":"On","alias":"..."}
+void WiFiManager::formatGPIOEvent(uint8_t pin, const GPIOP &gpio, char *buf, size_t size)
+{
+	int n = snprintf(buf, size, "{\"pin\":%u,\"status\":\"%s\",\"alias\":\"", pin, gpio.status.c_str());
+	size_t len = (n > 0 && (size_t)n < size) ? n : 0;
+	// escape the alias and cut it where the closing "} would no longer fit
+	for (const char *c = gpio.alias.c_str(); *c && len + 4 < size; c++) {
+		if (*c == '"' || *c == '\\') {
+			if (len + 5 >= size) break;
+			buf[len++] = '\\';
+		}
+		buf[len++] = ((uint8_t)*c < 0x20) ? ' ' : *c;
+	}
+	buf[len++] = '"';
+	buf[len++] = '}';
+	buf[len] = '\0';
+}
+
+//one pin as a binary socket message: WM_GPIO_OP_STATE, pin, state, alias bytes
+size_t WiFiManager::formatGPIOFrame(uint8_t pin, const GPIOP &gpio, uint8_t *buf, size_t size)
+{
+	buf[0] = WM_GPIO_OP_STATE;
+	buf[1] = pin;
+	buf[2] = (gpio.status == "On") ? 1 : 0;
+	size_t len = gpio.alias.length();
+	if (len > size - 3) len = size - 3;
+	memcpy(buf + 3, gpio.alias.c_str(), len);
+	return len + 3;
+}
+
+//latest state of pin to the socket being served, also what a drained socket is refreshed with
+void WiFiManager::sendGPIOFrame(uint8_t pin)
+{
+	GPIOP *gpio = gpioByPin(pin);
+	if(!gpio) return;
+	uint8_t frame[WM_GPIO_EVENT_LEN];
+	server->socketReply(frame, formatGPIOFrame(pin, *gpio, frame, sizeof(frame)), pin);
+}
+
+/** WebSocket for GPIO switching, binary WM_GPIO_OP_* messages, starts with the state of every pin */
+void WiFiManager::handleSocket()
+{
+	if(!server->beginSocket())
+	{
+		server->send(400, "text/plain", "WebSocket upgrade refused");
+		return;
+	}
+	static const uint8_t status[] = { WM_GPIO_OP_STATUS };
+	handleSocketMessage(status, sizeof(status));
+	DEBUG_WM(F("GPIO socket opened"));
+}
+
+void WiFiManager::handleSocketMessage(const uint8_t *payload, size_t len)
+{
+	if(len == 0) return;
+	switch(payload[0])
+	{
+		case WM_GPIO_OP_TOGGLE:
+		{
+			if(len < 3 || !gpioByPin(payload[1])) return;
+			char alias[WM_SOCKET_PAYLOAD];
+			size_t aliasLen = len - 3;
+			memcpy(alias, payload + 3, aliasLen);
+			alias[aliasLen] = '\0';
+			// the change comes back to this socket too, that is the acknowledgement
+			setGPIO(payload[1], payload[2] != 0, alias);
+			break;
+		}
+		case WM_GPIO_OP_SWITCH:
+			if(len < 3 || !gpioByPin(payload[1])) return;
+			setGPIO(payload[1], payload[2] != 0, NULL);
+			break;
+		case WM_GPIO_OP_STATUS:
+			for(uint8_t i = 0; i < sizeof(gpioPins); i++) sendGPIOFrame(gpioPins[i]);
+			break;
+	}
+}
+
+/** Server-Sent Events stream of GPIO changes, starts with the state of every pin */
+void WiFiManager::handleEvents()
+{
+	if(!server->beginEvents())
+	{
+		server->send(503, "text/plain", "Too many event subscribers");
+		return;
+	}
+	// the snapshot goes through the same room check as every later event, a subscriber that
+	// cannot take all of it is dropped and reconnects for a fresh one instead of missing pins
+	char data[WM_GPIO_EVENT_LEN];
+	for(uint8_t i = 0; i < sizeof(gpioPins); i++)
+	{
+		formatGPIOEvent(gpioPins[i], *gpioByPin(gpioPins[i]), data, sizeof(data));
+		if(!server->eventReply("gpio", data)) return;
+	}
+	DEBUG_WM(F("Event subscriber added"));
+}
+
+void WiFiManager::handleFirmwareUpdatePage()
+{
+  DEBUG_WM(F("Firmare Update"));
+  serveAsset(F("/firmware_update.html"));
+  DEBUG_WM(F("Firmare update page sent"));
+}
+
+void WiFiManager::handleUpdateHeader()
+{
+	server->sendHeader("Connection", "close");
+    server->sendHeader("Access-Control-Allow-Origin", "*");
+    server->send(200, "text/plain", (Update.hasError() || _otaFailed)?"Fail To Update Firmware.":"Firmware Updated Successfully.");
+    scheduleReboot(REBOOT_RESTART);
+}
+
+//the firmware arrives either as the plain image or gzip compressed (tools/wmota), the first bytes tell.
+//a compressed image is inflated on the fly and reaches Update in whole flash sectors
+void WiFiManager::handleUpdate()
+{
+	DEBUG_WM(F("Handle Firmare Update"));
+	HTTPUpload& upload = server->upload();
+      if(upload.status == UPLOAD_FILE_START)
+	  {
+		DEBUG_WM(F("Upload file start"));
+		_otaInflater.reset();
+		_otaReceived = 0;
+		_otaFailed = false;
+        uint32_t maxSketchSpace = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+        if(!Update.begin(maxSketchSpace))//start with max available size
+		{
+          Update.printError(Serial);
+        }
+      }
+	  else if(upload.status == UPLOAD_FILE_WRITE)
+	  {
+		if(_otaFailed) return; // drain the rest of the upload
+		if(_otaReceived == 0 && GzipInflater::isGzip(upload.buf, upload.currentSize))
+		{
+			DEBUG_WM(F("Compressed image, inflating"));
+			_otaInflater.reset(new GzipInflater());
+			if(!_otaInflater->begin([](const uint8_t *data, size_t len) { return Update.write(const_cast<uint8_t*>(data), len) == len; }))
+			{
+				failUpdate(GzipInflater::resultText(_otaInflater->result()));
+				return;
+			}
+		}
+		_otaReceived += upload.currentSize;
+		if(_otaInflater)
+		{
+			if(!_otaInflater->write(upload.buf, upload.currentSize))
+			{
+				failUpdate(GzipInflater::resultText(_otaInflater->result()));
+			}
+		}
+        else if(Update.write(upload.buf, upload.currentSize) != upload.currentSize)
+		{
+          Update.printError(Serial);
+        }
+      }
+	  else if(upload.status == UPLOAD_FILE_END)
+	  {
+		if(_otaInflater && !_otaFailed)
+		{
+			if(!_otaInflater->finish())
+			{
+				failUpdate(GzipInflater::resultText(_otaInflater->result()));
+			}
+			else
+			{
+				DEBUG_WM(F("Image inflated, bytes in/out:"));
+				DEBUG_WM(_otaReceived);
+				DEBUG_WM(_otaInflater->outputBytes());
+			}
+			_otaInflater.reset();
+		}
+		if(_otaFailed)
+		{
+			return;
+		}
+        if(Update.end(true))//true to set the size to the current progress
+		{ 
+          DEBUG_WM(F("Update done. Rebooting..."));
+        }
+		else 
+		{
+          Update.printError(Serial);
+        }
+      }
+	  else if(upload.status == UPLOAD_FILE_ABORTED)
+	  {
+		DEBUG_WM(F("Firmware upload aborted"));
+		_otaInflater.reset();
+		Update.end(); // not finished, nothing is committed
+	  }
+	  yield();
+}
+
+//stop a firmware upload: nothing more reaches the flash and the new image is never activated
+void WiFiManager::failUpdate(const char *reason)
+{
+	DEBUG_WM(F("Firmware update failed:"));
+	DEBUG_WM(reason);
+	_otaFailed = true;
+	_otaInflater.reset(); // the window goes back to the heap now
+	Update.end();
+}
+
+void WiFiManager::handleGPIOStatus()
+{
+	ChunkedPrint page(server->client());
+	page.begin(200, "application/json");
+	JsonWriter json(page);
+	json.beginObject();
+	for(uint8_t i = 0; i < sizeof(gpioPins); i++)
+	{
+		GPIOP *gpio = gpioByPin(gpioPins[i]);
+		char key[8] = "GPIO";
+		JsonWriter::formatUInt(gpioPins[i], key + 4);
+		json.key(key);
+		json.beginObject();
+		json.member("Status", gpio->status.c_str());
+		json.member("Alias", gpio->alias.c_str());
+		json.endObject();
+	}
+	json.endObject();
+	page.end();
+	DEBUG_WM("GPIO status sent");
+}
+
+void WiFiManager::handleTime()
+{
+	// served from the local clock, the ntp task keeps it disciplined in the background
+	time_t t = now();
+	const struct { const char *name; int value; } fields[] = {
+		{ "Day", day(t) }, { "Month", month(t) }, { "Year", year(t) },
+		{ "Hour", hour(t) }, { "Minute", minute(t) }, { "Second", second(t) }
+	};
+	ChunkedPrint page(server->client());
+	page.begin(200, "application/json");
+	JsonWriter json(page);
+	json.beginObject();
+	for(uint8_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+	{
+		char text[12];
+		JsonWriter::formatInt(fields[i].value, text);
+		json.member(fields[i].name, (const char*)text); // the page expects strings here
+	}
+	json.member("Synced", timeStatus() != timeNotSet);
+	json.endObject();
+	page.end();
+	DEBUG_WM(F("Time request done."));
+}
+
+void WiFiManager::handleRestart()
+{
+  DEBUG_WM(F("Module Restart"));
+  ChunkedPrint page(server->client());
+  page.begin(200, "text/html");
+  pageHead(page, "WiFi Information", false);
+  page.print(F("ESP module will be restarted in a few seconds."));
+  page.print(FPSTR(HTTP_END));
+  page.end();
+
+  DEBUG_WM(F("Restart page sent."));
+  scheduleReboot(REBOOT_RESTART);
+}
+
+void WiFiManager::handleIPConfigurationPage()
+{
+  DEBUG_WM(F("IP Configuration"));
+  serveAsset(F("/ip_configuration.html"));
   DEBUG_WM(F("IP configuration page sent"));
 }
 
 void WiFiManager::handleIPStatus()
 {
-	String json = "";
-	// Static IP
-	if(is_Static_IP)
+	ChunkedPrint page(server->client());
+	page.begin(200, "application/json");
+	JsonWriter json(page);
+	json.beginObject();
+	json.key("IP_Info");
+	json.beginObject();
+	if(is_Static_IP) // Static IP
 	{
-		json = "{\"IP_Info\":{\"IP\":\"" + ip_info.static_ip
-		+ F("\",\"Netmask\":\"") + ip_info.netmask
-		+ F("\",\"Gateway\":\"") + ip_info.gateway
-		+ F("\",\"IP_Type\":\"")
-        + "STATIC\"}}";
+		json.member("IP", ip_info.static_ip);
+		json.member("Netmask", ip_info.netmask);
+		json.member("Gateway", ip_info.gateway);
+		json.member("IP_Type", "STATIC");
 	}
 	else //DHCP
 	{
-		json = "{\"IP_Info\":{\"IP\":\"" + toStringIP(WiFi.localIP())
-		+ F("\",\"Netmask\":\"") + toStringIP(WiFi.subnetMask())
-		+ F("\",\"Gateway\":\"") + toStringIP(WiFi.gatewayIP())
-		+ F("\",\"IP_Type\":\"")
-        + "DHCP\"}}";
+		json.member("IP", WiFi.localIP());
+		json.member("Netmask", WiFi.subnetMask());
+		json.member("Gateway", WiFi.gatewayIP());
+		json.member("IP_Type", "DHCP");
 	}
-	
-	server->send(200,"text/html", json);
+	json.endObject();
+	json.endObject();
+	page.end();
 	DEBUG_WM("IP status sent");
 }
 
 void WiFiManager::handleIPChange()
 {
-	if(server->arg("type") == "dhcp")
+	PortalServer::RequestView req = server->request();
+	if(req.argIs("type", "dhcp"))
 	{
 		DEBUG_WM("dhcp mode");
 		SPIFFS_IP_Configure("");
 	}
 	
-	if(server->arg("type") == "static")
+	if(req.argIs("type", "static"))
 	{
 		DEBUG_WM("Static ip mode");
 		DEBUG_WM("IP submit from client:");
-		DEBUG_WM(server->arg("ip"));
-		SPIFFS_IP_Configure(server->arg("ip"));
+		DEBUG_WM(req.arg("ip"));
+		SPIFFS_IP_Configure(req.arg("ip"));
 	}
 }
 
@@ -1180,49 +2104,18 @@ void WiFiManager::handleEditorPage()
     DEBUG_WM(F("serving editor page"));
     path = "/ace.html";
   }
-  
-  if(path.endsWith("ace.js"))
-  {
-    DEBUG_WM(F("serving ace.js"));
-  }
-
-  if(path.endsWith("mode-html.js"))
-  {
-    DEBUG_WM(F("serving mode-html.js"));
-  }
-
-  if(path.endsWith("theme-eclipse.js"))
-  {
-    DEBUG_WM(F("serving theme-eclipse.js"));
-  }
-
-  if(path.endsWith("worker-html.js"))
-  {
-    DEBUG_WM(F("serving worker-html.js"));
-  }
-  
-  String contentType = getContentType(path);
-  String pathWithGz = path + ".gz";
-  if(SPIFFS.exists(pathWithGz) || SPIFFS.exists(path))
-  {
-    if(SPIFFS.exists(pathWithGz))
-    {
-      path += ".gz";
-    }
-    File file = SPIFFS.open(path, "r");
-    size_t sent = server->streamFile(file, contentType);
-    file.close();
-  }
+  serveAsset(path);
   DEBUG_WM(F("SPIFFS editor page sent"));
 }
 
 void WiFiManager::handleFileCreate()
 {
-  if(server->args() == 0)
+  PortalServer::RequestView req = server->request();
+  if(req.args() == 0)
   {
     return server->send(500, "text/plain", "BAD ARGS");
   }
-  String path = server->arg(0);
+  String path = req.arg(0);
   DEBUG_WM(F("Handle file create: "));
   DEBUG_WM(path);
   if(path == "/")
@@ -1235,90 +2128,64 @@ void WiFiManager::handleFileCreate()
     return server->send(500, "text/plain", "FILE EXISTS");
   }
   File file = SPIFFS.open(path, "w");
-  if(file)
-  {
-    file.close();
-  }
-  else
+  if(!file)
   {
     return server->send(500, "text/plain", "FILE CREATE FAILED");
   }
+  file.close();
+  invalidateAsset(path);
+  writeAssetTag(path.c_str(), NULL, 0);
   server->send(200, "text/plain", "");
   path = String();
 }
 
 void WiFiManager::handleFileList()
 {
-  if(!server->hasArg("dir")) 
+  PortalServer::RequestView req = server->request();
+  if(!req.hasArg("dir")) 
   {
     server->send(500, "text/plain", "BAD ARGS"); 
     return;
   }
-  String path = server->arg("dir");
+  String path = req.arg("dir");
   DEBUG_WM(F("Handle file list: "));
   DEBUG_WM(path);
   Dir dir = SPIFFS.openDir(path);
   path = String();
-  String output = "[";
+  ChunkedPrint page(server->client());
+  page.begin(200, "application/json");
+  JsonWriter json(page);
+  json.beginArray();
   while(dir.next())
   {
-    File entry = dir.openFile("r");
-    if (output != "[") output += ',';
-    bool isDir = false;
-    output += "{\"type\":\"";
-    output += (isDir)?"dir":"file";
-    output += "\",\"name\":\"";
-    output += String(entry.name()).substring(1);
-    output += "\"}";
-    entry.close();
+    // SPIFFS has no directories, every entry is a file
+    json.beginObject();
+    json.member("type", "file");
+    json.member("name", dir.fileName().c_str() + 1);
+    json.endObject();
   }
-  output += "]";
-  server->send(200, "text/json", output);
+  json.endArray();
+  page.end();
 }
 
 void WiFiManager::handleFileRead()
 {
-  String param = server->arg("filename");
-  param = "/" + param; // file send from client in the form "/filename.extension" then saved in spiffs system, without "/" before filename, it wont work
+  String param = "/";
+  param += server->request().arg("filename"); // file send from client in the form "/filename.extension" then saved in spiffs system, without "/" before filename, it wont work
   DEBUG_WM(F("Handle file: "));
   DEBUG_WM(param);
-  String contentType = getContentType(param);
-  String paramWithGz = param + ".gz";
-  if(SPIFFS.exists(paramWithGz) || SPIFFS.exists(param))
-  {
-    if(SPIFFS.exists(paramWithGz))
-    {
-      param += ".gz";
-    }
-    File file = SPIFFS.open(param, "r");
-    size_t sent = server->streamFile(file, contentType);
-    file.close();
-  }
+  serveAsset(param);
 }
 
 void WiFiManager::handleFileDownload()
 {
-  String file_ = server->arg("file");
-  file_= "/" + file_;
+  String file_ = "/";
+  file_ += server->request().arg("file");
   DEBUG_WM(F("Handle file download: "));
   DEBUG_WM(file_);
-  String contentType = getContentType(file_);
-  DEBUG_WM(F("File type: "));
-  DEBUG_WM(contentType);
-  String fileWithGz = file_ + ".gz";
-  if(SPIFFS.exists(fileWithGz) || SPIFFS.exists(file_))
-  {
-    if(SPIFFS.exists(fileWithGz))
-    {
-      file_ += ".gz";
-    }
-    File file = SPIFFS.open(file_, "r");
-    // tell browser what file type it received and what file name it should display
-    // without this, browser will not know how to open the file
-    server->sendHeader("Content-Disposition","attachment;filename=" + file_.substring(1));
-    size_t sent = server->streamFile(file, contentType);
-    file.close();
-  }
+  // tell browser what file type it received and what file name it should display
+  // without this, browser will not know how to open the file
+  serveAsset(file_, true);
 }
 
 void WiFiManager::handleUploadHeader()
@@ -1332,7 +2199,6 @@ void WiFiManager::handleFileUpload()
   {
     return;
   }
-  DEBUG_WM(F("Handle file upload..."));
   HTTPUpload& upload = server->upload();
   if(upload.status == UPLOAD_FILE_START)
   {
@@ -1343,36 +2209,74 @@ void WiFiManager::handleFileUpload()
     }
     DEBUG_WM(F("Upload file: "));
 	DEBUG_WM(filename);
-    fsUploadFile = SPIFFS.open(filename, "w");
-    filename = String();
+    if(!_upload.begin(filename))
+    {
+      DEBUG_WM(F("Upload file creation failed"));
+    }
+    invalidateAsset(filename);
+    _uploadHash = WM_HASH_SEED;
   } 
   else if(upload.status == UPLOAD_FILE_WRITE)
   {
-    DEBUG_WM(F("Uploading size: "));
-	DEBUG_WM(upload.currentSize);
-    if(fsUploadFile)
+    // chunks are coalesced into whole SPIFFS page payloads, progress is only logged every WM_UPLOAD_LOG_STEP bytes
+    if(_upload.active())
     {
-      fsUploadFile.write(upload.buf, upload.currentSize);
+      uint32_t before = _upload.bytes();
+      if(!_upload.write(upload.buf, upload.currentSize))
+      {
+        DEBUG_WM(F("Upload write failed"));
+      }
+      _uploadHash = hashBytes(_uploadHash, upload.buf, upload.currentSize);
+      if(before / WM_UPLOAD_LOG_STEP != _upload.bytes() / WM_UPLOAD_LOG_STEP)
+      {
+        DEBUG_WM(F("Uploaded bytes: "));
+        DEBUG_WM(_upload.bytes());
+      }
     }
   } 
   else if(upload.status == UPLOAD_FILE_END)
   {
-    if(fsUploadFile)
+    if(_upload.active())
+    {
+      String filename = _upload.path();
+      if(_upload.end())
+      {
+        // record the ETag of the new content so it is never hashed again
+        writeAssetTag(filename.c_str(), &_uploadHash, utcNow());
+      }
+      else
+      {
+        DEBUG_WM(F("Upload failed, file removed"));
+        writeAssetTag(filename.c_str(), NULL, 0);
+      }
+      invalidateAsset(filename);
+      DEBUG_WM(F("Upload done, bytes / flash writes / ms:"));
+      DEBUG_WM(_upload.bytes());
+      DEBUG_WM(_upload.writes());
+      DEBUG_WM(_upload.elapsed());
+    }
+  }
+  else if(upload.status == UPLOAD_FILE_ABORTED)
+  {
+    // drop the partial file rather than leave a truncated asset behind
+    if(_upload.active())
     {
-      fsUploadFile.close();
+      String filename = _upload.path();
+      _upload.abort();
+      invalidateAsset(filename);
+      DEBUG_WM(F("Upload aborted"));
     }
-    DEBUG_WM(F("Total upload size: "));
-	DEBUG_WM(upload.totalSize);
   }
 }
 
 void WiFiManager::handleFileDelete()
 {
-  if(server->args() == 0) 
+  PortalServer::RequestView req = server->request();
+  if(req.args() == 0) 
   {
     return server->send(500, "text/plain", "BAD ARGS");
   }
-  String path = server->arg(0);
+  String path = req.arg(0);
   DEBUG_WM(F("Handle delete file: "));
   DEBUG_WM(path);
   if(path == "/")
@@ -1384,6 +2288,8 @@ void WiFiManager::handleFileDelete()
     return server->send(404, "text/plain", "FileNotFound");
   }
   SPIFFS.remove(path);
+  invalidateAsset(path);
+  writeAssetTag(path.c_str(), NULL, 0);
   server->send(200, "text/plain", "");
   path = String();
 }
@@ -1399,11 +2305,16 @@ void WiFiManager::handleNotFound() {
   message += "\nMethod: ";
   message += ( server->method() == HTTP_GET ) ? "GET" : "POST";
   message += "\nArguments: ";
-  message += server->args();
+  PortalServer::RequestView req = server->request();
+  message += req.args();
   message += "\n";
 
-  for ( uint8_t i = 0; i < server->args(); i++ ) {
-    message += " " + server->argName ( i ) + ": " + server->arg ( i ) + "\n";
+  for ( uint8_t i = 0; i < req.args(); i++ ) {
+    message += " ";
+    message += req.argName ( i );
+    message += ": ";
+    message += req.arg ( i );
+    message += "\n";
   }
   server->sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
   server->sendHeader("Pragma", "no-cache");
@@ -1414,12 +2325,10 @@ void WiFiManager::handleNotFound() {
 /** Redirect to captive portal if we got a request for another domain. Return true in
 that case so the page handler do not try to handle the request again. */
 boolean WiFiManager::captivePortal() {
-  if (!isIp(server->hostHeader()) && server->hostHeader() != (String(myHostname))) {
+  String host = server->hostHeader();
+  if (!isIp(host.c_str()) && strcmp(host.c_str(), myHostname) != 0) {
     DEBUG_WM(F("Request redirected to captive portal"));
-    server->sendHeader("Location", ("http://") +String(myHostname), true);
-    server->setContentLength(0);
-    server->send ( 302, "text/plain", ""); // Empty content inhibits Content-length header so we have to close the socket ourselves.
-//    server->client().stop(); // Stop is needed because we sent no content length
+    server->client().write_P(HTTP_CAPTIVE_REDIRECT, strlen_P(HTTP_CAPTIVE_REDIRECT));
     return true;
   }
   return false;
@@ -1503,6 +2412,71 @@ int WiFiManager::scanWifiNetworks(int **indicesptr) {
 
 
 
+//Fold the results of a completed async scan into the scan cache.
+//Known APs are refreshed in place, new ones are added, entries that were not seen for
+//WM_SCAN_MAX_AGE scan periods are dropped, then the cache is re-sorted by signal strength.
+//APs are keyed by SSID when duplicates are removed, otherwise by BSSID.
+void WiFiManager::mergeScanResults(int n)
+{
+  unsigned long now = millis();
+  DEBUG_WM(F("Scan done"));
+  for (int i = 0; i < n; i++) {
+    String ssid = WiFi.SSID(i);
+    if (ssid == "") continue; // hidden network
+    uint8_t *bssid = WiFi.BSSID(i);
+    int32_t rssi = WiFi.RSSI(i);
+    int slot = -1;
+    for (int j = 0; j < _scanCount; j++) {
+      if (_removeDuplicateAPs ? (strcmp(_scanCache[j].ssid, ssid.c_str()) == 0)
+                              : (memcmp(_scanCache[j].bssid, bssid, 6) == 0)) {
+        slot = j;
+        break;
+      }
+    }
+    if (slot >= 0 && _scanCache[slot].seen == now && _scanCache[slot].rssi >= rssi) {
+      DEBUG_WM("DUP AP: " + ssid);
+      continue; // weaker duplicate from this same scan
+    }
+    if (slot < 0) {
+      if (_scanCount < WM_MAX_SCAN_RESULTS) {
+        slot = _scanCount++;
+      } else {
+        // full, evict the weakest entry if the new AP is stronger (cache is sorted, weakest is last)
+        slot = _scanCount - 1;
+        if (_scanCache[slot].rssi >= rssi) continue;
+      }
+    }
+    WM_SCAN_ENTRY &ap = _scanCache[slot];
+    strncpy(ap.ssid, ssid.c_str(), sizeof(ap.ssid) - 1);
+    ap.ssid[sizeof(ap.ssid) - 1] = 0;
+    memcpy(ap.bssid, bssid, 6);
+    ap.rssi = rssi;
+    ap.encrypted = WiFi.encryptionType(i) != ENC_TYPE_NONE;
+    ap.seen = now;
+  }
+
+  // age out and sort (insertion sort, the cache holds a handful of entries)
+  int kept = 0;
+  for (int i = 0; i < _scanCount; i++) {
+    if (now - _scanCache[i].seen > _scanInterval * WM_SCAN_MAX_AGE) continue;
+    WM_SCAN_ENTRY ap = _scanCache[i];
+    int j = kept++;
+    while (j > 0 && _scanCache[j - 1].rssi < ap.rssi) {
+      _scanCache[j] = _scanCache[j - 1];
+      j--;
+    }
+    _scanCache[j] = ap;
+  }
+  _scanCount = kept;
+  DEBUG_WM(F("Networks in scan cache: "));
+  DEBUG_WM(_scanCount);
+}
+
+//sets the number of seconds between two background scans
+void WiFiManager::setScanInterval(unsigned long seconds) {
+  _scanInterval = seconds * 1000;
+}
+
 template <typename Generic>
 void WiFiManager::DEBUG_WM(Generic text) {
   if (_debug) {
@@ -1525,9 +2499,9 @@ int WiFiManager::getRSSIasQuality(int RSSI) {
 }
 
 /** Is this an IP? */
-boolean WiFiManager::isIp(String str) {
-  for (int i = 0; i < str.length(); i++) {
-    int c = str.charAt(i);
+boolean WiFiManager::isIp(const char *str) {
+  for (; *str; str++) {
+    char c = *str;
     if (c != '.' && (c < '0' || c > '9')) {
       return false;
     }
@@ -1545,6 +2519,16 @@ String WiFiManager::toStringIP(IPAddress ip) {
   return res;
 }
 
+/** MAC to colon separated hex in buf (18 bytes), no heap */
+void WiFiManager::toCharsMac(const uint8_t *mac, char *buf) {
+  snprintf(buf, 18, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+/** IP to dotted text in buf (16 bytes), no heap */
+void WiFiManager::toCharsIP(IPAddress ip, char *buf) {
+  snprintf(buf, 16, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+}
+
 // take ip string as input parameter and return IPAddress object
 IPAddress WiFiManager::stringToIP(String ip_string)
 {
@@ -1585,74 +2569,157 @@ void WiFiManager::SPIFFS_List()
 }
 
 //indicator led blinking if running in AP mode otherwise off
+//called once per blink period by the scheduler, flips the led state instead of waiting
 void WiFiManager::AP_Led_Indicator(bool ap_activated)
 {
   if(ap_activated)
   {
-    analogWrite(indicator, 3);
-    delay(1000);
+    led_on = !led_on;
+    analogWrite(indicator, led_on ? 3 : 0);
+  }
+  else if(led_on)
+  {
+    led_on = false;
     analogWrite(indicator, 0);
-    delay(1000);
   }
 }
 
+// wifi credentials live in the config record, see loadConfig/saveConfig.
+// with an ssid given they are saved, otherwise the saved ones are loaded into ssid_, pass_
 void WiFiManager::SPIFFS_Credentials(String input_ssid, String input_pass)
 {
+  loadConfig();
+  if(input_ssid!="")
+  {
+	DEBUG_WM(F("\nWriting credentials..."));
+	strncpy(_config.ssid, input_ssid.c_str(), WM_CONFIG_SSID_MAX);
+	_config.ssid[WM_CONFIG_SSID_MAX] = 0;
+	strncpy(_config.pass, input_pass.c_str(), WM_CONFIG_PASS_MAX);
+	_config.pass[WM_CONFIG_PASS_MAX] = 0;
+	saveConfig();
+  }
+  else if(_config.ssid[0])
+  {
+	DEBUG_WM(F("SSID: "));
+	DEBUG_WM(_config.ssid);
+	ssid_ = _config.ssid;
+	pass_ = _config.pass;
+	// if true means credentials exist in SPIFFS, 
+	// then load it and instruct server connect to network. 
+	// If false means new credentials, then after connect successfull to network, save it to SPIFFS. 
+	wifi_credentials_ok = true; 
+  }
+  DEBUG_WM("Credentials check done.");
+}
+
+// the record is read once and cached, later calls only look at _config
+void WiFiManager::loadConfig()
+{
+  if (_configLoaded) return;
+  _configLoaded = true;
+  SPIFFS.begin();
+  if (readConfig(WM_CONFIG_FILE)) return;
+  // power lost between removing the old record and the rename in saveConfig, the temp copy is whole if its CRC holds
+  if (readConfig(WM_CONFIG_TEMP_FILE))
+  {
+	DEBUG_WM(F("Config recovered from temp file"));
+	SPIFFS.remove(WM_CONFIG_FILE);
+	SPIFFS.rename(WM_CONFIG_TEMP_FILE, WM_CONFIG_FILE);
+	return;
+  }
+  migrateLegacyConfig();
+}
+
+bool WiFiManager::readConfig(const char *path)
+{
+  File f = SPIFFS.open(path, "r");
+  if (!f) return false;
+  uint8_t buf[WM_CONFIG_SIZE];
+  size_t len = f.read(buf, sizeof(buf));
+  f.close();
+  WM_CONFIG_RESULT res = decodeConfig(buf, len, _config);
+  if (res != WM_CONFIG_OK)
+  {
+	DEBUG_WM(F("Config record rejected:"));
+	DEBUG_WM(path);
+	DEBUG_WM(configResultText(res));
+	return false;
+  }
+  return true;
+}
+
+// write the whole record to a temp file and rename it over the old one,
+// so a reset mid write leaves either the old or the new record, never half of one
+bool WiFiManager::saveConfig()
+{
+  invalidateState();
+  uint8_t buf[WM_CONFIG_SIZE];
+  encodeConfig(_config, buf);
   SPIFFS.begin();
-  String spiffs_ssid, spiffs_pass, line;
+  File f = SPIFFS.open(WM_CONFIG_TEMP_FILE, "w");
+  if (!f)
+  {
+	DEBUG_WM(F("Config file creation failed"));
+	return false;
+  }
+  size_t written = f.write(buf, sizeof(buf));
+  f.close();
+  if (written != sizeof(buf))
+  {
+	DEBUG_WM(F("Config write failed"));
+	SPIFFS.remove(WM_CONFIG_TEMP_FILE);
+	return false;
+  }
+  SPIFFS.remove(WM_CONFIG_FILE); // SPIFFS will not rename onto an existing name
+  if (!SPIFFS.rename(WM_CONFIG_TEMP_FILE, WM_CONFIG_FILE))
+  {
+	DEBUG_WM(F("Config rename failed"));
+	return false;
+  }
+  DEBUG_WM(F("Config saved."));
+  return true;
+}
+
+// one time import of the ';' separated wifi.txt and ip.txt written by older firmware
+void WiFiManager::migrateLegacyConfig()
+{
+  bool found = false;
   File f = SPIFFS.open("/wifi.txt", "r");
-  
-  if (!f) {
-    DEBUG_WM(F("File not existed. Creating file..."));
-    File f = SPIFFS.open("/wifi.txt", "w+");
-    if (!f) {
-      DEBUG_WM(F("File creation failed"));
-    }
-    else
-    {
-      DEBUG_WM(F("File created."));
-    }
-  } 
-  
-  //file ready.
-  //write to file if wifi credentials fed.
-  if(input_ssid!="")
+  if (f)
   {
-    File f = SPIFFS.open("/wifi.txt", "w+");
-    DEBUG_WM(F("\nWriting to file..."));
-    f.print(input_ssid);
-	f.print(";");
-    f.print(input_pass);
-	f.print(";");
-  }
-  else // read file if no wifi credentials fed.
-  {  
-    DEBUG_WM(F("\nReading file..."));
-    while(f.available()) {
-      line = f.readStringUntil('\n');
-    }
-	DEBUG_WM(F("Reading file: "));
-	DEBUG_WM(f);
-	DEBUG_WM(line);
-    spiffs_ssid = line.substring(0,line.indexOf(";"));
-    spiffs_pass = line.substring(line.indexOf(";") + 1);
-    spiffs_pass = spiffs_pass.substring(0,spiffs_pass.indexOf(";"));
-    DEBUG_WM(F("SSID: "));
-	DEBUG_WM(spiffs_ssid);
-    DEBUG_WM(F("Password: "));
-	DEBUG_WM(spiffs_pass);
-	if(spiffs_ssid!="")
+	String ssid = f.readStringUntil(';');
+	String pass = f.readStringUntil(';');
+	f.close();
+	if (ssid != "")
 	{
-		ssid_ = spiffs_ssid;
-		pass_ = spiffs_pass;
-		// if true means credentials exist in SPIFFS, 
-		// then load it and instruct server connect to network. 
-		// If false means new credentials, then after connect successfull to network, save it to SPIFFS. 
-		wifi_credentials_ok = true; 
+	  strncpy(_config.ssid, ssid.c_str(), WM_CONFIG_SSID_MAX);
+	  strncpy(_config.pass, pass.c_str(), WM_CONFIG_PASS_MAX);
 	}
+	found = true;
+  }
+  f = SPIFFS.open("/ip.txt", "r");
+  if (f)
+  {
+	IPAddress ip, netmask, gateway;
+	if (ip.fromString(f.readStringUntil(';').c_str()) && netmask.fromString(f.readStringUntil(';').c_str()) && gateway.fromString(f.readStringUntil(';').c_str()))
+	{
+	  _config.flags |= WM_CONFIG_STATIC_IP;
+	  for (uint8_t i = 0; i < 4; i++)
+	  {
+		_config.ip[i] = ip[i];
+		_config.netmask[i] = netmask[i];
+		_config.gateway[i] = gateway[i];
+	  }
+	}
+	f.close();
+	found = true;
+  }
+  if (found && saveConfig())
+  {
+	DEBUG_WM(F("Legacy wifi.txt/ip.txt imported"));
+	SPIFFS.remove("/wifi.txt");
+	SPIFFS.remove("/ip.txt");
   }
-  f.close();
-  DEBUG_WM("Credentials check done.");
 }
 
 void WiFiManager::sendNTPpacket(IPAddress &address)
@@ -1676,162 +2743,202 @@ void WiFiManager::sendNTPpacket(IPAddress &address)
   Udp.endPacket();
 }
 
-time_t WiFiManager::getNTPTime()
+// lwIP reports the resolved NTP server through this callback. The result is kept at file scope
+// and tagged with a request number so a late answer can never land in a newer request or a dead object.
+static struct {
+  volatile uint8_t seq;
+  volatile bool done;
+  volatile uint32_t ip;
+} ntpDnsResult;
+
+#if LWIP_VERSION_MAJOR == 1
+static void ntpDnsFound(const char *name, ip_addr_t *ipaddr, void *arg)
+#else
+static void ntpDnsFound(const char *name, const ip_addr_t *ipaddr, void *arg)
+#endif
 {
-  IPAddress ntpServerIP; // NTP server's ip address
-  while (Udp.parsePacket() > 0) ; // discard any previously received packets
-  DEBUG_WM(F("Transmit NTP Request"));
-  // get a random server from the pool
-  WiFi.hostByName(ntpServerName, ntpServerIP);
-  DEBUG_WM(ntpServerName);
-  DEBUG_WM(ntpServerIP);
-  sendNTPpacket(ntpServerIP);
-  uint32_t beginWait = millis();
-  while (millis() - beginWait < 1500) {
-    int size = Udp.parsePacket();
-    if (size >= NTP_PACKET_SIZE) {
-      DEBUG_WM(F("Receive NTP Response"));
-      Udp.read(packetBuffer, NTP_PACKET_SIZE);  // read packet into the buffer
-      unsigned long secsSince1900;
-      // convert four bytes starting at location 40 to a long integer
-      secsSince1900 =  (unsigned long)packetBuffer[40] << 24;
-      secsSince1900 |= (unsigned long)packetBuffer[41] << 16;
-      secsSince1900 |= (unsigned long)packetBuffer[42] << 8;
-      secsSince1900 |= (unsigned long)packetBuffer[43];
-      return secsSince1900 - 2208988800UL + timeZone * SECS_PER_HOUR;
-    }
+  if ((uint8_t)(uintptr_t)arg != ntpDnsResult.seq) return;
+#if LWIP_VERSION_MAJOR == 1
+  ntpDnsResult.ip = ipaddr ? ipaddr->addr : 0;
+#else
+  ntpDnsResult.ip = ipaddr ? ip4_addr_get_u32(ip_2_ip4(ipaddr)) : 0;
+#endif
+  ntpDnsResult.done = true;
+}
+
+// NTP sync engine, stepped by the ntp task once the station is connected.
+// resolve the pool name without blocking, keep one request in flight, retry with exponential
+// backoff on failure and re-sync every WM_NTP_SYNC_INTERVAL seconds once the clock is set.
+void WiFiManager::taskNtp()
+{
+  if (WiFi.status() != WL_CONNECTED) {
+    _ntpState = NTP_IDLE;
+    return;
+  }
+  unsigned long ms = millis();
+  switch (_ntpState)
+  {
+	case NTP_IDLE:
+	{
+	  if (_ntpNextAttempt != 0 && (long)(ms - _ntpNextAttempt) < 0) return;
+	  if (!_ntpUdpStarted) {
+		DEBUG_WM(F("Starting UDP"));
+		Udp.begin(localPort);
+		_ntpUdpStarted = true;
+	  }
+	  ip_addr_t addr;
+	  ntpDnsResult.seq++;
+	  ntpDnsResult.done = false;
+	  _ntpStateAt = ms;
+	  err_t err = dns_gethostbyname(ntpServerName, &addr, &ntpDnsFound, (void*)(uintptr_t)ntpDnsResult.seq);
+	  if (err == ERR_OK) {
+#if LWIP_VERSION_MAJOR == 1
+		_ntpServerIP = IPAddress(addr.addr);
+#else
+		_ntpServerIP = IPAddress(ip4_addr_get_u32(ip_2_ip4(&addr)));
+#endif
+		ntpSendRequest();
+	  } else if (err == ERR_INPROGRESS) {
+		_ntpState = NTP_RESOLVING;
+	  } else {
+		DEBUG_WM(F("NTP server lookup failed"));
+		ntpRetry();
+	  }
+	  break;
+	}
+
+	case NTP_RESOLVING:
+	  if (ntpDnsResult.done) {
+		if (ntpDnsResult.ip == 0) {
+		  DEBUG_WM(F("NTP server lookup failed"));
+		  ntpRetry();
+		  return;
+		}
+		_ntpServerIP = IPAddress((uint32_t)ntpDnsResult.ip);
+		DEBUG_WM(ntpServerName);
+		DEBUG_WM(_ntpServerIP);
+		ntpSendRequest();
+	  } else if (ms - _ntpStateAt >= WM_NTP_DNS_TIMEOUT) {
+		DEBUG_WM(F("NTP server lookup timed out"));
+		ntpDnsResult.seq++; // ignore the answer if it still arrives
+		ntpRetry();
+	  }
+	  break;
+
+	case NTP_WAIT_REPLY:
+	{
+	  int size = Udp.parsePacket();
+	  if (size >= NTP_PACKET_SIZE) {
+		DEBUG_WM(F("Receive NTP Response"));
+		Udp.read(packetBuffer, NTP_PACKET_SIZE);  // read packet into the buffer
+		unsigned long secsSince1900;
+		// convert four bytes starting at location 40 to a long integer
+		secsSince1900 =  (unsigned long)packetBuffer[40] << 24;
+		secsSince1900 |= (unsigned long)packetBuffer[41] << 16;
+		secsSince1900 |= (unsigned long)packetBuffer[42] << 8;
+		secsSince1900 |= (unsigned long)packetBuffer[43];
+		setSyncInterval(WM_NTP_SYNC_INTERVAL);
+		setTime(secsSince1900 - 2208988800UL + timeZone * SECS_PER_HOUR);
+		_ntpBackoff = 0;
+		_ntpNextAttempt = ms + WM_NTP_SYNC_INTERVAL * 1000UL;
+		_ntpState = NTP_IDLE;
+	  } else if (size > 0) {
+		Udp.flush(); // not an NTP answer, drop it
+	  } else if (ms - _ntpStateAt >= WM_NTP_REPLY_TIMEOUT) {
+		DEBUG_WM(F("No NTP Response :-("));
+		ntpRetry();
+	  }
+	  break;
+	}
   }
-  DEBUG_WM(F("No NTP Response :-("));
-  return 0; // return 0 if unable to get the time
 }
 
-void WiFiManager::ntpInnitialize()
+void WiFiManager::ntpSendRequest()
 {
-  DEBUG_WM(F("Starting UDP"));
-  Udp.begin(localPort);
-  //DEBUG_WM(F("Local port: "));
-  //DEBUG_WM(Udp.localPort());
-  DEBUG_WM(F("waiting for sync"));
-  setSyncProvider(getNTPTime());
-  //setSyncProvider(getExternalTime(getNTPTime()));
-  setSyncInterval(10000);
+  while (Udp.parsePacket() > 0) Udp.flush(); // discard any previously received packets
+  DEBUG_WM(F("Transmit NTP Request"));
+  sendNTPpacket(_ntpServerIP);
+  _ntpStateAt = millis();
+  _ntpState = NTP_WAIT_REPLY;
 }
 
-void WiFiManager::SPIFFS_IP_Configure(String static_ip)
+void WiFiManager::ntpRetry()
 {
+  _ntpBackoff = (_ntpBackoff == 0) ? WM_NTP_MIN_BACKOFF : std::min(_ntpBackoff * 2, (unsigned long)WM_NTP_MAX_BACKOFF);
+  _ntpNextAttempt = millis() + _ntpBackoff;
+  _ntpState = NTP_IDLE;
+}
 
+void WiFiManager::SPIFFS_IP_Configure(String static_ip)
+{
   DEBUG_WM("SPIFFS ip configure start");
-  SPIFFS.begin();
-  File f = SPIFFS.open("/ip.txt", "r");
-  if (!f) 
-  {
-	DEBUG_WM(F("IP text file not existed. Creating file..."));
-	File f = SPIFFS.open("/ip.txt", "w+");
-	if (!f) {
-		DEBUG_WM(F("IP text file creation failed"));
-	}
-	else
-	{
-		DEBUG_WM(F("IP text file created."));
-	}
-  }
-  //if static ip fed (static ip mode), write ip details to spiff file (ip.txt)
+  loadConfig();
+  //if static ip fed (static ip mode), keep it with the current netmask and gateway
   if(static_ip!="")
   {
-	DEBUG_WM(F("\nStatic ip mode"));	
-	File f = SPIFFS.open("/ip.txt", "w+");
-	//file ready. Start to write ip details
-    DEBUG_WM(F("\nWriting ip details to file..."));
+	DEBUG_WM(F("\nStatic ip mode"));
+	ip_info.static_ip = stringToIP(static_ip);
+	ip_info.netmask = WiFi.subnetMask();
+	ip_info.gateway = WiFi.gatewayIP();
 	DEBUG_WM("Static IP:");
-	DEBUG_WM(static_ip);
-    f.print(static_ip);
-	f.print(";");
+	DEBUG_WM(ip_info.static_ip);
 	DEBUG_WM("Subnet:");
-	DEBUG_WM(WiFi.subnetMask());
-	f.print(WiFi.subnetMask());
-	f.print(";");
+	DEBUG_WM(ip_info.netmask);
 	DEBUG_WM("Gateway:");
-	DEBUG_WM(WiFi.gatewayIP());
-	f.print(WiFi.gatewayIP());
-	f.print(";");
-	f.close();
+	DEBUG_WM(ip_info.gateway);
+	for (uint8_t i = 0; i < 4; i++)
+	{
+	  _config.ip[i] = ip_info.static_ip[i];
+	  _config.netmask[i] = ip_info.netmask[i];
+	  _config.gateway[i] = ip_info.gateway[i];
+	}
+	_config.flags |= WM_CONFIG_STATIC_IP;
+	saveConfig();
 	is_Static_IP = true;
   }
-  else// no static ip fed (dhcp mode chosen),clear ip details in spiff file (ip.txt)
+  else// no static ip fed (dhcp mode chosen), clear ip details in the config record
   {
-	DEBUG_WM(F("\nDHCP mode, clearing ip text file..."));
+	DEBUG_WM(F("\nDHCP mode, clearing ip details..."));
 	SPIFFS_Clear_IP();
 	is_Static_IP = false;
   }
   server->sendHeader("Connection", "close");
   server->sendHeader("Access-Control-Allow-Origin", "*");
   server->send(200, "text/plain","IP Configuration Done.");
-  DEBUG_WM("SPIFFS ip configuration done.Reseting...");
-  f.close();
-  ESP.reset();
-  delay(2000);
+  DEBUG_WM("SPIFFS ip configuration done, restarting...");
+  scheduleReboot(REBOOT_RESTART); // the static ip is applied on the next boot
 }
 
-// if static ip found in spiffs, load and configure for esp module
-// if no ip details found in spiffs, dhcp mode used.
+// if static ip found in the config record, load and configure for esp module
+// if no ip details found, dhcp mode used.
 void WiFiManager::SPIFFS_IP_Innitialize()
 {
-  SPIFFS.begin();
-  File f = SPIFFS.open("/ip.txt", "r");
-  
-  if (!f) 
-  {
-	DEBUG_WM(F("IP text file not existed. Creating file..."));
-	File f = SPIFFS.open("/ip.txt", "w+");
-	if (!f) 
-	{
-		DEBUG_WM(F("IP text file creation failed"));
-	}
-	else
-	{
-		DEBUG_WM(F("IP text file created."));
-	}
-  }
-  
-  //file ready, start reading...
-  String line = "";
-  DEBUG_WM(F("\nReading file..."));
-  while(f.available()) 
-  {
-    line = f.readStringUntil('\n');
-  }
-  //DHCP mode
-  if(line == "")
+  loadConfig();
+  is_Static_IP = _config.flags & WM_CONFIG_STATIC_IP;
+  if(!is_Static_IP)
   {
 	DEBUG_WM(F("No static ip found, activate dhcp mode."));
-	is_Static_IP = false;
+	return;
   }
-  else// Static ip mode
-  {
-	DEBUG_WM(F("Static ip found, activate static ip mode"));
-	is_Static_IP = true;
-	ip_info.static_ip = line.substring(0,line.indexOf(";"));
-	ip_info.netmask = line.substring(line.indexOf(";") + 1);
-	ip_info.netmask = ip_info.netmask.substring(0,ip_info.netmask.indexOf(";"));
-	ip_info.gateway = line.substring(line.indexOf(";")+1);
-	ip_info.gateway = ip_info.gateway.substring(ip_info.gateway.indexOf(";")+1);
-	ip_info.gateway = ip_info.gateway.substring(0,ip_info.gateway.indexOf(";"));
-	DEBUG_WM(F("Static IP: "));
-	DEBUG_WM(ip_info.static_ip);
-    DEBUG_WM(F("Netmask: "));
-	DEBUG_WM(ip_info.netmask);
-	DEBUG_WM(F("Gateway: "));
-	DEBUG_WM(ip_info.gateway);
-  }
-  f.close();
-  DEBUG_WM("IP innitialized.");
+  DEBUG_WM(F("Static ip found, activate static ip mode"));
+  ip_info.static_ip = IPAddress(_config.ip[0], _config.ip[1], _config.ip[2], _config.ip[3]);
+  ip_info.netmask = IPAddress(_config.netmask[0], _config.netmask[1], _config.netmask[2], _config.netmask[3]);
+  ip_info.gateway = IPAddress(_config.gateway[0], _config.gateway[1], _config.gateway[2], _config.gateway[3]);
+  DEBUG_WM(F("Static IP: "));
+  DEBUG_WM(ip_info.static_ip);
+  DEBUG_WM(F("Netmask: "));
+  DEBUG_WM(ip_info.netmask);
+  DEBUG_WM(F("Gateway: "));
+  DEBUG_WM(ip_info.gateway);
 }
 
 void WiFiManager::SPIFFS_Clear_IP()
 {
-	SPIFFS.begin();
-	File f = SPIFFS.open("/ip.txt", "w+");  
-	f.print("");
-	DEBUG_WM("ip.txt contents cleared.");
-	f.close();
+	loadConfig();
+	_config.flags &= ~WM_CONFIG_STATIC_IP;
+	memset(_config.ip, 0, sizeof(_config.ip));
+	memset(_config.netmask, 0, sizeof(_config.netmask));
+	memset(_config.gateway, 0, sizeof(_config.gateway));
+	saveConfig();
+	DEBUG_WM("ip details cleared.");
 }
@@ -12,9 +12,19 @@
 #include <ESP8266WiFi.h>
 #include <ESP8266WebServer.h>
 #include <FS.h>
-#include <DNSServer.h>
 #include <Time.h>
 #include <WiFiUdp.h>
+#include "ChunkedPrint.h"
+#include "PortalServer.h"
+#include "JsonWriter.h"
+#include "CaptiveDNS.h"
+#include "ConfigRecord.h"
+#include "SettingsStore.h"
+#include "UploadWriter.h"
+#include "AssetBundle.h"
+#include "ResponseCache.h"
+#include "GzipInflater.h"
+#include "PageTemplate.h"
 #include <memory>
 #undef min
 #undef max
@@ -27,23 +37,63 @@ extern "C" {
 #define WFM_LABEL_AFTER 2
 #define WFM_NO_LABEL 0
 
+/* hostname for mDNS. Set to a valid internet address so that user
+will see an information page if they are connected to the wrong network */
+#define WM_PORTAL_HOSTNAME "iot8701.16mb.com/home-automation.html"
+
 const char HTTP_200[] PROGMEM             = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n";
-const char HTTP_HEAD[] PROGMEM            = "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/><title>{v}</title>";
+constexpr char HTTP_HEAD[] PROGMEM        = "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/><title>{v}</title>";
 const char HTTP_STYLE[] PROGMEM           = "<style>body,textarea,input,select{background: 0;border-radius: 0;font: 16px sans-serif;margin: 0}textarea,input,select{outline: 0;font-size: 14px;border: 1px solid #ccc;padding: 8px;width: 90%}.btn a{text-decoration: none}.container{margin: auto;width: 90%}@media(min-width:1200px){.container{margin: auto;width: 30%}}@media(min-width:768px) and (max-width:1200px){.container{margin: auto;width: 50%}}.btn,h2{font-size: 2em}h1{font-size: 3em}.btn{background: #286090;border-radius: 4px;border: 0;color: #fff;cursor: pointer;display: inline-block;margin: 2px 0;padding: 10px 14px 11px;width: 100%}.btn:hover{background: #337AB7}.btn:active,.btn:focus{background: #2E6DA4}label>*{display: inline}form>*{display: block;margin-bottom: 10px}textarea:focus,input:focus,select:focus{border-color: #5ab}.msg{background: #def;border-left: 5px solid #59d;padding: 1.5em}.q{float: right;width: 64px;text-align: right}.l{background: url('data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAACAAAAAgCAMAAABEpIrGAAAALVBMVEX///8EBwfBwsLw8PAzNjaCg4NTVVUjJiZDRUUUFxdiZGSho6OSk5Pg4eFydHTCjaf3AAAAZElEQVQ4je2NSw7AIAhEBamKn97/uMXEGBvozkWb9C2Zx4xzWykBhFAeYp9gkLyZE0zIMno9n4g19hmdY39scwqVkOXaxph0ZCXQcqxSpgQpONa59wkRDOL93eAXvimwlbPbwwVAegLS1HGfZAAAAABJRU5ErkJggg==') no-repeat left center;background-size: 1em}input[type='checkbox']{float: left;width: 20px}.table td{padding:.5em;text-align:left}.table tbody>:nth-child(2n-1){background:#ddd}</style>";
 const char HTTP_CUSTOM_STYLE[] PROGMEM	  = "<style>gpio_table {border-collapse: collapse;width: 100%;}th, td {text-align: left;padding: 8px;}tr:nth-child(even){background-color: #f2f2f2}th {background-color: #286090;color: white;}input[type=\"text\"]{border: 1px solid #cccccc;}ul.breadcrumb{padding: 10px 16px;list-style: none;background-color: #eee;font-size: 17px;}ul.breadcrumb li {display: inline;}ul.breadcrumb li+li:before {padding: 8px;color: black;content: ' / ';} ul.breadcrumb li a {color: #0275d8;text-decoration: none;}ul.breadcrumb li a:hover {color: #01447e;text-decoration: underline;}</style>";
 const char HTTP_SCRIPT[] PROGMEM          = "<script>function c(l){document.getElementById('s').value=l.innerText||l.textContent;document.getElementById('p').focus();}</script>";
 const char HTTP_HEAD_END[] PROGMEM        = "</head><body><div class=\"container\">";
 const char HTTP_PORTAL_OPTIONS[] PROGMEM  = "<form action=\"/wifi_configuration\" method=\"get\"><button class=\"btn\">WiFi Configuration</button></form><br/><form action=\"/ip_configuration\" method=\"get\"><button class=\"btn\">IP Configuration</button></form><br/><form action=\"/gpio_control\" method=\"get\"><button class=\"btn\">WiFi Switches Control</button></form><br/><form action=\"/firmware_update\" method=\"get\"><button class=\"btn\">Firmware Update</button></form><br/><form action=\"/editor_page\" method=\"get\"><button class=\"btn\">System File Editor</button></form><br/><form action=\"/extra_functions\" method=\"get\"><button class=\"btn\">Extra Funtions</button></form><br/>";
-const char HTTP_ITEM[] PROGMEM            = "<div><a href=\"#p\" onclick=\"c(this)\">{v}</a>&nbsp;<span class=\"q {i}\">{r}%</span></div>";
-const char JSON_ITEM[] PROGMEM            = "{\"SSID\":\"{v}\", \"Encryption\":{i}, \"Quality\":\"{r}\"}";
+constexpr char HTTP_ITEM[] PROGMEM        = "<div><a href=\"#p\" onclick=\"c(this)\">{v}</a>&nbsp;<span class=\"q {i}\">{r}%</span></div>";
 const char HTTP_FORM_START[] PROGMEM      = "<form method=\"get\" action=\"wifi_save\"><label>SSID</label><input id=\"s\" name=\"s\" length=32 placeholder=\"SSID\"><label>Password</label><input id=\"p\" name=\"p\" length=64 placeholder=\"password\">";
-const char HTTP_FORM_LABEL[] PROGMEM      = "<label for=\"{i}\">{p}</label>";
-const char HTTP_FORM_PARAM[] PROGMEM      = "<input id=\"{i}\" name=\"{n}\" length={l} placeholder=\"{p}\" value=\"{v}\" {c}>";
+constexpr char HTTP_FORM_LABEL[] PROGMEM  = "<label for=\"{i}\">{p}</label>";
+constexpr char HTTP_FORM_PARAM[] PROGMEM  = "<input id=\"{i}\" name=\"{n}\" length={l} placeholder=\"{p}\" value=\"{v}\" {c}>";
 const char HTTP_FORM_END[] PROGMEM        = "<button class=\"btn\" type=\"submit\">save</button></form>";
-const char HTTP_SAVED[] PROGMEM           = "<div class=\"msg\"><strong>Credentials Saved</strong><br>Trying to connect ESP to the {x} network.<br>Give it 10 seconds or so and check <a href=\"/\">how it went.</a> <p/>The {v} network you are connected to will be restarted on the radio channel of the {x} network. You may have to manually reconnect to the {v} network.</div>";
+constexpr char HTTP_SAVED[] PROGMEM       = "<div class=\"msg\"><strong>Credentials Saved</strong><br>Trying to connect ESP to the {x} network.<br>Progress is shown below, or check <a href=\"/\">how it went.</a> <p/>The {v} network you are connected to will be restarted on the radio channel of the {x} network. You may have to manually reconnect to the {v} network.</div>";
+const char HTTP_CONNECT_POLL[] PROGMEM    = "<div class=\"msg\" id=\"cs\">Connecting...</div><script>function st(){var x=new XMLHttpRequest();x.onload=function(){var s=JSON.parse(x.responseText);document.getElementById('cs').innerHTML='<strong>'+s.State+'</strong> '+s.Status+(s.Station_IP?' on <a href=\"http://'+s.Station_IP+'/\">'+s.Station_IP+'</a>':'');if(s.State!='CONNECTED'&&s.State!='FAILED')setTimeout(st,1000);};x.onerror=function(){setTimeout(st,2000);};x.open('GET','/json_connect_status');x.send();}setTimeout(st,1000);</script>";
 const char HTTP_END[] PROGMEM             = "</div></body></html>";
+// whole answer to connectivity probes and requests for foreign hosts, sent as is
+const char HTTP_CAPTIVE_REDIRECT[] PROGMEM = "HTTP/1.1 302 Found\r\nLocation: http://" WM_PORTAL_HOSTNAME "\r\n"
+                                             "Cache-Control: no-cache, no-store, must-revalidate\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+// placeholder tables of the fragments above, resolved by the compiler
+WM_TEMPLATE(TPL_HEAD,       HTTP_HEAD);
+WM_TEMPLATE(TPL_ITEM,       HTTP_ITEM);
+WM_TEMPLATE(TPL_FORM_LABEL, HTTP_FORM_LABEL);
+WM_TEMPLATE(TPL_FORM_PARAM, HTTP_FORM_PARAM);
+WM_TEMPLATE(TPL_SAVED,      HTTP_SAVED);
 
 #define WIFI_MANAGER_MAX_PARAMS 10
+#define WM_CONNECT_RESET_SETTLE 500       // ms the radio is left off before a new connect attempt
+#define WM_CONNECT_DEFAULT_TIMEOUT 30000  // ms to wait for a connect result when no connect timeout is set
+#define WM_MAX_SCAN_RESULTS 20            // APs kept in the scan cache
+#define WM_SCAN_INTERVAL 30               // default seconds between background scans
+#define WM_SCAN_MAX_AGE 3                 // scan periods an AP may go unseen before it leaves the cache
+#define WM_ASSET_CACHE_SIZE 12           // logical paths whose SPIFFS resolution is remembered
+#define WM_ASSET_PATH_LEN 32              // longest SPIFFS path, including the terminating 0
+#define WM_ETAG_LEN 16                    // hex digits of an asset ETag
+#define WM_ETAG_FILE "/etags.txt"         // manifest of the ETags of the files on SPIFFS
+#define WM_ETAG_TEMP_FILE "/etags.tmp"
+#define WM_ETAG_SLICE 512                 // bytes taskTag() hashes per scheduler pass
+#define WM_MAX_RANGES 4                   // byte ranges served in one multipart answer
+#define WM_GPIO_EVENT_LEN 96              // bytes of one /events GPIO payload, the alias is cut to fit
+// binary GPIO messages on the /ws socket, first byte is the operation
+#define WM_GPIO_OP_TOGGLE 0x01            // client: pin, state (0/1), alias bytes (none clears the alias)
+#define WM_GPIO_OP_STATUS 0x02            // client: send me every pin
+#define WM_GPIO_OP_SWITCH 0x03            // client: pin, state (0/1), the alias is kept
+#define WM_GPIO_OP_STATE  0x10            // portal: pin, state (0/1), alias bytes
+#define WM_HASH_SEED 0xCBF29CE484222325ULL // FNV-1a 64 bit offset basis
+#define WM_UPLOAD_LOG_STEP 32768          // editor upload progress is logged each time this many bytes have arrived
+#define WM_REBOOT_DELAY 5000              // ms between the restart/reset page and the reboot
+#define WM_NTP_SYNC_INTERVAL 3600         // seconds between two NTP syncs once the clock is set
+#define WM_NTP_DNS_TIMEOUT 5000           // ms allowed to resolve the NTP server
+#define WM_NTP_REPLY_TIMEOUT 1500         // ms allowed for the NTP server to answer
+#define WM_NTP_MIN_BACKOFF 2000           // ms before the first retry of a failed sync, doubled on each failure
+#define WM_NTP_MAX_BACKOFF 300000         // ms cap of the retry backoff
 
 class WiFiManagerParameter {
   public:
@@ -89,6 +139,8 @@ class WiFiManager
     String        getConfigPortalSSID();
 
     void          resetSettings();
+    //forgets the stored WiFi network (ssid and password), the static IP settings are kept
+    boolean       clearCredentials();
 
     //sets timeout before webserver loop ends and exits even if there has been no setup.
     //usefully for devices that failed to connect at some point and got stuck in a webserver loop
@@ -124,10 +176,18 @@ class WiFiManager
     //Scan for WiFiNetworks in range and sort by signal strength
     //space for indices array allocated on the heap and should be freed when no longer required
     int           scanWifiNetworks(int **indicesptr);
+    //bytes of RAM for cached pages and JSON answers, 0 turns the cache off.
+    //unset, the portal takes up to WM_CACHE_BUDGET but no more than 1/WM_CACHE_HEAP_SHARE of the free heap
+    void          setResponseCacheBudget(size_t bytes);
+    //sets the number of seconds between background scans of the config portal (default 30)
+    void          setScanInterval(unsigned long seconds);
+    //drives one of the portal GPIOs and pushes the change to every open GPIO page.
+    //alias NULL keeps the stored alias
+    void          setGPIO(uint8_t pin, boolean on, const char *alias = NULL);
 
   private:
-    std::unique_ptr<DNSServer>        dnsServer;
-    std::unique_ptr<ESP8266WebServer> server;
+    std::unique_ptr<CaptiveDNS>       dnsServer;
+    std::unique_ptr<PortalServer> server;
 
     //const int     WM_DONE                 = 0;
     //const int     WM_WAIT                 = 10;
@@ -145,12 +205,22 @@ class WiFiManager
     unsigned long _configPortalTimeout    = 0;
     unsigned long _connectTimeout         = 0;
     unsigned long _configPortalStart      = 0;
-    /* hostname for mDNS. Set to a valid internet address so that user
-    will see an information page if they are connected to the wrong network */
-	const char *myHostname = "iot8701.16mb.com/home-automation.html";
-	int numberOfNetworks;
-	int *networkIndices;
-    int **networkIndicesptr = &networkIndices;
+	const char *myHostname = WM_PORTAL_HOSTNAME;
+
+	// background scan cache, refreshed by the scan task and sorted by signal strength
+	struct WM_SCAN_ENTRY{
+		char ssid[33];
+		uint8_t bssid[6];
+		int32_t rssi;
+		bool encrypted;
+		unsigned long seen; // millis() of the last scan that reported this AP
+	};
+	WM_SCAN_ENTRY _scanCache[WM_MAX_SCAN_RESULTS];
+	int _scanCount = 0;
+	bool _scanRunning = false;
+	unsigned long _scanLastStart = 0;
+	unsigned long _scanInterval = WM_SCAN_INTERVAL * 1000UL;
+	void mergeScanResults(int n);
 
     IPAddress     _ap_static_ip;
     IPAddress     _ap_static_gw;
@@ -170,9 +240,24 @@ class WiFiManager
     //void          setEEPROMString(int start, int len, String string);
 
     int           status = WL_IDLE_STATUS;
-    int           connectWifi(String ssid, String pass);
     uint8_t       waitForConnectResult();
 
+    // non-blocking connect state machine, stepped by the connect task
+    enum ConnectState { CONNECT_IDLE, CONNECT_RESET, CONNECT_WAIT, CONNECT_CONNECTED, CONNECT_FAILED };
+    ConnectState  _connectState           = CONNECT_IDLE;
+    String        _connectSSID            = "";
+    String        _connectPass            = "";
+    unsigned long _connectStart           = 0;
+    unsigned long _connectStateAt         = 0;
+    int           _connectResult          = WL_IDLE_STATUS;
+    boolean       _connectUserRequested   = false;
+    boolean       _connectTriedWPS        = false;
+    void          beginConnect(String ssid, String pass, bool userRequested);
+    void          stepConnect();
+    void          finishConnect(int connRes);
+    void          setConnectState(ConnectState state);
+    const char*   getConnectStateName(ConnectState state);
+
     void          handleRoot();
     void          handleWifi();
     void          handleWifiSave();
@@ -180,13 +265,23 @@ class WiFiManager
     void          handleInfo();
     void          handleState();
     void          handleScan();
+    void          handleConnectStatus();
+    void          handleMetrics();
     void          handleReset();
 	void 		  handleGPIOControl();
 	void		  handleGPIOToggle();
 	void		  handleGPIOStatus();
+	void		  handleEvents();
+	void		  handleSocket();
+	void		  handleSocketMessage(const uint8_t *payload, size_t len);
+	void		  sendGPIOFrame(uint8_t pin);
 	void		  handleFirmwareUpdatePage();
 	void		  handleUpdateHeader();
 	void		  handleUpdate();
+	std::unique_ptr<GzipInflater> _otaInflater; // set while a gzip image is being received
+	uint32_t      _otaReceived = 0;             // upload bytes, compressed or not
+	boolean       _otaFailed = false;           // the image was refused, even when Update saw no error
+	void          failUpdate(const char *reason);
 	void		  handleTime();
 	void		  handleRestart();
 	void		  handleIPConfigurationPage();
@@ -202,7 +297,8 @@ class WiFiManager
 	void 		  handleFileDelete();
     void          handleNotFound();
     boolean       captivePortal();
-    void          reportStatus(String &page);
+    void          reportStatus(Print &page);
+    void          pageHead(Print &page, const char *title, boolean customStyle);
 	
     // DNS server
     const byte    DNS_PORT = 53;
@@ -216,7 +312,61 @@ class WiFiManager
 	String pass_;
 	
 	// SPIFFS Editor
-	File fsUploadFile;
+	UploadWriter _upload;
+	
+	// static assets, logical path -> backing file resolution cache
+	enum { ASSET_PLAIN, ASSET_GZIP, ASSET_BROTLI, ASSET_VARIANTS };
+	struct WM_ASSET_ENTRY{
+		char path[WM_ASSET_PATH_LEN];  // logical path, empty when the slot is free
+		uint8_t variants;              // bit per stored variant, 0 when the asset is missing
+		uint64_t etag[ASSET_VARIANTS]; // ETag hash of each stored variant
+		uint32_t modified;             // last modified (UTC seconds) of the newest variant, 0 when unknown
+		uint8_t pending;               // bit per variant without an ETag yet, taskTag() hashes them
+	};
+	static_assert(WM_BUNDLE_PATH_LEN <= WM_ASSET_PATH_LEN, "bundle paths must fit an asset cache entry");
+	WM_ASSET_ENTRY _assetCache[WM_ASSET_CACHE_SIZE] = {};
+	uint8_t _assetCacheNext = 0;
+	uint64_t _uploadHash = WM_HASH_SEED;
+	WM_ASSET_ENTRY* findAsset(const char *path);
+	WM_ASSET_ENTRY* resolveAsset(const String &path);
+	void assetPhysicalPath(const WM_ASSET_ENTRY *entry, uint8_t variant, char *physical, size_t size);
+	uint8_t negotiateAsset(const WM_ASSET_ENTRY *entry);
+	boolean acceptsEncoding(const char *accept, const char *coding);
+	void invalidateAsset(const String &path);
+	void serveAsset(const String &path, bool download = false);
+	boolean serveBundled(const String &path, bool download);
+	AssetBundle _bundle; // packed assets, searched before the loose files
+	ResponseCache _cache; // bodies of small assets (key: logical path, variant) and of JSON answers (key: route)
+	size_t _cacheBudget = 0;
+	boolean _cacheBudgetSet = false;
+	WiFiEventHandler _gotIPHandler, _disconnectedHandler;
+	volatile boolean _stateChanged = false; // set from the WiFi events, see setupConfigPortal
+	void sendAssetStart(const String &path, const WM_ASSET_ENTRY *entry, uint8_t variant, bool download);
+	boolean sendCachedAsset(const String &path, const WM_ASSET_ENTRY *entry, uint8_t variant, bool download);
+	boolean cacheAssetBody(File &file, size_t base, size_t size, const char *contentType, const WM_ASSET_ENTRY *entry, uint8_t variant);
+	void writeState(Print &out);
+	void invalidateState();
+	boolean assetNotModified(const WM_ASSET_ENTRY *entry, uint8_t variant);
+	void sendAssetHeaders(const WM_ASSET_ENTRY *entry, uint8_t variant);
+	struct WM_RANGE{
+		size_t start;
+		size_t end; // inclusive
+	};
+	boolean assetRangeValid(const WM_ASSET_ENTRY *entry, uint8_t variant);
+	int parseRanges(const char *header, size_t size, WM_RANGE *ranges);
+	void sendAssetBody(File &file, size_t base, size_t size, boolean shared, const char *contentType, const WM_ASSET_ENTRY *entry, uint8_t variant);
+	void sendAssetRanges(File &file, size_t base, size_t size, boolean shared, const char *contentType);
+	void sendFileRange(WiFiClient &client, File &file, size_t start, size_t len);
+	uint64_t hashBytes(uint64_t hash, const uint8_t *buf, size_t len);
+	File _tagFile;                                 // file taskTag() is hashing
+	char _tagPath[WM_ASSET_PATH_LEN + 3];
+	uint64_t _tagHash = WM_HASH_SEED;
+	void hashToETag(uint64_t hash, char *etag);
+	uint8_t readAssetTags(WM_ASSET_ENTRY *entry);
+	void writeAssetTag(const char *physical, const uint64_t *etag, uint32_t modified);
+	uint32_t utcNow();
+	void formatHttpDate(uint32_t t, char *buf);
+	time_t parseHttpDate(const char *text);
 	
 	//NTP Synchronization
 	const char* ntpServerName = "asia.pool.ntp.org";
@@ -225,20 +375,41 @@ class WiFiManager
 	unsigned int localPort = 8888;  // local port to listen for UDP packets
 	static const int NTP_PACKET_SIZE = 48; // NTP time is in the first 48 bytes of message
 	byte packetBuffer[NTP_PACKET_SIZE]; //buffer to hold incoming & outgoing packets
-	void ntpInnitialize();
+	enum NtpState { NTP_IDLE, NTP_RESOLVING, NTP_WAIT_REPLY };
+	NtpState _ntpState = NTP_IDLE;
+	IPAddress _ntpServerIP;
+	bool _ntpUdpStarted = false;
+	unsigned long _ntpStateAt = 0;     // millis() when the current lookup/request started
+	unsigned long _ntpNextAttempt = 0; // millis() of the next sync, 0 means as soon as connected
+	unsigned long _ntpBackoff = 0;
 	void sendNTPpacket(IPAddress &address);
-	time_t getNTPTime();
+	void ntpSendRequest();
+	void ntpRetry();
 	
 	// IP Configuration
 	void SPIFFS_IP_Configure(String static_ip);
 	void SPIFFS_IP_Innitialize();
 	void SPIFFS_Clear_IP();
 	bool is_Static_IP = false;
+
+	// Config record, one binary file holding credentials and ip details (ConfigRecord.h)
+	WM_CONFIG _config;
+	bool _configLoaded = false;
+	void loadConfig();
+	bool readConfig(const char *path);
+	bool saveConfig();
+	void migrateLegacyConfig();
+
+	// Settings store, GPIO aliases and custom parameter values (SettingsStore.h)
+	SettingsStore _settings;
+	void loadSettings();
 	
     //helpers
     int           getRSSIasQuality(int RSSI);
-    boolean       isIp(String str);
+    boolean       isIp(const char *str);
     String        toStringIP(IPAddress ip);
+    void          toCharsMac(const uint8_t *mac, char *buf);
+    void          toCharsIP(IPAddress ip, char *buf);
 	IPAddress	  stringToIP(String ip_string);
 
     boolean       connect;
@@ -248,21 +419,56 @@ class WiFiManager
 	//indicator on when running in ap mode
 	const byte indicator = 4;
 	bool ap_mode = false;
+	bool led_on = false;
 	void AP_Led_Indicator(bool activate);
 	
+	// Cooperative scheduler driving the config portal loop.
+	// Every task owns a deadline (millis) and is run once it has passed, tasks never call delay().
+	typedef void (WiFiManager::*TaskHandler)();
+	struct WM_TASK{
+		const char *name;
+		TaskHandler handler;
+		unsigned long interval; // ms between two runs, 0 means run on every pass
+		unsigned long deadline; // millis() at which the task is due next
+	};
+	enum { TASK_LED, TASK_DNS, TASK_HTTP, TASK_CONNECT, TASK_HOUSEKEEPING, TASK_SCAN, TASK_NTP, TASK_REBOOT, TASK_TAG, TASK_COUNT };
+	WM_TASK _tasks[TASK_COUNT];
+	bool _portalDone = false;
+	bool _portalTimedOut = true;
+	LatencyHistogram _loopTime = LatencyHistogram(50); // one scheduler pass, buckets from 50 us
+	void setupTasks();
+	void runTasks();
+	void deferTask(uint8_t id, unsigned long ms);
+	unsigned long getTaskDeadline(uint8_t id);
+	void taskLed();
+	void taskDns();
+	void taskHttp();
+	void taskConnect();
+	void taskHousekeeping();
+	void taskScan();
+	void taskNtp();
+	void taskReboot();
+	void taskTag();
+	enum RebootMode { REBOOT_NONE, REBOOT_RESTART, REBOOT_RESET };
+	RebootMode _reboot = REBOOT_NONE;
+	void scheduleReboot(RebootMode mode);
+	
 	//GPIO Struct
 	//dont use gpio4 (indicator purpose) and gpio13(factory reset purpose)
 	struct GPIOP{
 		String status = "Off";
 		String alias ="";
 	} gpio0, gpio2, gpio5, gpio12, gpio14, gpio15, gpio16;
+	GPIOP*        gpioByPin(long pin);
+	void          formatGPIOEvent(uint8_t pin, const GPIOP &gpio, char *buf, size_t size);
+	size_t        formatGPIOFrame(uint8_t pin, const GPIOP &gpio, uint8_t *buf, size_t size);
 	
-	// IP details struct. loaded from spiffs file (ip.txt) when module started.
-	// empty string when module run in dhcp otherwise static mode.
+	// IP details struct. loaded from the config record when module started.
+	// only meaningful when is_Static_IP, dhcp mode otherwise.
 	struct IP_INFO{
-		String static_ip = "";
-		String netmask = "";
-		String gateway = "";
+		IPAddress static_ip;
+		IPAddress netmask;
+		IPAddress gateway;
 	} ip_info;
 	
     void (*_apcallback)(WiFiManager*) = NULL;
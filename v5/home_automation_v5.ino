@@ -18,7 +18,8 @@ const char* ap_ssid = "Captive-Portal-V5.0"; // ssid esp8266 uses when first tim
 const char* ap_password = "password"; //password to login when esp8266 start in network configuration mode
 ///####################################################################### Functions #########################################################################################################################
 void GPIO_Innitialize(){pinMode(5, OUTPUT);pinMode(12, OUTPUT);pinMode(14, OUTPUT);pinMode(indicator, INPUT);  digitalWrite(5, LOW);digitalWrite(12, LOW);digitalWrite(14, LOW);digitalWrite(indicator, LOW);}
-void SPIFFS_Clear_Credentials(){SPIFFS.begin();File f = SPIFFS.open("/wifi.txt", "w+");  f.print("");f.close();}
+WiFiManager *portal_manager = NULL; //set once the config portal runs, the reset button is armed from then on
+void SPIFFS_Clear_Credentials(){if(portal_manager) portal_manager->clearCredentials();} //static IP settings survive the factory reset
 void Reset_Handle(bool activated)
 {
   if(activated)
@@ -60,7 +61,7 @@ void Reset_Activated()
   } 
   interrupts();
 }
-void configModeCallback (WiFiManager *myWiFiManager) {attachInterrupt(digitalPinToInterrupt(reset_pin), Reset_Activated, CHANGE);}
+void configModeCallback (WiFiManager *myWiFiManager) {portal_manager = myWiFiManager;attachInterrupt(digitalPinToInterrupt(reset_pin), Reset_Activated, CHANGE);}
 ///########################################################################## Setup ##########################################################################################################################
 void setup() {
   Serial.begin(115200);
@@ -70,4 +71,4 @@ void setup() {
   wifi_manager.startConfigPortal(ap_ssid, ap_password);
 }
 ///###################################################################### Loop ###############################################################################################################################
-void loop() {}
+void loop() {}
@@ -235,6 +235,7 @@ void setTime(time_t t){
 #endif
 
   sysTime = t;  
+  prevMillis = millis(); // restart the second count so the new time is exact to the millisecond
   nextSyncTime = t + syncInterval;
   Status = timeSet; 
 } 
@@ -0,0 +1,103 @@
+/**************************************************************
+   BundleWriter - host side writer of the packed asset bundle
+   Licensed under MIT license
+ **************************************************************/
+
+#include "BundleWriter.h"
+#include "ConfigRecord.h"
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+
+static const char* const encodingName[] = { "identity", "gzip", "br" };
+
+uint64_t BundleWriter::hash(const std::vector<uint8_t> &data) {
+  uint64_t h = 0xCBF29CE484222325ULL;
+  for (uint8_t b : data) {
+    h ^= b;
+    h *= 0x100000001B3ULL;
+  }
+  return h;
+}
+
+void BundleWriter::splitName(const std::string &name, std::string &path, uint8_t &encoding) {
+  path = name;
+  encoding = WM_BUNDLE_PLAIN;
+  if (name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0) encoding = WM_BUNDLE_GZIP;
+  else if (name.size() > 3 && name.compare(name.size() - 3, 3, ".br") == 0) encoding = WM_BUNDLE_BROTLI;
+  if (encoding != WM_BUNDLE_PLAIN) path.resize(name.size() - 3);
+}
+
+bool BundleWriter::add(const std::string &path, uint8_t encoding, const std::vector<uint8_t> &data, uint32_t modified) {
+  if (path.empty() || path[0] != '/' || path.size() >= WM_BUNDLE_PATH_LEN) {
+    _error = path + ": path must start with / and be shorter than " + std::to_string(WM_BUNDLE_PATH_LEN) + " bytes";
+    return false;
+  }
+  for (const Asset &a : _assets) {
+    if (a.path == path && a.encoding == encoding) {
+      _error = path + ": added twice as " + encodingName[encoding];
+      return false;
+    }
+  }
+  if (_assets.size() >= WM_BUNDLE_MAX_ENTRIES) {
+    _error = "more than " + std::to_string(WM_BUNDLE_MAX_ENTRIES) + " entries";
+    return false;
+  }
+  _assets.push_back(Asset{path, encoding, data, modified});
+  return true;
+}
+
+bool BundleWriter::write(const char *file) {
+  if (_assets.empty()) {
+    _error = "nothing to bundle";
+    return false;
+  }
+  // the firmware binary searches by strcmp order, then walks the encodings of a path
+  std::sort(_assets.begin(), _assets.end(), [](const Asset &a, const Asset &b) {
+    int order = strcmp(a.path.c_str(), b.path.c_str());
+    return order < 0 || (order == 0 && a.encoding < b.encoding);
+  });
+
+  std::vector<WM_BUNDLE_ENTRY> index(_assets.size());
+  uint32_t offset = WM_BUNDLE_HEADER + index.size() * sizeof(WM_BUNDLE_ENTRY);
+  for (size_t i = 0; i < _assets.size(); i++) {
+    WM_BUNDLE_ENTRY &e = index[i];
+    memset(&e, 0, sizeof(e));
+    strcpy(e.path, _assets[i].path.c_str());
+    e.offset = offset;
+    e.length = _assets[i].data.size();
+    e.modified = _assets[i].modified;
+    e.encoding = _assets[i].encoding;
+    e.etag = hash(_assets[i].data);
+    offset += e.length;
+  }
+
+  size_t indexSize = index.size() * sizeof(WM_BUNDLE_ENTRY);
+  uint32_t crc = configCrc32((const uint8_t*)index.data(), indexSize);
+  uint8_t header[WM_BUNDLE_HEADER] = {'W', 'M', 'A', 'B', WM_BUNDLE_VERSION, 0,
+                                      (uint8_t)index.size(), (uint8_t)(index.size() >> 8),
+                                      (uint8_t)crc, (uint8_t)(crc >> 8), (uint8_t)(crc >> 16), (uint8_t)(crc >> 24)};
+  FILE *f = fopen(file, "wb");
+  if (!f) {
+    _error = std::string(file) + ": " + strerror(errno);
+    return false;
+  }
+  // the index is written as the host lays it out, which matches the module (both little endian)
+  bool ok = fwrite(header, 1, sizeof(header), f) == sizeof(header) &&
+            fwrite(index.data(), 1, indexSize, f) == indexSize;
+  for (size_t i = 0; ok && i < _assets.size(); i++) {
+    ok = fwrite(_assets[i].data.data(), 1, _assets[i].data.size(), f) == _assets[i].data.size();
+  }
+  if (fclose(f) != 0) ok = false;
+  if (!ok) _error = std::string(file) + ": write failed";
+  return ok;
+}
+
+void BundleWriter::report(FILE *out) const {
+  size_t total = WM_BUNDLE_HEADER + _assets.size() * sizeof(WM_BUNDLE_ENTRY);
+  for (const Asset &a : _assets) {
+    fprintf(out, "  %-31s %-8s %8zu  %016llx\n", a.path.c_str(), encodingName[a.encoding], a.data.size(), (unsigned long long)hash(a.data));
+    total += a.data.size();
+  }
+  fprintf(out, "  %zu entries, %zu bytes (index %zu)\n", _assets.size(), total, _assets.size() * sizeof(WM_BUNDLE_ENTRY));
+}
@@ -0,0 +1,41 @@
+/**************************************************************
+   BundleWriter builds the packed asset bundle (AssetBundle.h) on
+   the host. Assets are added as logical path, encoding and bytes;
+   write() sorts them, fills the index and lays the payloads out
+   behind it. Same input, same bundle, byte for byte.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef BundleWriter_h
+#define BundleWriter_h
+#include "AssetBundle.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class BundleWriter {
+  public:
+    struct Asset {
+      std::string          path;      // logical path, "/gpio.html"
+      uint8_t              encoding;  // WM_BUNDLE_*
+      std::vector<uint8_t> data;
+      uint32_t             modified;
+    };
+
+    //false (with the reason in error()) when the path is too long or already added with this encoding
+    bool          add(const std::string &path, uint8_t encoding, const std::vector<uint8_t> &data, uint32_t modified = 0);
+    //logical path and encoding of a stored file name: "/a.js.gz" is "/a.js" gzip
+    static void   splitName(const std::string &name, std::string &path, uint8_t &encoding);
+    bool          write(const char *file);
+    //one line per asset and the totals
+    void          report(FILE *out) const;
+
+    const std::string& error() const { return _error; }
+    //FNV-1a 64, the hash the portal uses for ETags
+    static uint64_t hash(const std::vector<uint8_t> &data);
+
+  private:
+    std::vector<Asset> _assets;
+    std::string        _error;
+};
+#endif
@@ -0,0 +1,59 @@
+/**************************************************************
+   Compress - deterministic gzip (zlib) and brotli encoding
+   Licensed under MIT license
+ **************************************************************/
+
+#include "Compress.h"
+#include <string.h>
+#include <zlib.h>
+#ifdef WM_BROTLI
+#include <brotli/encode.h>
+#endif
+
+//raw deflate of in with one strategy, lazy matching and chains pushed to their limits
+static bool deflateWith(const std::vector<uint8_t> &in, int strategy, int windowBits, std::vector<uint8_t> &out) {
+  z_stream s;
+  memset(&s, 0, sizeof(s));
+  if (deflateInit2(&s, Z_BEST_COMPRESSION, Z_DEFLATED, -windowBits, 9, strategy) != Z_OK) return false;
+  deflateTune(&s, 258, 258, 258, 32768);
+  out.resize(deflateBound(&s, in.size()));
+  s.next_in = const_cast<Bytef*>(in.data());
+  s.avail_in = in.size();
+  s.next_out = out.data();
+  s.avail_out = out.size();
+  int rc = deflate(&s, Z_FINISH);
+  out.resize(s.total_out);
+  deflateEnd(&s);
+  return rc == Z_STREAM_END;
+}
+
+static void putLE32(std::vector<uint8_t> &out, uint32_t v) {
+  for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+bool gzipBest(const std::vector<uint8_t> &in, std::vector<uint8_t> &out, int windowBits) {
+  static const int strategies[] = { Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE };
+  std::vector<uint8_t> best, attempt;
+  for (int strategy : strategies) {
+    if (!deflateWith(in, strategy, windowBits, attempt)) return false;
+    if (best.empty() || attempt.size() < best.size()) best.swap(attempt);
+  }
+  // RFC 1952 member: no name, no mtime, XFL 2 (slowest), OS 255 (unknown)
+  static const uint8_t header[] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 2, 0xff };
+  out.assign(header, header + sizeof(header));
+  out.insert(out.end(), best.begin(), best.end());
+  putLE32(out, crc32(0, in.data(), in.size()));
+  putLE32(out, (uint32_t)in.size());
+  return true;
+}
+
+#ifdef WM_BROTLI
+bool brotliBest(const std::vector<uint8_t> &in, std::vector<uint8_t> &out) {
+  size_t size = BrotliEncoderMaxCompressedSize(in.size());
+  out.resize(size ? size : in.size() + 1024);
+  size = out.size();
+  if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, in.size(), in.data(), &size, out.data())) return false;
+  out.resize(size);
+  return true;
+}
+#endif
@@ -0,0 +1,21 @@
+/**************************************************************
+   Compress - gzip and brotli encoders of the host image builder.
+   The gzip member header is written here, not by zlib, so the
+   output carries no time stamp or host OS byte and the same input
+   gives the same bytes on every machine.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef Compress_h
+#define Compress_h
+#include <stdint.h>
+#include <vector>
+
+//smallest deflate zlib finds at full effort, over several strategies, wrapped as a gzip member.
+//windowBits (9..15) bounds the match distance for decoders with a smaller window
+bool gzipBest(const std::vector<uint8_t> &in, std::vector<uint8_t> &out, int windowBits = 15);
+#ifdef WM_BROTLI
+//brotli at quality 11, text mode
+bool brotliBest(const std::vector<uint8_t> &in, std::vector<uint8_t> &out);
+#endif
+#endif
@@ -0,0 +1,63 @@
+/**************************************************************
+   HostFS - file helpers of the host tools
+   Licensed under MIT license
+ **************************************************************/
+
+#include "HostFS.h"
+#include <algorithm>
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+bool readFile(const std::string &name, std::vector<uint8_t> &data) {
+  FILE *f = fopen(name.c_str(), "rb");
+  if (!f) return false;
+  uint8_t buf[4096];
+  size_t n;
+  data.clear();
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+
+static void makeParents(const std::string &name) {
+  for (size_t at = name.find('/', 1); at != std::string::npos; at = name.find('/', at + 1)) {
+#ifdef _WIN32
+    mkdir(name.substr(0, at).c_str());
+#else
+    mkdir(name.substr(0, at).c_str(), 0755);
+#endif
+  }
+}
+
+bool writeFile(const std::string &name, const std::vector<uint8_t> &data) {
+  makeParents(name);
+  FILE *f = fopen(name.c_str(), "wb");
+  if (!f) return false;
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  if (fclose(f) != 0) ok = false;
+  return ok;
+}
+
+static void listBelow(const std::string &root, const std::string &dir, std::vector<std::string> &out) {
+  DIR *d = opendir((root + dir).c_str());
+  if (!d) return;
+  while (struct dirent *e = readdir(d)) {
+    if (e->d_name[0] == '.') continue;
+    std::string rel = dir + "/" + e->d_name;
+    struct stat st;
+    if (stat((root + rel).c_str(), &st) != 0) continue;
+    if (S_ISDIR(st.st_mode)) listBelow(root, rel, out);
+    else if (S_ISREG(st.st_mode)) out.push_back(rel);
+  }
+  closedir(d);
+}
+
+std::vector<std::string> listFiles(const std::string &root) {
+  std::vector<std::string> out;
+  listBelow(root, "", out);
+  std::sort(out.begin(), out.end());
+  return out;
+}
@@ -0,0 +1,19 @@
+/**************************************************************
+   HostFS - the few file helpers the host tools share. Listings
+   come back sorted so every tool produces the same output on
+   every host, whatever order the directory is read in.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef HostFS_h
+#define HostFS_h
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+bool readFile(const std::string &name, std::vector<uint8_t> &data);
+//creates the missing parent folders of name first
+bool writeFile(const std::string &name, const std::vector<uint8_t> &data);
+//every regular file below root as "/relative/path", sorted, dot files skipped
+std::vector<std::string> listFiles(const std::string &root);
+#endif
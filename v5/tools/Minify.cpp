@@ -0,0 +1,130 @@
+/**************************************************************
+   Minify - conservative minifiers of the host image builder
+   Licensed under MIT license
+ **************************************************************/
+
+#include "Minify.h"
+#include <string.h>
+
+static bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool endsWith(const std::string &s, const char *suffix) {
+  size_t n = strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+//append line without its indentation and trailing blanks, nothing when it is empty
+static void appendTrimmed(std::string &out, const std::string &in, size_t from, size_t to) {
+  while (from < to && isBlank(in[from])) from++;
+  while (to > from && isBlank(in[to - 1])) to--;
+  if (from == to) return;
+  out.append(in, from, to - from);
+  out += '\n';
+}
+
+std::string minifyJs(const std::string &in) {
+  std::string out;
+  size_t start = 0;
+  while (start < in.size()) {
+    size_t end = in.find('\n', start);
+    if (end == std::string::npos) end = in.size();
+    appendTrimmed(out, in, start, end);
+    start = end + 1;
+  }
+  if (!out.empty() && in.back() != '\n') out.pop_back(); // no line break the source did not have
+  return out;
+}
+
+std::string minifyCss(const std::string &in) {
+  static const char tight[] = "{}:;,>";
+  std::string out;
+  size_t i = 0;
+  bool space = false;
+  while (i < in.size()) {
+    char c = in[i];
+    if (c == '/' && i + 1 < in.size() && in[i + 1] == '*') {
+      size_t end = in.find("*/", i + 2);
+      i = (end == std::string::npos) ? in.size() : end + 2;
+      continue;
+    }
+    if (isBlank(c)) {
+      space = true;
+      i++;
+      continue;
+    }
+    // one space between words, none next to punctuation
+    if (space && !out.empty() && !strchr(tight, out.back()) && !strchr(tight, c)) out += ' ';
+    space = false;
+    if (c == '"' || c == '\'') {
+      size_t end = i + 1;
+      while (end < in.size() && in[end] != c) end += (in[end] == '\\') ? 2 : 1;
+      end = (end < in.size()) ? end + 1 : in.size();
+      out.append(in, i, end - i);
+      i = end;
+      continue;
+    }
+    if (c == '}' && !out.empty() && out.back() == ';') out.pop_back();
+    out += c;
+    i++;
+  }
+  return out;
+}
+
+//index of the end of the element opened at i when it is one whose text must stay as written, else 0
+static size_t keptElementEnd(const std::string &in, size_t i) {
+  static const char* const kept[][2] = {{"<pre", "</pre>"}, {"<textarea", "</textarea>"}, {"<script", "</script>"}};
+  for (const auto &k : kept) {
+    if (strncasecmp(in.c_str() + i, k[0], strlen(k[0])) != 0) continue;
+    size_t end = in.find(k[1], i);
+    return (end == std::string::npos) ? in.size() : end + strlen(k[1]);
+  }
+  return 0;
+}
+
+std::string minifyHtml(const std::string &in) {
+  // comments first, but not inside scripts where "<!--" may be part of the code
+  std::string text;
+  size_t i = 0;
+  while (i < in.size()) {
+    if (in.compare(i, 4, "<!--") == 0 && in.compare(i, 5, "<!--[") != 0) {
+      size_t end = in.find("-->", i + 4);
+      i = (end == std::string::npos) ? in.size() : end + 3;
+      continue;
+    }
+    size_t end = (strncasecmp(in.c_str() + i, "<script", 7) == 0) ? keptElementEnd(in, i) : 0;
+    if (end == 0) end = i + 1;
+    text.append(in, i, end - i);
+    i = end;
+  }
+
+  // then indentation and blank lines; pre and textarea show their text as written
+  std::string out;
+  size_t line = 0;
+  i = 0;
+  while (i < text.size()) {
+    size_t end = (text[i] == '<' && strncasecmp(text.c_str() + i, "<script", 7) != 0) ? keptElementEnd(text, i) : 0;
+    if (end > 0) {
+      while (line < i && isBlank(text[line])) line++;
+      out.append(text, line, end - line);
+      i = line = end;
+      continue;
+    }
+    if (text[i] == '\n') {
+      appendTrimmed(out, text, line, i);
+      line = i + 1;
+    }
+    i++;
+  }
+  appendTrimmed(out, text, line, text.size());
+  if (!out.empty() && out.back() == '\n' && text.back() != '\n') out.pop_back();
+  return out;
+}
+
+std::string minifyByName(const std::string &name, const std::string &in) {
+  if (endsWith(name, ".html") || endsWith(name, ".htm")) return minifyHtml(in);
+  if (endsWith(name, ".css")) return minifyCss(in);
+  if (endsWith(name, ".js")) return minifyJs(in);
+  return in;
+}
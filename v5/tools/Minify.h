@@ -0,0 +1,20 @@
+/**************************************************************
+   Minify - conservative whitespace and comment stripping for the
+   web UI sources. Nothing is renamed or reordered, so the output
+   behaves exactly like the input; gzip takes care of the rest.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef Minify_h
+#define Minify_h
+#include <string>
+
+//indentation and blank lines, keeps every line break (automatic semicolon insertion depends on them)
+std::string minifyJs(const std::string &in);
+//comments and whitespace around punctuation, strings are kept whole
+std::string minifyCss(const std::string &in);
+//comments (conditional ones kept), indentation and blank lines; <pre> and <textarea> kept whole
+std::string minifyHtml(const std::string &in);
+//picks the minifier from the file name, other files come back unchanged
+std::string minifyByName(const std::string &name, const std::string &in);
+#endif
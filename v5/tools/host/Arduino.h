@@ -0,0 +1,202 @@
+/**************************************************************
+   Host stand-in for the part of the ESP8266 Arduino core the
+   portal sources use, so the benchmarks in tools/ build those
+   sources unchanged on the build machine. PROGMEM is plain
+   memory, millis()/micros() run on the host clock. String
+   follows the core's WString: every concatenation reallocates to
+   the exact new length, and its buffers are counted by the host
+   heap (hostHeapUsed/hostHeapPeak), which ESP.getFreeHeap()
+   reports against WM_HOST_HEAP bytes.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef Arduino_h
+#define Arduino_h
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <functional>
+
+#define WM_HOST_HEAP 40960 // free heap of a module running the portal
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define PROGMEM
+#define PGM_P                 const char *
+#define PSTR(s)               (s)
+#define pgm_read_byte(addr)   (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)   (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)  (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr)    (*(void *const *)(addr))
+#define strlen_P              strlen
+#define strcmp_P              strcmp
+#define strncmp_P             strncmp
+#define strcasecmp_P          strcasecmp
+#define strcpy_P              strcpy
+#define strncpy_P             strncpy
+#define memcpy_P              memcpy
+
+class __FlashStringHelper;
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper *>(p))
+#define F(s)     FPSTR(PSTR(s))
+
+#define DEC 10
+#define HEX 16
+
+unsigned long millis();
+unsigned long micros();
+void          delay(unsigned long ms);
+void          yield();
+
+//bytes held by String buffers (and hostMalloc) now and at most since the last reset,
+//and the allocations and reallocations made so far
+size_t        hostHeapUsed();
+size_t        hostHeapPeak();
+void          hostHeapResetPeak();
+uint32_t      hostHeapAllocs();
+void         *hostMalloc(size_t size);
+void         *hostRealloc(void *ptr, size_t size);
+void          hostFree(void *ptr);
+
+class EspClass {
+  public:
+    uint32_t      getFreeHeap() { return WM_HOST_HEAP - hostHeapUsed(); }
+    uint32_t      getChipId() { return 0x00C0FFEE; }
+    void          restart() { exit(0); }
+    void          reset() { exit(0); }
+};
+extern EspClass ESP;
+
+class String;
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t size);
+    size_t        write(const char *s) { return s ? write((const uint8_t *)s, strlen(s)) : 0; }
+    size_t        write(const char *buf, size_t size) { return write((const uint8_t *)buf, size); }
+
+    size_t        print(const __FlashStringHelper *s) { return write((const char *)s); }
+    size_t        print(const String &s);
+    size_t        print(const char *s) { return write(s); }
+    size_t        print(char c) { return write((uint8_t)c); }
+    size_t        print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t        print(int n, int base = DEC) { return print((long)n, base); }
+    size_t        print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t        print(long n, int base = DEC);
+    size_t        print(unsigned long n, int base = DEC);
+    size_t        print(double n, int digits = 2);
+
+    template <typename T>
+    size_t        println(T v) { size_t n = print(v); return n + println(); }
+    size_t        println() { return write("\r\n"); }
+    size_t        printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class String {
+  public:
+    String(const char *s = "");
+    String(const __FlashStringHelper *s) : String((const char *)s) {}
+    String(const String &s);
+    String(String &&s) : _buf(s._buf), _capacity(s._capacity), _len(s._len) { s._buf = NULL; s._capacity = s._len = 0; }
+    explicit String(char c);
+    explicit String(int n, unsigned char base = 10) : String((long)n, base) {}
+    explicit String(unsigned int n, unsigned char base = 10) : String((unsigned long)n, base) {}
+    explicit String(long n, unsigned char base = 10);
+    explicit String(unsigned long n, unsigned char base = 10);
+    explicit String(double n, unsigned char digits = 2);
+    ~String() { hostFree(_buf); }
+
+    String       &operator=(const String &s);
+    String       &operator=(String &&s);
+    String       &operator=(const char *s);
+
+    //grows the buffer to exactly size characters, as the core does
+    bool          reserve(size_t size);
+    size_t        length() const { return _len; }
+    const char   *c_str() const { return _buf ? _buf : ""; }
+
+    bool          concat(const char *s, size_t len);
+    bool          concat(const String &s) { return concat(s.c_str(), s._len); }
+    bool          concat(const char *s) { return s ? concat(s, strlen(s)) : false; }
+    bool          concat(const __FlashStringHelper *s) { return concat((const char *)s); }
+    bool          concat(char c) { return concat(&c, 1); }
+    bool          concat(int n) { return concat(String(n)); }
+    bool          concat(unsigned int n) { return concat(String(n)); }
+    bool          concat(long n) { return concat(String(n)); }
+    bool          concat(unsigned long n) { return concat(String(n)); }
+    template <typename T>
+    String       &operator+=(T v) { concat(v); return *this; }
+
+    bool          equals(const char *s) const { return strcmp(c_str(), s) == 0; }
+    bool          operator==(const String &s) const { return equals(s.c_str()); }
+    bool          operator==(const char *s) const { return equals(s); }
+    bool          operator!=(const String &s) const { return !equals(s.c_str()); }
+    bool          operator!=(const char *s) const { return !equals(s); }
+    bool          operator<(const String &s) const { return strcmp(c_str(), s.c_str()) < 0; }
+    char          operator[](size_t i) const { return i < _len ? _buf[i] : 0; }
+    char          charAt(size_t i) const { return (*this)[i]; }
+
+    bool          startsWith(const String &s) const { return s._len <= _len && strncmp(c_str(), s.c_str(), s._len) == 0; }
+    bool          endsWith(const String &s) const { return s._len <= _len && strcmp(c_str() + _len - s._len, s.c_str()) == 0; }
+    int           indexOf(char c, size_t from = 0) const;
+    int           indexOf(const String &s, size_t from = 0) const;
+    int           lastIndexOf(char c) const;
+    String        substring(size_t from, size_t to = (size_t)-1) const;
+    void          replace(const String &find, const String &with);
+    void          toLowerCase();
+    void          trim();
+    long          toInt() const { return atol(c_str()); }
+
+  private:
+    char         *_buf = NULL;
+    size_t        _capacity = 0;
+    size_t        _len = 0;
+};
+
+//a + b + c copies a once into a temporary that every further + grows in place, as in the core
+class StringSumHelper : public String {
+  public:
+    StringSumHelper(const String &s) : String(s) {}
+    StringSumHelper(const char *s) : String(s) {}
+};
+template <typename T>
+inline StringSumHelper &operator+(const StringSumHelper &sum, T v) {
+  StringSumHelper &s = const_cast<StringSumHelper &>(sum);
+  s.concat(v);
+  return s;
+}
+
+class IPAddress {
+  public:
+    IPAddress() { _addr.dword = 0; }
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { _addr.bytes[0] = a; _addr.bytes[1] = b; _addr.bytes[2] = c; _addr.bytes[3] = d; }
+    IPAddress(uint32_t address) { _addr.dword = address; }
+    operator uint32_t() const { return _addr.dword; }
+    uint8_t       operator[](int i) const { return _addr.bytes[i]; }
+    uint8_t      &operator[](int i) { return _addr.bytes[i]; }
+    bool          operator==(const IPAddress &ip) const { return _addr.dword == ip._addr.dword; }
+    bool          fromString(const char *address);
+    String        toString() const;
+
+  private:
+    union {
+      uint8_t       bytes[4];
+      uint32_t      dword;
+    } _addr;
+};
+
+class HardwareSerial : public Print {
+  public:
+    void          begin(unsigned long) {}
+    size_t        write(uint8_t c) override { return fputc(c, stderr) == EOF ? 0 : 1; }
+    size_t        write(const uint8_t *buf, size_t size) override { return fwrite(buf, 1, size, stderr); }
+    using Print::write;
+};
+extern HardwareSerial Serial;
+#endif
@@ -0,0 +1,110 @@
+/**************************************************************
+   Host stand-in for ESP8266WebServer of core 2.4: the same
+   request parsing (request line, query arguments, the collected
+   headers, read byte by byte with the same timeouts), routing,
+   send() and handleClient(), which serves one connection at a
+   time and keeps it until the client hangs up. Request bodies
+   and uploads are not read, the portal benchmarks only GET.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef ESP8266WebServer_h
+#define ESP8266WebServer_h
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <FS.h>
+#include <functional>
+#include <vector>
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+#define HTTP_MAX_DATA_WAIT  1000 // ms to wait for the request
+#define HTTP_MAX_SEND_WAIT  5000 // ms a write may wait for room
+#define HTTP_MAX_CLOSE_WAIT 2000 // ms to wait for the client to hang up
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
+#define CONTENT_LENGTH_NOT_SET ((size_t) -2)
+
+class ESP8266WebServer {
+  public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    ESP8266WebServer(int port) : _server(port) {}
+    virtual ~ESP8266WebServer();
+
+    void          begin() { _server.begin(); }
+    //host only, the port begin() ended up on
+    uint16_t      port() const { return _server.port(); }
+    void          handleClient();
+
+    void          on(const String &uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+    void          on(const String &uri, HTTPMethod method, THandlerFunction handler);
+    void          on(const String &uri, HTTPMethod method, THandlerFunction handler, THandlerFunction upload) { on(uri, method, handler); }
+    void          onNotFound(THandlerFunction handler) { _notFound = handler; }
+
+    String        uri() { return _currentUri; }
+    HTTPMethod    method() { return _currentMethod; }
+    WiFiClient    client() { return _currentClient; }
+    String        arg(const String &name);
+    int           args() { return _currentArgCount; }
+    bool          hasArg(const String &name);
+    void          collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+
+    void          sendHeader(const String &name, const String &value, bool first = false);
+    void          setContentLength(size_t contentLength) { _contentLength = contentLength; }
+    void          send(int code, const char *contentType = NULL, const String &content = String(""));
+    void          send(int code, const String &contentType, const String &content) { send(code, contentType.c_str(), content); }
+
+    //whole file as a 200 response, the write blocks until the client has taken it
+    template <typename T>
+    size_t        streamFile(T &file, const String &contentType) {
+      setContentLength(file.size());
+      send(200, contentType, "");
+      uint8_t buf[1460];
+      size_t sent = 0;
+      size_t n;
+      while ((n = file.read(buf, sizeof(buf))) > 0) {
+        size_t written = _currentClient.write(buf, n);
+        sent += written;
+        if (written != n) break;
+      }
+      return sent;
+    }
+
+  protected:
+    struct RequestArgument {
+      String        key;
+      String        value;
+    };
+    enum HTTPClientStatus { HC_NONE, HC_WAIT_READ, HC_WAIT_CLOSE };
+
+    bool          _parseRequest(WiFiClient &client);
+    void          _handleRequest();
+
+    WiFiServer    _server;
+    WiFiClient    _currentClient;
+    HTTPMethod    _currentMethod = HTTP_ANY;
+    String        _currentUri;
+    HTTPClientStatus _currentStatus = HC_NONE;
+    unsigned long _statusChange = 0;
+
+    int           _currentArgCount = 0;
+    RequestArgument *_currentArgs = NULL;
+    int           _headerKeysCount = 0;
+    RequestArgument *_currentHeaders = NULL;
+    size_t        _contentLength = CONTENT_LENGTH_NOT_SET;
+    String        _responseHeaders;
+
+  private:
+    struct Route {
+      String        uri;
+      HTTPMethod    method;
+      THandlerFunction handler;
+    };
+    std::vector<Route> _routes;
+    THandlerFunction _notFound;
+
+    bool          readLine(WiFiClient &client, String &line);
+    void          parseArguments(const String &query);
+};
+#endif
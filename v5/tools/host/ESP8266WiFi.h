@@ -0,0 +1,30 @@
+/**************************************************************
+   Host stand-in for the part of ESP8266WiFi the portal server
+   uses: WiFiClient and a WiFiServer listening on the loopback
+   interface, so a load generator on the build machine can talk
+   to the firmware's server code.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef ESP8266WiFi_h
+#define ESP8266WiFi_h
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+class WiFiServer {
+  public:
+    WiFiServer(uint16_t port) : _port(port) {}
+    ~WiFiServer() { close(); }
+
+    //port 0 picks a free one, see port()
+    void          begin();
+    //next waiting connection, an empty client when there is none
+    WiFiClient    available();
+    uint16_t      port() const { return _port; }
+    void          close();
+
+  private:
+    uint16_t      _port;
+    int           _fd = -1;
+};
+#endif
@@ -0,0 +1,116 @@
+/**************************************************************
+   Host stand-in for the SPIFFS file system of the core. Files live
+   in memory, and every write is charged the flash programming
+   SPIFFS would do for it, so the benchmarks can count flash
+   writes without a module:
+   - a data page holds WM_HOST_PAGE_SIZE - WM_HOST_PAGE_HEADER file
+     bytes; appending to a page that is not full programs the rest
+     of it in place, a new page is programmed with its header
+   - overwriting stored bytes moves the page: the whole page is
+     programmed again at a new place
+   - a write that changes the size (or moves a page), a truncating
+     open and a rename rewrite the object index header page
+   Every write() reaches flash at once, the core's page cache is
+   not modelled (the portal sources flush small writes anyway),
+   and neither are block erases: the file system starts out empty.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef FS_h
+#define FS_h
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define WM_HOST_PAGE_SIZE   256      // SPIFFS logical page of the core
+#define WM_HOST_PAGE_HEADER 5        // object id, span index and flags of a data page
+#define WM_HOST_BLOCK_SIZE  8192
+#define WM_HOST_FS_SIZE     1024000  // 4M (1M SPIFFS) flash layout
+
+//flash programming charged since the last hostFlashReset()
+struct HostFlashStats {
+  uint32_t      writes     = 0; // write() calls that reached flash
+  uint32_t      dataPages  = 0; // data page programs, in place appends included
+  uint32_t      indexPages = 0; // object index header rewrites
+  uint64_t      bytes      = 0; // bytes programmed, page headers and index pages included
+  uint32_t      pages() const { return dataPages + indexPages; }
+};
+const HostFlashStats &hostFlashStats();
+void          hostFlashReset();
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct FSInfo {
+  size_t        totalBytes;
+  size_t        usedBytes;
+  size_t        blockSize;
+  size_t        pageSize;
+  size_t        maxOpenFiles;
+  size_t        maxPathLength;
+};
+
+class File : public Print {
+  public:
+    File() {}
+
+    size_t        write(uint8_t c) override { return write(&c, 1); }
+    size_t        write(const uint8_t *buf, size_t size) override;
+    using Print::write;
+    int           read();
+    size_t        read(uint8_t *buf, size_t size);
+    int           peek();
+    int           available();
+    bool          seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t        position() const;
+    size_t        size() const;
+    void          flush() {}
+    void          close();
+    const char   *name() const;
+    operator bool() const { return _handle && _handle->open; }
+
+  private:
+    friend class FS;
+    struct Handle {
+      std::string   path;
+      size_t        pos    = 0;
+      bool          append = false;
+      bool          read   = false;
+      bool          write  = false;
+      bool          open   = true;
+    };
+    std::shared_ptr<Handle> _handle; // copies share the position, as the core's File does
+};
+
+class FS {
+  public:
+    bool          begin() { return true; }
+    void          end() {}
+    bool          format();
+    bool          info(FSInfo &info);
+    //modes "r", "w", "a", "r+", "w+", "a+" as fopen
+    File          open(const char *path, const char *mode);
+    File          open(const String &path, const char *mode) { return open(path.c_str(), mode); }
+    bool          exists(const char *path);
+    bool          exists(const String &path) { return exists(path.c_str()); }
+    bool          remove(const char *path);
+    bool          remove(const String &path) { return remove(path.c_str()); }
+    bool          rename(const char *from, const char *to);
+    bool          rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::FSInfo;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+extern fs::FS SPIFFS;
+#endif
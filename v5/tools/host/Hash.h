@@ -0,0 +1,11 @@
+/**************************************************************
+   Host stand-in for the core's Hash library, SHA-1 only
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef Hash_h
+#define Hash_h
+#include <stdint.h>
+
+void          sha1(const uint8_t *data, uint32_t size, uint8_t hash[20]);
+#endif
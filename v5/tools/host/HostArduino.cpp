@@ -0,0 +1,272 @@
+/**************************************************************
+   HostArduino - host side of Arduino.h: clock, heap accounting,
+   Print, String and IPAddress
+   Licensed under MIT license
+ **************************************************************/
+
+#include "Arduino.h"
+#include <chrono>
+#include <stdarg.h>
+#include <thread>
+
+EspClass ESP;
+HardwareSerial Serial;
+
+static const std::chrono::steady_clock::time_point hostStart = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - hostStart).count();
+}
+
+unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - hostStart).count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+}
+
+// every block carries its size in front, so free and realloc can keep the count
+static size_t heapUsed = 0;
+static size_t heapPeak = 0;
+static uint32_t heapAllocs = 0;
+
+size_t hostHeapUsed() { return heapUsed; }
+size_t hostHeapPeak() { return heapPeak; }
+void hostHeapResetPeak() { heapPeak = heapUsed; }
+uint32_t hostHeapAllocs() { return heapAllocs; }
+
+void *hostRealloc(void *ptr, size_t size) {
+  size_t old = 0;
+  size_t *block = NULL;
+  if (ptr) {
+    block = (size_t *)ptr - 1;
+    old = *block;
+  }
+  size_t *grown = (size_t *)realloc(block, sizeof(size_t) + size);
+  if (!grown) return NULL;
+  *grown = size;
+  heapAllocs++;
+  heapUsed = heapUsed - old + size;
+  if (heapUsed > heapPeak) heapPeak = heapUsed;
+  return grown + 1;
+}
+
+void *hostMalloc(size_t size) {
+  return hostRealloc(NULL, size);
+}
+
+void hostFree(void *ptr) {
+  if (!ptr) return;
+  size_t *block = (size_t *)ptr - 1;
+  heapUsed -= *block;
+  free(block);
+}
+
+size_t Print::write(const uint8_t *buf, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (!write(*buf++)) break;
+    n++;
+  }
+  return n;
+}
+
+size_t Print::print(const String &s) {
+  return write((const uint8_t *)s.c_str(), s.length());
+}
+
+size_t Print::print(long n, int base) {
+  if (base == DEC && n < 0) return print('-') + print((unsigned long)-n, base);
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  char buf[8 * sizeof(long) + 1];
+  char *p = buf + sizeof(buf) - 1;
+  *p = '\0';
+  if (base < 2) base = 10;
+  do {
+    uint8_t digit = n % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    n /= base;
+  } while (n);
+  return write(p);
+}
+
+size_t Print::print(double n, int digits) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return write(buf);
+}
+
+size_t Print::printf(const char *format, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (n < 0) return 0;
+  return write((const uint8_t *)buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+}
+
+String::String(const char *s) {
+  if (s) concat(s, strlen(s));
+}
+
+String::String(const String &s) {
+  concat(s.c_str(), s._len);
+}
+
+String::String(char c) {
+  concat(&c, 1);
+}
+
+String::String(long n, unsigned char base) {
+  char buf[2 + 8 * sizeof(long)];
+  if (base == 10) snprintf(buf, sizeof(buf), "%ld", n);
+  else snprintf(buf, sizeof(buf), base == 16 ? "%lx" : "%lo", (unsigned long)n);
+  concat(buf, strlen(buf));
+}
+
+String::String(unsigned long n, unsigned char base) {
+  char buf[1 + 8 * sizeof(long)];
+  snprintf(buf, sizeof(buf), base == 16 ? "%lx" : base == 8 ? "%lo" : "%lu", n);
+  concat(buf, strlen(buf));
+}
+
+String::String(double n, unsigned char digits) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  concat(buf, strlen(buf));
+}
+
+String &String::operator=(const String &s) {
+  if (this == &s) return *this;
+  _len = 0;
+  if (_buf) _buf[0] = '\0';
+  concat(s.c_str(), s._len);
+  return *this;
+}
+
+String &String::operator=(String &&s) {
+  if (this == &s) return *this;
+  hostFree(_buf);
+  _buf = s._buf;
+  _capacity = s._capacity;
+  _len = s._len;
+  s._buf = NULL;
+  s._capacity = s._len = 0;
+  return *this;
+}
+
+String &String::operator=(const char *s) {
+  _len = 0;
+  if (_buf) _buf[0] = '\0';
+  if (s) concat(s, strlen(s));
+  return *this;
+}
+
+bool String::reserve(size_t size) {
+  if (_buf && _capacity >= size) return true;
+  char *grown = (char *)hostRealloc(_buf, size + 1);
+  if (!grown) return false;
+  if (!_buf) grown[0] = '\0';
+  _buf = grown;
+  _capacity = size;
+  return true;
+}
+
+bool String::concat(const char *s, size_t len) {
+  if (!reserve(_len + len)) return false;
+  memmove(_buf + _len, s, len);
+  _len += len;
+  _buf[_len] = '\0';
+  return true;
+}
+
+int String::indexOf(char c, size_t from) const {
+  if (from >= _len) return -1;
+  const char *at = strchr(c_str() + from, c);
+  return at ? at - c_str() : -1;
+}
+
+int String::indexOf(const String &s, size_t from) const {
+  if (from > _len) return -1;
+  const char *at = strstr(c_str() + from, s.c_str());
+  return at ? at - c_str() : -1;
+}
+
+int String::lastIndexOf(char c) const {
+  const char *at = strrchr(c_str(), c);
+  return at ? at - c_str() : -1;
+}
+
+String String::substring(size_t from, size_t to) const {
+  if (to > _len) to = _len;
+  String s;
+  if (from < to) s.concat(c_str() + from, to - from);
+  return s;
+}
+
+void String::replace(const String &find, const String &with) {
+  if (find._len == 0) return;
+  String out;
+  size_t at = 0;
+  int hit;
+  while ((hit = indexOf(find, at)) >= 0) {
+    out.concat(c_str() + at, hit - at);
+    out.concat(with);
+    at = hit + find._len;
+  }
+  out.concat(c_str() + at, _len - at);
+  *this = static_cast<String &&>(out);
+}
+
+void String::toLowerCase() {
+  for (size_t i = 0; i < _len; i++) {
+    if (_buf[i] >= 'A' && _buf[i] <= 'Z') _buf[i] += 'a' - 'A';
+  }
+}
+
+void String::trim() {
+  size_t from = 0, to = _len;
+  while (from < to && (c_str()[from] == ' ' || c_str()[from] == '\t' || c_str()[from] == '\r' || c_str()[from] == '\n')) from++;
+  while (to > from && (c_str()[to - 1] == ' ' || c_str()[to - 1] == '\t' || c_str()[to - 1] == '\r' || c_str()[to - 1] == '\n')) to--;
+  if (from == 0 && to == _len) return;
+  *this = substring(from, to);
+}
+
+bool IPAddress::fromString(const char *address) {
+  uint8_t parts[4];
+  int part = 0;
+  unsigned value = 0;
+  bool digits = false;
+  for (const char *p = address;; p++) {
+    if (*p >= '0' && *p <= '9') {
+      value = value * 10 + (*p - '0');
+      if (value > 255) return false;
+      digits = true;
+    } else if (*p == '.' || *p == '\0') {
+      if (!digits || part > 3) return false;
+      parts[part++] = value;
+      value = 0;
+      digits = false;
+      if (*p == '\0') break;
+    } else {
+      return false;
+    }
+  }
+  if (part != 4) return false;
+  memcpy(_addr.bytes, parts, 4);
+  return true;
+}
+
+String IPAddress::toString() const {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _addr.bytes[0], _addr.bytes[1], _addr.bytes[2], _addr.bytes[3]);
+  return String(buf);
+}
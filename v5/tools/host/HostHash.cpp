@@ -0,0 +1,63 @@
+/**************************************************************
+   HostHash - SHA-1 (FIPS 180-4) for the host stand-ins
+   Licensed under MIT license
+ **************************************************************/
+
+#include "Hash.h"
+#include <string.h>
+
+static uint32_t rol(uint32_t v, int bits) {
+  return (v << bits) | (v >> (32 - bits));
+}
+
+static void sha1Block(uint32_t state[5], const uint8_t block[64]) {
+  uint32_t w[80];
+  for (int i = 0; i < 16; i++) {
+    w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+  }
+  for (int i = 16; i < 80; i++) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+  for (int i = 0; i < 80; i++) {
+    uint32_t f, k;
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+    uint32_t t = rol(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = rol(b, 30);
+    b = a;
+    a = t;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+}
+
+void sha1(const uint8_t *data, uint32_t size, uint8_t hash[20]) {
+  uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+  uint32_t done = 0;
+  for (; size - done >= 64; done += 64) sha1Block(state, data + done);
+  // the tail, 0x80 and the bit length, in one or two blocks
+  uint8_t last[128] = {};
+  uint32_t rest = size - done;
+  memcpy(last, data + done, rest);
+  last[rest] = 0x80;
+  uint32_t blocks = rest < 56 ? 1 : 2;
+  uint64_t bits = (uint64_t)size * 8;
+  for (int i = 0; i < 8; i++) last[blocks * 64 - 1 - i] = (uint8_t)(bits >> (i * 8));
+  for (uint32_t i = 0; i < blocks; i++) sha1Block(state, last + i * 64);
+  for (int i = 0; i < 20; i++) hash[i] = (uint8_t)(state[i / 4] >> (24 - (i % 4) * 8));
+}
@@ -0,0 +1,163 @@
+/**************************************************************
+   HostSpiffs - in memory SPIFFS with the flash programming model
+   described in FS.h
+   Licensed under MIT license
+ **************************************************************/
+
+#include "FS.h"
+
+fs::FS SPIFFS;
+
+static std::map<std::string, std::vector<uint8_t>> files;
+static HostFlashStats flash;
+
+static const size_t payload = WM_HOST_PAGE_SIZE - WM_HOST_PAGE_HEADER;
+
+const HostFlashStats &hostFlashStats() { return flash; }
+void hostFlashReset() { flash = HostFlashStats(); }
+
+static void programIndex() {
+  flash.indexPages++;
+  flash.bytes += WM_HOST_PAGE_SIZE;
+}
+
+//charge writing len bytes at pos of a file of size bytes
+static void programData(size_t pos, size_t len, size_t size) {
+  flash.writes++;
+  bool moved = false;
+  for (size_t page = pos / payload; page * payload < pos + len; page++) {
+    size_t from = page * payload > pos ? page * payload : pos;
+    size_t to = (page + 1) * payload < pos + len ? (page + 1) * payload : pos + len;
+    flash.dataPages++;
+    if (from < size) {
+      // stored bytes change, the page is rewritten elsewhere
+      flash.bytes += WM_HOST_PAGE_SIZE;
+      moved = true;
+    } else if (from > page * payload) {
+      flash.bytes += to - from; // rest of a partly filled page, programmed in place
+    } else {
+      flash.bytes += WM_HOST_PAGE_HEADER + (to - from);
+    }
+  }
+  if (moved || pos + len > size) programIndex();
+}
+
+namespace fs {
+
+size_t File::write(const uint8_t *buf, size_t size) {
+  if (!*this || !_handle->write || size == 0) return 0;
+  std::vector<uint8_t> &data = files[_handle->path];
+  if (_handle->append) _handle->pos = data.size();
+  if (_handle->pos > data.size()) return 0;
+  programData(_handle->pos, size, data.size());
+  if (_handle->pos + size > data.size()) data.resize(_handle->pos + size);
+  memcpy(data.data() + _handle->pos, buf, size);
+  _handle->pos += size;
+  return size;
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t *buf, size_t size) {
+  if (!*this || !_handle->read) return 0;
+  const std::vector<uint8_t> &data = files[_handle->path];
+  if (_handle->pos >= data.size()) return 0;
+  size_t n = data.size() - _handle->pos < size ? data.size() - _handle->pos : size;
+  memcpy(buf, data.data() + _handle->pos, n);
+  _handle->pos += n;
+  return n;
+}
+
+int File::peek() {
+  if (!*this || !_handle->read) return -1;
+  const std::vector<uint8_t> &data = files[_handle->path];
+  return _handle->pos < data.size() ? data[_handle->pos] : -1;
+}
+
+int File::available() {
+  if (!*this) return 0;
+  size_t n = files[_handle->path].size();
+  return n > _handle->pos ? n - _handle->pos : 0;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!*this) return false;
+  size_t n = files[_handle->path].size();
+  size_t at = mode == SeekSet ? pos : mode == SeekCur ? _handle->pos + pos : n + pos;
+  if (at > n) return false;
+  _handle->pos = at;
+  return true;
+}
+
+size_t File::position() const {
+  return *this ? _handle->pos : 0;
+}
+
+size_t File::size() const {
+  return *this ? files[_handle->path].size() : 0;
+}
+
+void File::close() {
+  if (_handle) _handle->open = false;
+}
+
+const char *File::name() const {
+  return _handle ? _handle->path.c_str() : "";
+}
+
+bool FS::format() {
+  files.clear();
+  return true;
+}
+
+bool FS::info(FSInfo &info) {
+  size_t used = 0;
+  for (auto &f : files) used += ((f.second.size() + payload - 1) / payload + 1) * WM_HOST_PAGE_SIZE;
+  info.totalBytes = WM_HOST_FS_SIZE;
+  info.usedBytes = used;
+  info.blockSize = WM_HOST_BLOCK_SIZE;
+  info.pageSize = WM_HOST_PAGE_SIZE;
+  info.maxOpenFiles = 5;
+  info.maxPathLength = 32;
+  return true;
+}
+
+File FS::open(const char *path, const char *mode) {
+  File f;
+  bool exists = files.count(path) != 0;
+  if (mode[0] == 'r' && !exists) return f;
+  f._handle = std::make_shared<File::Handle>();
+  f._handle->path = path;
+  f._handle->read = mode[0] == 'r' || mode[1] == '+';
+  f._handle->write = mode[0] != 'r' || mode[1] == '+';
+  f._handle->append = mode[0] == 'a';
+  if (mode[0] == 'w') {
+    if (exists && !files[path].empty()) programIndex(); // truncated, the old pages are deleted
+    files[path].clear();
+  } else if (!exists) {
+    files[path];
+  }
+  if (f._handle->append) f._handle->pos = files[path].size();
+  return f;
+}
+
+bool FS::exists(const char *path) {
+  return files.count(path) != 0;
+}
+
+bool FS::remove(const char *path) {
+  return files.erase(path) != 0;
+}
+
+bool FS::rename(const char *from, const char *to) {
+  if (!files.count(from) || files.count(to)) return false;
+  files[to].swap(files[from]);
+  files.erase(from);
+  programIndex();
+  return true;
+}
+
+} // namespace fs
@@ -0,0 +1,234 @@
+/**************************************************************
+   HostWebServer - ESP8266WebServer of the host stand-ins
+   Licensed under MIT license
+ **************************************************************/
+
+#include "ESP8266WebServer.h"
+
+ESP8266WebServer::~ESP8266WebServer() {
+  delete[] _currentArgs;
+  delete[] _currentHeaders;
+}
+
+void ESP8266WebServer::handleClient() {
+  if (_currentStatus == HC_NONE) {
+    WiFiClient client = _server.available();
+    if (!client) return;
+    _currentClient = client;
+    _currentStatus = HC_WAIT_READ;
+    _statusChange = millis();
+  }
+  bool keepCurrentClient = false;
+  if (_currentClient.connected()) {
+    if (_currentStatus == HC_WAIT_READ) {
+      if (_currentClient.available()) {
+        if (_parseRequest(_currentClient)) {
+          _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
+          _contentLength = CONTENT_LENGTH_NOT_SET;
+          _handleRequest();
+          if (_currentClient.connected()) {
+            _currentStatus = HC_WAIT_CLOSE;
+            _statusChange = millis();
+            keepCurrentClient = true;
+          }
+        }
+      } else if (millis() - _statusChange <= HTTP_MAX_DATA_WAIT) {
+        keepCurrentClient = true;
+      }
+    } else if (_currentStatus == HC_WAIT_CLOSE) {
+      // nothing else is accepted until this client hangs up
+      keepCurrentClient = millis() - _statusChange <= HTTP_MAX_CLOSE_WAIT;
+    }
+  }
+  if (!keepCurrentClient) {
+    _currentClient = WiFiClient();
+    _currentStatus = HC_NONE;
+  }
+}
+
+void ESP8266WebServer::on(const String &uri, HTTPMethod method, THandlerFunction handler) {
+  Route route;
+  route.uri = uri;
+  route.method = method;
+  route.handler = handler;
+  _routes.push_back(route);
+}
+
+String ESP8266WebServer::arg(const String &name) {
+  for (int i = 0; i < _currentArgCount; i++) {
+    if (_currentArgs[i].key == name) return _currentArgs[i].value;
+  }
+  return String();
+}
+
+bool ESP8266WebServer::hasArg(const String &name) {
+  for (int i = 0; i < _currentArgCount; i++) {
+    if (_currentArgs[i].key == name) return true;
+  }
+  return false;
+}
+
+void ESP8266WebServer::collectHeaders(const char *headerKeys[], const size_t headerKeysCount) {
+  delete[] _currentHeaders;
+  _headerKeysCount = headerKeysCount;
+  _currentHeaders = new RequestArgument[_headerKeysCount];
+  for (int i = 0; i < _headerKeysCount; i++) _currentHeaders[i].key = headerKeys[i];
+}
+
+void ESP8266WebServer::sendHeader(const String &name, const String &value, bool first) {
+  String line = name;
+  line += F(": ");
+  line += value;
+  line += F("\r\n");
+  if (first) {
+    line += _responseHeaders;
+    _responseHeaders = static_cast<String &&>(line);
+  } else {
+    _responseHeaders += line;
+  }
+}
+
+static const char *codeText(int code) {
+  switch (code) {
+    case 101: return "Switching Protocols";
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 206: return "Partial Content";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 416: return "Range Not Satisfiable";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+  }
+  return "";
+}
+
+void ESP8266WebServer::send(int code, const char *contentType, const String &content) {
+  String header = F("HTTP/1.1 ");
+  header += code;
+  header += ' ';
+  header += codeText(code);
+  header += F("\r\n");
+  if (contentType) {
+    header += F("Content-Type: ");
+    header += contentType;
+    header += F("\r\n");
+  }
+  size_t length = _contentLength == CONTENT_LENGTH_NOT_SET ? content.length() : _contentLength;
+  if (length != CONTENT_LENGTH_UNKNOWN) {
+    header += F("Content-Length: ");
+    header += (unsigned long)length;
+    header += F("\r\n");
+  }
+  header += _responseHeaders;
+  header += F("Connection: close\r\n\r\n");
+  _responseHeaders = String();
+  _currentClient.write((const uint8_t *)header.c_str(), header.length());
+  if (content.length()) _currentClient.write((const uint8_t *)content.c_str(), content.length());
+}
+
+//one line without its \r\n, false when the client went quiet first
+bool ESP8266WebServer::readLine(WiFiClient &client, String &line) {
+  line = String();
+  char c;
+  while (client.readBytes(&c, 1) == 1) {
+    if (c == '\n') {
+      if (line.length() && line[line.length() - 1] == '\r') line = line.substring(0, line.length() - 1);
+      return true;
+    }
+    line += c;
+  }
+  return false;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static String urlDecode(const char *s, size_t len) {
+  String out;
+  for (size_t i = 0; i < len; i++) {
+    if (s[i] == '+') {
+      out += ' ';
+    } else if (s[i] == '%' && i + 2 < len && hexValue(s[i + 1]) >= 0 && hexValue(s[i + 2]) >= 0) {
+      out += (char)(hexValue(s[i + 1]) << 4 | hexValue(s[i + 2]));
+      i += 2;
+    } else {
+      out += s[i];
+    }
+  }
+  return out;
+}
+
+void ESP8266WebServer::parseArguments(const String &query) {
+  delete[] _currentArgs;
+  _currentArgs = NULL;
+  _currentArgCount = 0;
+  if (query.length() == 0) return;
+  int count = 1;
+  for (size_t i = 0; i < query.length(); i++) {
+    if (query[i] == '&') count++;
+  }
+  _currentArgs = new RequestArgument[count];
+  const char *at = query.c_str();
+  while (*at) {
+    const char *end = at + strcspn(at, "&");
+    const char *equal = (const char *)memchr(at, '=', end - at);
+    if (end > at) {
+      RequestArgument &arg = _currentArgs[_currentArgCount++];
+      arg.key = urlDecode(at, (equal ? equal : end) - at);
+      if (equal) arg.value = urlDecode(equal + 1, end - equal - 1);
+    }
+    at = *end ? end + 1 : end;
+  }
+}
+
+bool ESP8266WebServer::_parseRequest(WiFiClient &client) {
+  String line;
+  if (!readLine(client, line)) return false;
+  int methodEnd = line.indexOf(' ');
+  int urlEnd = line.indexOf(' ', methodEnd + 1);
+  if (methodEnd < 0 || urlEnd < 0) return false;
+  String method = line.substring(0, methodEnd);
+  String url = line.substring(methodEnd + 1, urlEnd);
+  _currentMethod = method == "GET" ? HTTP_GET : method == "POST" ? HTTP_POST : method == "PUT" ? HTTP_PUT
+                 : method == "PATCH" ? HTTP_PATCH : method == "DELETE" ? HTTP_DELETE
+                 : method == "OPTIONS" ? HTTP_OPTIONS : HTTP_ANY;
+  int query = url.indexOf('?');
+  _currentUri = query < 0 ? url : url.substring(0, query);
+  parseArguments(query < 0 ? String() : url.substring(query + 1));
+
+  for (int i = 0; i < _headerKeysCount; i++) _currentHeaders[i].value = String();
+  while (readLine(client, line)) {
+    if (line.length() == 0) return true;
+    int colon = line.indexOf(':');
+    if (colon < 0) continue;
+    String name = line.substring(0, colon);
+    for (int i = 0; i < _headerKeysCount; i++) {
+      if (strcasecmp(_currentHeaders[i].key.c_str(), name.c_str()) != 0) continue;
+      _currentHeaders[i].value = line.substring(colon + 1);
+      _currentHeaders[i].value.trim();
+    }
+  }
+  return false;
+}
+
+void ESP8266WebServer::_handleRequest() {
+  for (size_t i = 0; i < _routes.size(); i++) {
+    Route &route = _routes[i];
+    if (route.uri != _currentUri) continue;
+    if (route.method != HTTP_ANY && route.method != _currentMethod) continue;
+    route.handler();
+    return;
+  }
+  if (_notFound) {
+    _notFound();
+  } else {
+    send(404, "text/plain", String("Not found: ") + _currentUri);
+  }
+}
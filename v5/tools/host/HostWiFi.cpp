@@ -0,0 +1,158 @@
+/**************************************************************
+   HostWiFi - WiFiClient and WiFiServer of the host stand-ins on
+   POSIX descriptors
+   Licensed under MIT license
+ **************************************************************/
+
+#include "ESP8266WiFi.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClient::WiFiClient(int fd) : _fd(std::make_shared<Descriptor>(fd)) {
+}
+
+WiFiClient::Descriptor::~Descriptor() {
+  if (fd >= 0) close(fd);
+}
+
+//waits up to ms for events on fd, false on timeout
+static bool waitFor(int fd, short events, unsigned long ms) {
+  pollfd p = { fd, events, 0 };
+  int n;
+  while ((n = poll(&p, 1, (int)ms)) < 0 && errno == EINTR) {}
+  return n > 0;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size) {
+  if (!*this) return 0;
+  size_t sent = 0;
+  unsigned long started = millis();
+  while (sent < size) {
+    ssize_t n = ::send(_fd->fd, buf + sent, size - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == ENOTSOCK) n = ::write(_fd->fd, buf + sent, size - sent);
+    if (n > 0) {
+      sent += n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    // a full socket is waited on for the timeout, like the core waits for acks
+    if (n < 0 && errno == EAGAIN && millis() - started < _timeout
+        && waitFor(_fd->fd, POLLOUT, _timeout - (millis() - started))) continue;
+    break;
+  }
+  return sent;
+}
+
+size_t WiFiClient::availableForWrite() {
+  if (!*this) return 0;
+  int queued = 0;
+  if (ioctl(_fd->fd, SIOCOUTQ, &queued) < 0) return WM_HOST_SND_BUF;
+  if (queued >= WM_HOST_SND_BUF) return 0;
+  // the kernel buffer may be full before the modelled one is
+  if (!waitFor(_fd->fd, POLLOUT, 0)) return 0;
+  return WM_HOST_SND_BUF - queued;
+}
+
+int WiFiClient::available() {
+  if (!*this) return 0;
+  int n = 0;
+  if (ioctl(_fd->fd, FIONREAD, &n) < 0) return 0;
+  return n;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t size) {
+  if (!*this) return -1;
+  ssize_t n = recv(_fd->fd, buf, size, MSG_DONTWAIT);
+  return n > 0 ? (int)n : -1;
+}
+
+size_t WiFiClient::readBytes(char *buf, size_t size) {
+  size_t got = 0;
+  unsigned long started = millis();
+  while (got < size && *this) {
+    int n = read((uint8_t *)buf + got, size - got);
+    if (n > 0) {
+      got += n;
+      continue;
+    }
+    unsigned long waited = millis() - started;
+    if (waited >= _timeout || !waitFor(_fd->fd, POLLIN, _timeout - waited)) break;
+  }
+  return got;
+}
+
+size_t WiFiClient::peekBytes(uint8_t *buf, size_t size) {
+  if (!*this) return 0;
+  ssize_t n = recv(_fd->fd, buf, size, MSG_PEEK | MSG_DONTWAIT);
+  return n > 0 ? n : 0;
+}
+
+void WiFiClient::setNoDelay(bool noDelay) {
+  if (!*this) return;
+  int on = noDelay ? 1 : 0;
+  setsockopt(_fd->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+//like the core, a connection with unread data still counts as connected
+uint8_t WiFiClient::connected() {
+  if (!*this) return 0;
+  uint8_t c;
+  ssize_t n = recv(_fd->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (n > 0) return 1;
+  if (n < 0 && (errno == EAGAIN || errno == EINTR)) return 1;
+  if (n < 0 && errno == ENOTSOCK) return 1;
+  return 0;
+}
+
+void WiFiClient::stop() {
+  if (!*this) return;
+  close(_fd->fd);
+  _fd->fd = -1;
+}
+
+void WiFiServer::begin() {
+  close();
+  _fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (_fd < 0) return;
+  int on = 1;
+  setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(_port);
+  socklen_t len = sizeof(addr);
+  if (bind(_fd, (sockaddr *)&addr, len) < 0 || listen(_fd, 16) < 0
+      || getsockname(_fd, (sockaddr *)&addr, &len) < 0) {
+    close();
+    return;
+  }
+  _port = ntohs(addr.sin_port);
+}
+
+WiFiClient WiFiServer::available() {
+  if (_fd < 0) return WiFiClient();
+  int fd = accept4(_fd, NULL, NULL, SOCK_NONBLOCK);
+  if (fd < 0) return WiFiClient();
+  // keep the kernel buffer near the module's, so a slow reader pushes back as early
+  int size = WM_HOST_SND_BUF;
+  setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  return WiFiClient(fd);
+}
+
+void WiFiServer::close() {
+  if (_fd >= 0) ::close(_fd);
+  _fd = -1;
+}
@@ -0,0 +1,53 @@
+/**************************************************************
+   Host stand-in for the core's WiFiClient over a file descriptor
+   (a socket, or /dev/null for a benchmark that only needs a sink).
+   Copies share the descriptor like copies of the core's client
+   share their connection; the last copy (or stop()) closes it.
+   On a socket, availableForWrite() is the free part of the send
+   buffer, at most WM_HOST_SND_BUF like lwIP's TCP_SND_BUF, and
+   write() blocks until everything is queued, as the core does.
+   Licensed under MIT license
+ **************************************************************/
+
+#ifndef WiFiClient_h
+#define WiFiClient_h
+#include <Arduino.h>
+#include <memory>
+
+#define WM_HOST_SND_BUF 2920 // lwIP TCP_SND_BUF of the core, 2 * TCP_MSS
+
+class WiFiClient : public Print {
+  public:
+    WiFiClient() {}
+    //takes over fd
+    explicit WiFiClient(int fd);
+
+    size_t        write(uint8_t c) override { return write(&c, 1); }
+    size_t        write(const uint8_t *buf, size_t size) override;
+    using Print::write;
+    size_t        write_P(PGM_P buf, size_t size) { return write((const uint8_t *)buf, size); }
+    size_t        availableForWrite();
+    int           available();
+    int           read();
+    int           read(uint8_t *buf, size_t size);
+    //waits up to the timeout for size bytes, returns what arrived
+    size_t        readBytes(char *buf, size_t size);
+    size_t        readBytes(uint8_t *buf, size_t size) { return readBytes((char *)buf, size); }
+    //what has arrived so far, left in the socket
+    size_t        peekBytes(uint8_t *buf, size_t size);
+    void          setTimeout(unsigned long ms) { _timeout = ms; }
+    void          setNoDelay(bool noDelay);
+    uint8_t       connected();
+    void          stop();
+    operator bool() const { return _fd && _fd->fd >= 0; }
+
+  private:
+    struct Descriptor {
+      int           fd;
+      explicit Descriptor(int f) : fd(f) {}
+      ~Descriptor();
+    };
+    std::shared_ptr<Descriptor> _fd;
+    unsigned long _timeout = 1000;
+};
+#endif
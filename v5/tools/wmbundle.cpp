@@ -0,0 +1,49 @@
+/**************************************************************
+   wmbundle - packs a built data/ folder into the asset bundle the
+   portal serves from (/assets.bin, layout in AssetBundle.h).
+
+   Build: make -C tools wmbundle
+   Usage: wmbundle <data dir> <bundle file>
+   Files are taken as they are, "x.gz" and "x.br" become the gzip and
+   brotli variants of "/x". wmimage -b builds the bundle straight from
+   html/, this is for a data/ folder put together by hand.
+   Licensed under MIT license
+ **************************************************************/
+
+#include "BundleWriter.h"
+#include "HostFS.h"
+#include <stdio.h>
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: wmbundle <data dir> <bundle file>\n");
+    return 2;
+  }
+  std::string root = argv[1];
+  std::vector<std::string> files = listFiles(root);
+
+  BundleWriter bundle;
+  std::string bundleName = std::string(WM_BUNDLE_FILE);
+  for (const std::string &rel : files) {
+    if (rel == bundleName || rel == "/etags.txt") continue; // an earlier bundle, the loose file ETag manifest
+    std::vector<uint8_t> data;
+    if (!readFile(root + rel, data)) {
+      fprintf(stderr, "%s%s: read failed\n", root.c_str(), rel.c_str());
+      return 1;
+    }
+    std::string path;
+    uint8_t encoding;
+    BundleWriter::splitName(rel, path, encoding);
+    if (!bundle.add(path, encoding, data)) {
+      fprintf(stderr, "%s\n", bundle.error().c_str());
+      return 1;
+    }
+  }
+  if (!bundle.write(argv[2])) {
+    fprintf(stderr, "%s\n", bundle.error().c_str());
+    return 1;
+  }
+  printf("%s:\n", argv[2]);
+  bundle.report(stdout);
+  return 0;
+}
@@ -0,0 +1,92 @@
+/**************************************************************
+   wmconfig - host side encoder/decoder for the portal config record
+   (/config.bin on SPIFFS, layout in ConfigRecord.h).
+
+   Build: make -C tools wmconfig
+   Usage: wmconfig encode <file> <ssid> <password> [<ip> <netmask> <gateway>]
+          wmconfig decode <file>
+   Put an encoded file in the sketch data/ folder as config.bin to ship
+   a module with credentials already set.
+   Licensed under MIT license
+ **************************************************************/
+
+#include "ConfigRecord.h"
+#include <stdio.h>
+#include <string.h>
+
+static bool parseIP(const char *text, uint8_t *out) {
+  unsigned a, b, c, d;
+  char tail;
+  if (sscanf(text, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4) return false;
+  if (a > 255 || b > 255 || c > 255 || d > 255) return false;
+  out[0] = a; out[1] = b; out[2] = c; out[3] = d;
+  return true;
+}
+
+static int usage() {
+  fprintf(stderr, "usage: wmconfig encode <file> <ssid> <password> [<ip> <netmask> <gateway>]\n"
+                  "       wmconfig decode <file>\n");
+  return 2;
+}
+
+static int encode(int argc, char **argv) {
+  if (argc != 5 && argc != 8) return usage();
+  WM_CONFIG cfg;
+  if (strlen(argv[3]) > WM_CONFIG_SSID_MAX || strlen(argv[4]) > WM_CONFIG_PASS_MAX) {
+    fprintf(stderr, "ssid is limited to %d bytes, password to %d\n", WM_CONFIG_SSID_MAX, WM_CONFIG_PASS_MAX);
+    return 1;
+  }
+  strcpy(cfg.ssid, argv[3]);
+  strcpy(cfg.pass, argv[4]);
+  if (argc == 8) {
+    if (!parseIP(argv[5], cfg.ip) || !parseIP(argv[6], cfg.netmask) || !parseIP(argv[7], cfg.gateway)) {
+      fprintf(stderr, "addresses must be dotted quads\n");
+      return 1;
+    }
+    cfg.flags |= WM_CONFIG_STATIC_IP;
+  }
+  uint8_t buf[WM_CONFIG_SIZE];
+  encodeConfig(cfg, buf);
+  FILE *f = fopen(argv[2], "wb");
+  if (!f || fwrite(buf, 1, sizeof(buf), f) != sizeof(buf)) {
+    perror(argv[2]);
+    if (f) fclose(f);
+    return 1;
+  }
+  fclose(f);
+  return 0;
+}
+
+static int decode(int argc, char **argv) {
+  if (argc != 3) return usage();
+  FILE *f = fopen(argv[2], "rb");
+  if (!f) {
+    perror(argv[2]);
+    return 1;
+  }
+  uint8_t buf[WM_CONFIG_SIZE];
+  size_t len = fread(buf, 1, sizeof(buf), f);
+  fclose(f);
+  WM_CONFIG cfg;
+  WM_CONFIG_RESULT res = decodeConfig(buf, len, cfg);
+  if (res != WM_CONFIG_OK) {
+    fprintf(stderr, "%s: %s\n", argv[2], configResultText(res));
+    return 1;
+  }
+  printf("ssid:     %s\npassword: %s\n", cfg.ssid, cfg.pass);
+  if (cfg.flags & WM_CONFIG_STATIC_IP) {
+    printf("ip:       %u.%u.%u.%u\n", cfg.ip[0], cfg.ip[1], cfg.ip[2], cfg.ip[3]);
+    printf("netmask:  %u.%u.%u.%u\n", cfg.netmask[0], cfg.netmask[1], cfg.netmask[2], cfg.netmask[3]);
+    printf("gateway:  %u.%u.%u.%u\n", cfg.gateway[0], cfg.gateway[1], cfg.gateway[2], cfg.gateway[3]);
+  } else {
+    printf("ip:       dhcp\n");
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) return usage();
+  if (strcmp(argv[1], "encode") == 0) return encode(argc, argv);
+  if (strcmp(argv[1], "decode") == 0) return decode(argc, argv);
+  return usage();
+}
@@ -0,0 +1,159 @@
+/**************************************************************
+   wmimage - builds the SPIFFS content of the portal from html/:
+   every asset is minified, text assets are gzip (and brotli)
+   compressed, and the ETag of every stored file is precomputed.
+   The output is the data/ tree (with the etags.txt manifest the
+   portal reads), the packed asset bundle, or both, followed by a
+   size report. Files are processed in sorted order and the gzip
+   header carries no time stamp, so a rebuild of the same sources
+   is byte for byte identical.
+
+   Build: make -C tools wmimage      (BROTLI=0 when libbrotlienc is missing)
+   Usage: wmimage [-n] [-o <data dir>] [-b <bundle file>] <html dir>
+          -n  copy sources without minifying
+          -o  write the data/ tree, the default when -b is not given is data
+          -b  write the packed bundle (AssetBundle.h)
+   Licensed under MIT license
+ **************************************************************/
+
+#include "BundleWriter.h"
+#include "Compress.h"
+#include "HostFS.h"
+#include "Minify.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#define ETAG_MANIFEST "/etags.txt" // as WM_ETAG_FILE in WiFiManager.h
+#define SPIFFS_NAME_MAX 31         // longest SPIFFS object name
+
+struct Output {
+  std::string          name; // stored file name, "/gpio.html.gz"
+  std::vector<uint8_t> data;
+};
+
+static bool hasExtension(const std::string &name, const char *const *list) {
+  size_t dot = name.rfind('.');
+  if (dot == std::string::npos) return false;
+  for (; *list; list++) {
+    if (strcasecmp(name.c_str() + dot + 1, *list) == 0) return true;
+  }
+  return false;
+}
+
+//what the gulp pipeline compressed; images and web fonts are stored as they are
+static const char* const compressed[] = { "html", "htm", "css", "js", "json", "svg", "txt", "xml", "eot", "otf", NULL };
+static const char* const minified[]   = { "html", "htm", "css", "js", NULL };
+
+static int usage() {
+  fprintf(stderr, "usage: wmimage [-n] [-o <data dir>] [-b <bundle file>] <html dir>\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  const char *dataDir = NULL, *bundleFile = NULL, *htmlDir = NULL;
+  bool minify = true;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0) minify = false;
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) dataDir = argv[++i];
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) bundleFile = argv[++i];
+    else if (argv[i][0] != '-' && !htmlDir) htmlDir = argv[i];
+    else return usage();
+  }
+  if (!htmlDir) return usage();
+  if (!dataDir && !bundleFile) dataDir = "data";
+
+  auto started = std::chrono::steady_clock::now();
+  std::vector<std::string> sources = listFiles(htmlDir);
+  if (sources.empty()) {
+    fprintf(stderr, "%s: no files\n", htmlDir);
+    return 1;
+  }
+
+  BundleWriter bundle;
+  std::string manifest;
+  size_t totalSource = 0, totalStored = 0;
+  printf("  %-31s %9s %9s %9s %9s\n", "asset", "source", "minified", "gzip", "br");
+  for (const std::string &rel : sources) {
+    std::vector<uint8_t> source;
+    if (!readFile(htmlDir + rel, source)) {
+      fprintf(stderr, "%s%s: read failed\n", htmlDir, rel.c_str());
+      return 1;
+    }
+    std::vector<uint8_t> plain = source;
+    if (minify && hasExtension(rel, minified)) {
+      std::string text = minifyByName(rel, std::string(source.begin(), source.end()));
+      plain.assign(text.begin(), text.end());
+    }
+
+    std::vector<Output> outputs;
+    long gzSize = -1, brSize = -1;
+    if (hasExtension(rel, compressed)) {
+      Output gz{rel + ".gz", {}};
+      if (!gzipBest(plain, gz.data)) {
+        fprintf(stderr, "%s: gzip failed\n", rel.c_str());
+        return 1;
+      }
+      gzSize = gz.data.size();
+      outputs.push_back(gz);
+#ifdef WM_BROTLI
+      Output br{rel + ".br", {}};
+      if (!brotliBest(plain, br.data)) {
+        fprintf(stderr, "%s: brotli failed\n", rel.c_str());
+        return 1;
+      }
+      brSize = br.data.size();
+      outputs.push_back(br);
+#endif
+    } else {
+      outputs.push_back(Output{rel, plain});
+    }
+
+    printf("  %-31s %9zu %9zu ", rel.c_str(), source.size(), plain.size());
+    if (gzSize >= 0) printf("%9ld ", gzSize); else printf("%9s ", "-");
+    if (brSize >= 0) printf("%9ld\n", brSize); else printf("%9s\n", "-");
+    totalSource += source.size();
+
+    for (const Output &o : outputs) {
+      if (o.name.size() > SPIFFS_NAME_MAX) {
+        fprintf(stderr, "%s: longer than the %d characters SPIFFS allows\n", o.name.c_str(), SPIFFS_NAME_MAX);
+        return 1;
+      }
+      totalStored += o.data.size();
+      if (dataDir) {
+        if (!writeFile(dataDir + o.name, o.data)) {
+          fprintf(stderr, "%s%s: write failed\n", dataDir, o.name.c_str());
+          return 1;
+        }
+        char line[80];
+        snprintf(line, sizeof(line), "%s %016llx 0\n", o.name.c_str(), (unsigned long long)BundleWriter::hash(o.data));
+        manifest += line;
+      }
+      if (bundleFile) {
+        std::string path;
+        uint8_t encoding;
+        BundleWriter::splitName(o.name, path, encoding);
+        if (!bundle.add(path, encoding, o.data)) {
+          fprintf(stderr, "%s\n", bundle.error().c_str());
+          return 1;
+        }
+      }
+    }
+  }
+
+  if (dataDir && !writeFile(dataDir + std::string(ETAG_MANIFEST), std::vector<uint8_t>(manifest.begin(), manifest.end()))) {
+    fprintf(stderr, "%s%s: write failed\n", dataDir, ETAG_MANIFEST);
+    return 1;
+  }
+  if (bundleFile) {
+    if (!bundle.write(bundleFile)) {
+      fprintf(stderr, "%s\n", bundle.error().c_str());
+      return 1;
+    }
+    printf("%s:\n", bundleFile);
+    bundle.report(stdout);
+  }
+  long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+  printf("  %zu sources, %zu bytes -> %zu bytes stored, %ld ms\n", sources.size(), totalSource, totalStored, ms);
+  return 0;
+}
@@ -0,0 +1,371 @@
+/**************************************************************
+   wmjsonbench - the JSON endpoints before and after JsonWriter.
+   Each endpoint is built twice from the same sample state: the
+   way the handler did it before (String concatenation and
+   ESP8266WebServer::send, which adds a header String of its own;
+   the scan list through PageTemplate), and the way it does now
+   (JsonWriter into ChunkedPrint). JsonWriter, ChunkedPrint and
+   PageTemplate are the firmware sources, String grows like the
+   core's (host/Arduino.h). The responses go to a client that is
+   not connected, so the time is spent building them and not in
+   a socket. For each endpoint it reports the body size, the heap
+   high-water mark and heap allocations per response, and body
+   bytes per second on the host, which only ranks the two paths;
+   the module is a lot slower than the build machine.
+
+   Build: make -C tools wmjsonbench
+   Usage: wmjsonbench [-n <responses>] [-a <access points>] [-f <files>]
+          defaults 20000 responses per endpoint, 20 access points, 30 files
+   Licensed under MIT license
+ **************************************************************/
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include "ChunkedPrint.h"
+#include "JsonWriter.h"
+#include "PageTemplate.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+// the scan list item of the firmware before JsonWriter
+constexpr char JSON_ITEM[] PROGMEM = "{\"SSID\":\"{v}\", \"Encryption\":{i}, \"Quality\":\"{r}\", \"Age\":{a}}";
+WM_TEMPLATE(TPL_JSON_ITEM, JSON_ITEM);
+
+struct ScanEntry {
+  char          ssid[33];
+  int           quality;
+  bool          encrypted;
+  unsigned long age;
+};
+
+struct Gpio {
+  uint8_t       pin;
+  String        status;
+  String        alias;
+};
+
+//what the handlers read from WiFi, the scan cache, the GPIO table, the clock and SPIFFS
+struct Sample {
+  IPAddress     apIP = IPAddress(192, 168, 4, 1);
+  IPAddress     ip = IPAddress(192, 168, 1, 57);
+  IPAddress     netmask = IPAddress(255, 255, 255, 0);
+  IPAddress     gateway = IPAddress(192, 168, 1, 1);
+  String        apMac = "5E:CF:7F:80:21:3A";
+  String        mac = "5C:CF:7F:80:21:3A";
+  String        ssid = "Home Network 2.4G";
+  String        psk = "correct horse battery";
+  std::vector<ScanEntry> scan;
+  std::vector<Gpio> gpio;
+  std::vector<String> files;
+  int           date[6] = { 17, 10, 2026, 21, 45, 3 };
+};
+
+//ESP8266WebServer::send(code, type, content) of the core: a header String, then the content
+static size_t serverSend(WiFiClient &client, String &extraHeaders, int code, const char *type, const String &content) {
+  String response = String(F("HTTP/1.1 ")) + String(code) + ' ' + (code == 200 ? "OK" : "") + "\r\n";
+  response += String(F("Content-Type: ")) + type + "\r\n";
+  response += String(F("Content-Length: ")) + String((unsigned long)content.length()) + "\r\n";
+  response += extraHeaders;
+  response += F("Connection: close\r\n\r\n");
+  extraHeaders = String();
+  client.write((const uint8_t *)response.c_str(), response.length());
+  client.write((const uint8_t *)content.c_str(), content.length());
+  return content.length();
+}
+
+static void sendHeader(String &headers, const char *name, const char *value) {
+  headers += String(name) + F(": ") + value + "\r\n";
+}
+
+//---- before: the handlers as they were
+
+static size_t oldState(WiFiClient &client, Sample &s) {
+  String headers;
+  sendHeader(headers, "Cache-Control", "no-cache, no-store, must-revalidate");
+  sendHeader(headers, "Pragma", "no-cache");
+  sendHeader(headers, "Expires", "-1");
+  String page = F("{\"Soft_AP_IP\":\"");
+  page += s.apIP.toString();
+  page += F("\",\"Soft_AP_MAC\":\"");
+  page += s.apMac;
+  page += F("\",\"Station_IP\":\"");
+  page += s.ip.toString();
+  page += F("\",\"Station_MAC\":\"");
+  page += s.mac;
+  page += F("\",");
+  if (s.psk != "") page += F("\"Password\":true,");
+  else page += F("\"Password\":false,");
+  page += F("\"SSID\":\"");
+  page += s.ssid;
+  page += F("\"}");
+  return serverSend(client, headers, 200, "application/json", page);
+}
+
+static size_t oldScan(WiFiClient &client, Sample &s) {
+  ChunkedPrint page(client);
+  page.begin(200, "application/json");
+  bool first = true;
+  page.print(F("{\"Access_Points\":["));
+  for (const ScanEntry &ap : s.scan) {
+    if (!first) page.print(F(", "));
+    first = false;
+    char rssiQ[5], age[11];
+    snprintf(rssiQ, sizeof(rssiQ), "%d", ap.quality);
+    snprintf(age, sizeof(age), "%lu", ap.age);
+    renderTemplate(page, TPL_JSON_ITEM, {{'v', ap.ssid}, {'r', rssiQ}, {'a', age}, {'i', ap.encrypted ? "true" : "false"}});
+  }
+  page.print(F("]}"));
+  page.end();
+  return page.bytesSent();
+}
+
+static size_t oldGPIOStatus(WiFiClient &client, Sample &s) {
+  String headers;
+  std::vector<Gpio> &g = s.gpio;
+  String json = "{\"GPIO0\":{\"Status\":\"" + g[0].status + F("\",\"Alias\":\"") + g[0].alias
+    + F("\"},\"GPIO2\":{\"Status\":\"") + g[1].status + F("\",\"Alias\":\"") + g[1].alias
+    + F("\"},\"GPIO5\":{\"Status\":\"") + g[2].status + F("\",\"Alias\":\"") + g[2].alias
+    + F("\"},\"GPIO12\":{\"Status\":\"") + g[3].status + F("\",\"Alias\":\"") + g[3].alias
+    + F("\"},\"GPIO14\":{\"Status\":\"") + g[4].status + F("\",\"Alias\":\"") + g[4].alias
+    + F("\"},\"GPIO15\":{\"Status\":\"") + g[5].status + F("\",\"Alias\":\"") + g[5].alias
+    + F("\"},\"GPIO16\":{\"Status\":\"") + g[6].status + F("\",\"Alias\":\"") + g[6].alias
+    + "\"}}";
+  return serverSend(client, headers, 200, "text/html", json);
+}
+
+static size_t oldTime(WiFiClient &client, Sample &s) {
+  String headers;
+  String json = "{\"Day\":\"" + String(s.date[0])
+    + F("\",\"Month\":\"") + String(s.date[1])
+    + F("\",\"Year\":\"") + String(s.date[2])
+    + F("\",\"Hour\":\"") + String(s.date[3])
+    + F("\",\"Minute\":\"") + String(s.date[4])
+    + F("\",\"Second\":\"") + String(s.date[5])
+    + F("\",\"Synced\":") + "true"
+    + "}";
+  return serverSend(client, headers, 200, "text/html", json);
+}
+
+static size_t oldIPStatus(WiFiClient &client, Sample &s) {
+  String headers;
+  String json = "";
+  json = "{\"IP_Info\":{\"IP\":\"" + s.ip.toString()
+    + F("\",\"Netmask\":\"") + s.netmask.toString()
+    + F("\",\"Gateway\":\"") + s.gateway.toString()
+    + F("\",\"IP_Type\":\"")
+    + "DHCP\"}}";
+  return serverSend(client, headers, 200, "text/html", json);
+}
+
+static size_t oldFileList(WiFiClient &client, Sample &s) {
+  String headers;
+  String output = "[";
+  for (const String &name : s.files) {
+    if (output != "[") output += ',';
+    bool isDir = false;
+    output += "{\"type\":\"";
+    output += (isDir) ? "dir" : "file";
+    output += "\",\"name\":\"";
+    output += String(name).substring(1);
+    output += "\"}";
+  }
+  output += "]";
+  return serverSend(client, headers, 200, "text/json", output);
+}
+
+//---- after: JsonWriter into ChunkedPrint, as the handlers are now
+
+static void macText(const String &mac, char *buf) {
+  strcpy(buf, mac.c_str());
+}
+
+static size_t newState(WiFiClient &client, Sample &s) {
+  ChunkedPrint page(client);
+  page.begin(200, "application/json");
+  JsonWriter json(page);
+  char mac[18];
+  json.beginObject();
+  json.member("Soft_AP_IP", s.apIP);
+  macText(s.apMac, mac);
+  json.member("Soft_AP_MAC", (const char *)mac);
+  json.member("Station_IP", s.ip);
+  macText(s.mac, mac);
+  json.member("Station_MAC", (const char *)mac);
+  json.member("Password", s.psk.length() > 0);
+  json.member("SSID", s.ssid.c_str());
+  json.endObject();
+  page.end();
+  return page.bytesSent();
+}
+
+static size_t newScan(WiFiClient &client, Sample &s) {
+  ChunkedPrint page(client);
+  page.begin(200, "application/json");
+  JsonWriter json(page);
+  json.beginObject();
+  json.key("Access_Points");
+  json.beginArray();
+  for (const ScanEntry &ap : s.scan) {
+    char rssiQ[12];
+    JsonWriter::formatInt(ap.quality, rssiQ);
+    json.beginObject();
+    json.member("SSID", (const char *)ap.ssid);
+    json.member("Encryption", ap.encrypted);
+    json.member("Quality", (const char *)rssiQ);
+    json.member("Age", ap.age);
+    json.endObject();
+  }
+  json.endArray();
+  json.endObject();
+  page.end();
+  return page.bytesSent();
+}
+
+static size_t newGPIOStatus(WiFiClient &client, Sample &s) {
+  ChunkedPrint page(client);
+  page.begin(200, "application/json");
+  JsonWriter json(page);
+  json.beginObject();
+  for (const Gpio &gpio : s.gpio) {
+    char key[8] = "GPIO";
+    JsonWriter::formatUInt(gpio.pin, key + 4);
+    json.key(key);
+    json.beginObject();
+    json.member("Status", gpio.status.c_str());
+    json.member("Alias", gpio.alias.c_str());
+    json.endObject();
+  }
+  json.endObject();
+  page.end();
+  return page.bytesSent();
+}
+
+static size_t newTime(WiFiClient &client, Sample &s) {
+  static const char *const names[] = { "Day", "Month", "Year", "Hour", "Minute", "Second" };
+  ChunkedPrint page(client);
+  page.begin(200, "application/json");
+  JsonWriter json(page);
+  json.beginObject();
+  for (uint8_t i = 0; i < 6; i++) {
+    char text[12];
+    JsonWriter::formatInt(s.date[i], text);
+    json.member(names[i], (const char *)text);
+  }
+  json.member("Synced", true);
+  json.endObject();
+  page.end();
+  return page.bytesSent();
+}
+
+static size_t newIPStatus(WiFiClient &client, Sample &s) {
+  ChunkedPrint page(client);
+  page.begin(200, "application/json");
+  JsonWriter json(page);
+  json.beginObject();
+  json.key("IP_Info");
+  json.beginObject();
+  json.member("IP", s.ip);
+  json.member("Netmask", s.netmask);
+  json.member("Gateway", s.gateway);
+  json.member("IP_Type", "DHCP");
+  json.endObject();
+  json.endObject();
+  page.end();
+  return page.bytesSent();
+}
+
+static size_t newFileList(WiFiClient &client, Sample &s) {
+  ChunkedPrint page(client);
+  page.begin(200, "application/json");
+  JsonWriter json(page);
+  json.beginArray();
+  for (const String &name : s.files) {
+    json.beginObject();
+    json.member("type", "file");
+    json.member("name", name.c_str() + 1);
+    json.endObject();
+  }
+  json.endArray();
+  page.end();
+  return page.bytesSent();
+}
+
+typedef size_t (*Endpoint)(WiFiClient &client, Sample &s);
+
+struct Measure {
+  size_t        body = 0;     // bytes of one response body
+  size_t        peak = 0;     // heap high-water mark of one response
+  double        allocs = 0;   // heap allocations per response
+  double        mbps = 0;     // body MB per host second
+};
+
+static Measure run(Endpoint endpoint, WiFiClient &client, Sample &s, unsigned long count) {
+  Measure m;
+  uint32_t allocs = hostHeapAllocs();
+  size_t base = hostHeapUsed();
+  hostHeapResetPeak();
+  uint64_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < count; i++) bytes += endpoint(client, s);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  m.body = bytes / count;
+  m.peak = hostHeapPeak() - base;
+  m.allocs = (double)(hostHeapAllocs() - allocs) / count;
+  m.mbps = seconds > 0 ? bytes / seconds / 1e6 : 0;
+  return m;
+}
+
+int main(int argc, char **argv) {
+  unsigned long count = 20000, aps = 20, files = 30;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) count = strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) aps = strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) files = strtoul(argv[++i], NULL, 10);
+    else {
+      fprintf(stderr, "usage: wmjsonbench [-n <responses>] [-a <access points>] [-f <files>]\n");
+      return 2;
+    }
+  }
+  if (count == 0) count = 1;
+  WiFiClient client;
+
+  Sample s;
+  for (unsigned long i = 0; i < aps; i++) {
+    ScanEntry ap;
+    snprintf(ap.ssid, sizeof(ap.ssid), i % 3 ? "Neighbour-%02lu" : "FRITZ!Box 7530 %02lu", i);
+    ap.quality = 90 - (int)(i * 3 % 80);
+    ap.encrypted = i % 4 != 0;
+    ap.age = i * 7 % 60;
+    s.scan.push_back(ap);
+  }
+  static const uint8_t pins[] = { 0, 2, 5, 12, 14, 15, 16 };
+  static const char *const aliases[] = { "Boot", "LED", "Living room lamp", "Fan", "Garden pump", "Spare", "Wake" };
+  for (uint8_t i = 0; i < sizeof(pins); i++) s.gpio.push_back(Gpio{ pins[i], i % 2 ? "ON" : "OFF", aliases[i] });
+  static const char *const stems[] = { "/gpio.html.gz", "/ace.js.gz", "/style.css.gz", "/config.bin", "/settings.log", "/favicon.ico" };
+  for (unsigned long i = 0; i < files; i++) {
+    s.files.push_back(i < 6 ? String(stems[i]) : "/user_file_" + String(i) + ".txt");
+  }
+
+  static const struct {
+    const char   *name;
+    Endpoint      before;
+    Endpoint      after;
+  } endpoints[] = {
+    { "/json_module_wifi_info", oldState, newState },
+    { "/scan", oldScan, newScan },
+    { "/gpio_status", oldGPIOStatus, newGPIOStatus },
+    { "/time", oldTime, newTime },
+    { "/ip_status", oldIPStatus, newIPStatus },
+    { "/list", oldFileList, newFileList },
+  };
+  printf("  %lu responses each, %lu access points, %lu files\n", count, aps, files);
+  printf("  %-24s %-7s %6s %9s %7s %9s\n", "endpoint", "path", "body B", "heap peak", "allocs", "host MB/s");
+  for (auto &e : endpoints) {
+    Measure before = run(e.before, client, s, count);
+    Measure after = run(e.after, client, s, count);
+    printf("  %-24s %-7s %6zu %9zu %7.1f %9.1f\n", e.name, "before", before.body, before.peak, before.allocs, before.mbps);
+    printf("  %-24s %-7s %6zu %9zu %7.1f %9.1f\n", "", "after", after.body, after.peak, after.allocs, after.mbps);
+  }
+  return 0;
+}
@@ -0,0 +1,142 @@
+/**************************************************************
+   wmkvsim - write amplification of SettingsStore. A random
+   stream of puts over a few keys (GPIO aliases and parameter
+   values) is stored twice on the host SPIFFS model (host/FS.h):
+   once through SettingsStore, once the way settings files were
+   kept before it, the whole "key=value" text rewritten on every
+   save. Write amplification is flash bytes programmed (page
+   headers and index pages included) over the key and value bytes
+   the puts asked for; the record bytes the store wrote, headers
+   and compaction copies included, are reported too. The store
+   is remounted every few hundred puts and each key read back
+   against the values in RAM, so a compaction that loses or
+   reorders a record fails the run.
+
+   Build: make -C tools wmkvsim
+   Usage: wmkvsim [-n <puts>] [-k <keys>] [-v <longest value>]
+          defaults 20000 puts over 16 keys, values up to 32 bytes
+   Licensed under MIT license
+ **************************************************************/
+
+#include <Arduino.h>
+#include <FS.h>
+#include "SettingsStore.h"
+#include <map>
+#include <string>
+
+#define REWRITE_FILE "/settings.txt"
+#define VERIFY_EVERY 500 // puts between two remounts
+
+//keeps the metrics text so counters without an accessor can be read back
+struct MetricsText : public Print {
+  std::string   text;
+  size_t        write(uint8_t c) override { text += (char)c; return 1; }
+  using Print::write;
+  unsigned long value(const char *name) const {
+    size_t at = text.find(std::string("\n") + name + " ");
+    return at == std::string::npos ? 0 : strtoul(text.c_str() + at + strlen(name) + 2, NULL, 10);
+  }
+};
+
+struct Result {
+  HostFlashStats flash;
+  unsigned long compactions = 0;
+  unsigned long records     = 0; // record bytes the store wrote, compaction copies included
+};
+
+static bool verify(const std::map<std::string, std::string> &expected) {
+  SettingsStore store;
+  if (!store.begin() || store.count() != expected.size()) return false;
+  char buf[WM_KV_VALUE_MAX + 1];
+  for (auto &kv : expected) {
+    if (store.get(kv.first.c_str(), buf, sizeof(buf)) != (int)kv.second.size() || kv.second != buf) return false;
+  }
+  return true;
+}
+
+static void report(const char *label, const Result &r, uint64_t logical, unsigned long puts) {
+  printf("  %-14s %8u %8u %10llu %8.2f %9.2f %6lu\n", label, r.flash.writes, r.flash.pages(), (unsigned long long)r.flash.bytes,
+         (double)r.flash.bytes / logical, (double)r.flash.pages() / puts, r.compactions);
+}
+
+int main(int argc, char **argv) {
+  unsigned long puts = 20000, keys = 16, longest = 32;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) puts = strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) keys = strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) longest = strtoul(argv[++i], NULL, 10);
+    else {
+      fprintf(stderr, "usage: wmkvsim [-n <puts>] [-k <keys>] [-v <longest value>]\n");
+      return 2;
+    }
+  }
+  if (puts == 0 || keys == 0 || keys > WM_KV_MAX_KEYS || longest == 0 || longest > WM_KV_VALUE_MAX) {
+    fprintf(stderr, "1..%d keys, values of 1..%d bytes, at least one put\n", WM_KV_MAX_KEYS, WM_KV_VALUE_MAX);
+    return 2;
+  }
+
+  // the same stream for both, unchanged values included (the store skips those, a rewrite does not)
+  std::vector<std::pair<std::string, std::string>> stream;
+  uint64_t logical = 0;
+  srand(1);
+  for (unsigned long i = 0; i < puts; i++) {
+    std::string key = "alias." + std::to_string(rand() % keys);
+    std::string value(1 + rand() % longest, 'a' + rand() % 4);
+    logical += key.size() + value.size();
+    stream.push_back(std::make_pair(key, value));
+  }
+
+  Result log, rewrite;
+  std::map<std::string, std::string> expected;
+  SPIFFS.format();
+  hostFlashReset();
+  {
+    SettingsStore store;
+    store.begin();
+    for (unsigned long i = 0; i < puts; i++) {
+      if (!store.put(stream[i].first.c_str(), stream[i].second.c_str())) {
+        fprintf(stderr, "put %lu failed\n", i);
+        return 1;
+      }
+      expected[stream[i].first] = stream[i].second;
+      if ((i + 1) % VERIFY_EVERY == 0 || i + 1 == puts) {
+        HostFlashStats before = hostFlashStats(); // remounts read only, unless they compact
+        if (!verify(expected)) {
+          fprintf(stderr, "store differs from the expected values after %lu puts\n", i + 1);
+          return 1;
+        }
+        if (hostFlashStats().bytes != before.bytes) {
+          fprintf(stderr, "remount after %lu puts wrote to flash\n", i + 1);
+          return 1;
+        }
+      }
+    }
+    MetricsText metrics;
+    store.writeMetrics(metrics);
+    log.compactions = metrics.value("wm_settings_compactions_total");
+    log.records = metrics.value("wm_settings_written_bytes_total");
+  }
+  log.flash = hostFlashStats();
+
+  SPIFFS.format();
+  hostFlashReset();
+  std::map<std::string, std::string> settings;
+  for (auto &put : stream) {
+    settings[put.first] = put.second;
+    std::string text;
+    for (auto &kv : settings) text += kv.first + "=" + kv.second + "\n";
+    File f = SPIFFS.open(REWRITE_FILE, "w");
+    f.write((const uint8_t *)text.data(), text.size());
+    f.close();
+  }
+  rewrite.flash = hostFlashStats();
+
+  printf("  %lu puts over %lu keys, values of 1..%lu bytes, %llu key and value bytes\n", puts, keys, longest, (unsigned long long)logical);
+  printf("  %-14s %8s %8s %10s %8s %9s %6s\n", "store", "writes", "pages", "flash B", "WA", "pages/put", "compact");
+  report("SettingsStore", log, logical, puts);
+  report("file rewrite", rewrite, logical, puts);
+  printf("  SettingsStore record bytes written %lu, %.2f per key and value byte before SPIFFS overhead\n",
+         log.records, (double)log.records / logical);
+  printf("  remounted and verified every %d puts\n", VERIFY_EVERY);
+  return 0;
+}
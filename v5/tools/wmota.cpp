@@ -0,0 +1,93 @@
+/**************************************************************
+   wmota - packs a firmware image for the /update page of the
+   portal. The image is gzip compressed with a window no larger
+   than the one the module inflates with (WM_INFLATE_WINDOW_BITS),
+   then the packed file is run through the same decoder the
+   firmware uses, fed in upload sized pieces, and compared with the
+   original; only a file that decodes back to the exact image is
+   written. Plain images are still accepted by /update.
+
+   Build: make -C tools wmota
+   Usage: wmota [-w <window bits>] <firmware.bin> [<output>]
+          -w  decoder window, 12..15 (default WM_INFLATE_WINDOW_BITS)
+          the output defaults to <firmware.bin>.gz
+   Licensed under MIT license
+ **************************************************************/
+
+#include "Compress.h"
+#include "HostFS.h"
+#include "GzipInflater.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UPLOAD_PIECE 2048 // HTTP_UPLOAD_BUFLEN of the web server
+
+static int usage() {
+  fprintf(stderr, "usage: wmota [-w <window bits>] <firmware.bin> [<output>]\n");
+  return 2;
+}
+
+//inflate packed the way handleUpdate does and compare the result with image
+static bool roundTrip(const std::vector<uint8_t> &packed, const std::vector<uint8_t> &image, int windowBits) {
+  std::vector<uint8_t> out;
+  size_t blocks = 0;
+  GzipInflater inflater;
+  if (!inflater.begin([&](const uint8_t *data, size_t len) {
+        out.insert(out.end(), data, data + len);
+        blocks++;
+        return true;
+      }, windowBits)) {
+    fprintf(stderr, "inflate: %s\n", GzipInflater::resultText(inflater.result()));
+    return false;
+  }
+  for (size_t at = 0; at < packed.size(); at += UPLOAD_PIECE) {
+    size_t n = (packed.size() - at < UPLOAD_PIECE) ? packed.size() - at : UPLOAD_PIECE;
+    if (!inflater.write(packed.data() + at, n)) break;
+  }
+  if (!inflater.finish()) {
+    fprintf(stderr, "inflate: %s after %u bytes\n", GzipInflater::resultText(inflater.result()), (unsigned)inflater.outputBytes());
+    return false;
+  }
+  if (out != image) {
+    fprintf(stderr, "inflate: output differs from the image\n");
+    return false;
+  }
+  printf("  verified: %zu blocks of up to %d bytes, %d bit window\n", blocks, WM_INFLATE_BLOCK, windowBits);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int windowBits = WM_INFLATE_WINDOW_BITS;
+  const char *input = NULL, *output = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) windowBits = atoi(argv[++i]);
+    else if (argv[i][0] != '-' && !input) input = argv[i];
+    else if (argv[i][0] != '-' && !output) output = argv[i];
+    else return usage();
+  }
+  if (!input || windowBits < 12 || windowBits > 15) return usage();
+  std::string outName = output ? output : std::string(input) + ".gz";
+
+  std::vector<uint8_t> image, packed;
+  if (!readFile(input, image) || image.empty()) {
+    fprintf(stderr, "%s: read failed\n", input);
+    return 1;
+  }
+  if (image[0] != 0xE9) {
+    fprintf(stderr, "%s: not an ESP8266 image (first byte 0x%02x)\n", input, image[0]);
+    return 1;
+  }
+  if (!gzipBest(image, packed, windowBits)) {
+    fprintf(stderr, "%s: gzip failed\n", input);
+    return 1;
+  }
+  printf("  %s: %zu bytes -> %zu bytes (%.1f%%)\n", input, image.size(), packed.size(), 100.0 * packed.size() / image.size());
+  if (!roundTrip(packed, image, windowBits)) return 1;
+  if (!writeFile(outName, packed)) {
+    fprintf(stderr, "%s: write failed\n", outName.c_str());
+    return 1;
+  }
+  printf("  written to %s\n", outName.c_str());
+  return 0;
+}
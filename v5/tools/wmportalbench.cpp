@@ -0,0 +1,525 @@
+/**************************************************************
+   wmportalbench - GPIO switching over the portal, HTTP against
+   the WebSocket. The same toggles are sent both ways, one at a
+   time: over HTTP each is a new connection, a GET of
+   /gpio_toggle?pin=..&status=..&alias=.. and the empty 200,
+   over /ws each is a WM_GPIO_OP_TOGGLE frame on one connection,
+   answered by the WM_GPIO_OP_STATE frame the portal broadcasts.
+   It reports toggles per second, the p50/p99 round trip and the
+   TCP payload bytes per toggle, both directions.
+   Then it times /gpio_toggle requests, a few ms apart, with no
+   other traffic and during downloads of a large asset that run
+   back to back and are read at a rate like the module's WiFi.
+   This is done twice on the host: once with the loop serving one
+   connection at a time (ESP8266WebServer::handleClient and a
+   streamFile that blocks until the client has the whole file,
+   as the portal did before the pool), once with the pool
+   (PortalServer::handleClients and deferFile). Uploads are not
+   covered: the pool reads an upload body in one go and so only
+   takes an upload while no other slot is busy (503 otherwise).
+   By default the portal is the firmware's PortalServer built
+   against the stand-ins in host/, listening on loopback, with
+   /gpio_toggle and /ws handled like WiFiManager handles them
+   (without the digitalWrite and the alias in the settings
+   store). The loopback has no radio and no TCP setup cost worth
+   the name, so the host numbers are a lower bound of what the
+   WebSocket saves; -h runs the same clients against a module.
+
+   Build: make -C tools wmportalbench
+   Usage: wmportalbench [-n <toggles>] [-l <toggles>] [-d <downloads>] [-r <KB/s>]
+                        [-s <asset KB>] [-h <module ip>[:port]]
+          -n  toggles per path, default 2000
+          -l  timed toggles with and without downloads, default 200
+          -d  concurrent downloads, default 1
+          -r  read rate of each download, default 400
+          -s  size of the host asset, default 100 (ace.js is about that gzipped)
+          -h  the portal of a module instead of the host one, the download is its ASSET_PATH
+   Licensed under MIT license
+ **************************************************************/
+
+#include <Arduino.h>
+#include "PortalServer.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// WiFiManager.h
+#define WM_GPIO_OP_TOGGLE 0x01
+#define WM_GPIO_OP_STATUS 0x02
+#define WM_GPIO_OP_SWITCH 0x03
+#define WM_GPIO_OP_STATE  0x10
+#define WM_GPIO_EVENT_LEN 96
+
+#define TOGGLE_PIN   5
+#define TOGGLE_ALIAS "lamp"
+#define SERVER_PASS_US 100 // pause between two passes of the host portal's loop
+#define ASSET_PATH   "/ace.js"
+#define DOWNLOAD_RCVBUF 4096 // small receive window, so a download is held back by its reader
+#define TOGGLE_GAP_MS 10     // timed toggles are 2 to 2 + this ms apart
+
+// --- the host portal ---
+
+struct Pin {
+  uint8_t       pin;
+  bool          on;
+  String        alias;
+};
+static Pin pins[] = { { 0 }, { 2 }, { 5 }, { 12 }, { 14 }, { 15 }, { 16 } };
+
+static Pin *pinRecord(long pin) {
+  for (size_t i = 0; i < sizeof(pins) / sizeof(pins[0]); i++) {
+    if (pins[i].pin == pin) return &pins[i];
+  }
+  return NULL;
+}
+
+// WiFiManager::formatGPIOFrame
+static size_t formatFrame(const Pin &p, uint8_t *buf, size_t size) {
+  buf[0] = WM_GPIO_OP_STATE;
+  buf[1] = p.pin;
+  buf[2] = p.on ? 1 : 0;
+  size_t len = p.alias.length();
+  if (len > size - 3) len = size - 3;
+  memcpy(buf + 3, p.alias.c_str(), len);
+  return len + 3;
+}
+
+//serial: served one connection at a time, as before the pool
+class HostPortal {
+  public:
+    HostPortal(bool serial = false) : _server(0), _serial(serial) {}
+
+    uint16_t      start();
+    void          stop();
+
+  private:
+    PortalServer  _server;
+    bool          _serial;
+    std::thread   _loop;
+    std::atomic<bool> _running { false };
+
+    void          setGPIO(long pin, bool on, const char *alias);
+    void          handleGPIOToggle();
+    void          handleAsset();
+    void          handleSocket();
+    void          handleSocketMessage(const uint8_t *payload, size_t len);
+    void          sendFrame(uint8_t pin);
+};
+
+uint16_t HostPortal::start() {
+  _server.on("/gpio_toggle", std::bind(&HostPortal::handleGPIOToggle, this));
+  _server.on("/ws", HTTP_GET, std::bind(&HostPortal::handleSocket, this));
+  _server.on(ASSET_PATH, HTTP_GET, std::bind(&HostPortal::handleAsset, this));
+  _server.onSocketMessage(std::bind(&HostPortal::handleSocketMessage, this, std::placeholders::_1, std::placeholders::_2));
+  _server.onSocketRefresh(std::bind(&HostPortal::sendFrame, this, std::placeholders::_1));
+  static const char *requestHeaders[] = { "Upgrade", "Sec-WebSocket-Key", "Sec-WebSocket-Version" };
+  _server.collectHeaders(requestHeaders, sizeof(requestHeaders) / sizeof(requestHeaders[0]));
+  _server.begin();
+  _running = true;
+  _loop = std::thread([this]() {
+    while (_running) {
+      if (_serial) _server.handleClient();
+      else _server.handleClients();
+      usleep(SERVER_PASS_US);
+    }
+  });
+  return _server.port();
+}
+
+void HostPortal::stop() {
+  _running = false;
+  _loop.join();
+}
+
+void HostPortal::setGPIO(long pin, bool on, const char *alias) {
+  Pin *p = pinRecord(pin);
+  if (!p) return;
+  p->on = on;
+  if (alias && p->alias != alias) p->alias = alias;
+  uint8_t frame[WM_GPIO_EVENT_LEN];
+  _server.socketBroadcast(frame, formatFrame(*p, frame, sizeof(frame)), p->pin);
+}
+
+void HostPortal::handleGPIOToggle() {
+  PortalServer::RequestView req = _server.request();
+  long pin = req.argInt("pin", -1);
+  bool on = req.argIs("status", "On");
+  if (pin >= 0) setGPIO(pin, on, req.arg("alias"));
+  _server.send(200, "text/html", "");
+}
+
+// WiFiManager::serveAsset, the body goes to the pool; before the pool it was streamFile
+void HostPortal::handleAsset() {
+  File file = SPIFFS.open(ASSET_PATH, "r");
+  if (_serial) {
+    _server.streamFile(file, "application/javascript");
+    return;
+  }
+  size_t size = file.size();
+  _server.setContentLength(size);
+  _server.send(200, "application/javascript", "");
+  _server.deferFile(file, 0, size);
+}
+
+void HostPortal::sendFrame(uint8_t pin) {
+  Pin *p = pinRecord(pin);
+  if (!p) return;
+  uint8_t frame[WM_GPIO_EVENT_LEN];
+  _server.socketReply(frame, formatFrame(*p, frame, sizeof(frame)), pin);
+}
+
+void HostPortal::handleSocket() {
+  if (!_server.beginSocket()) {
+    _server.send(400, "text/plain", "WebSocket upgrade refused");
+    return;
+  }
+  for (size_t i = 0; i < sizeof(pins) / sizeof(pins[0]); i++) sendFrame(pins[i].pin);
+}
+
+void HostPortal::handleSocketMessage(const uint8_t *payload, size_t len) {
+  if (len == 0) return;
+  if (payload[0] == WM_GPIO_OP_TOGGLE) {
+    if (len < 3 || !pinRecord(payload[1])) return;
+    char alias[WM_SOCKET_PAYLOAD];
+    size_t aliasLen = len - 3;
+    memcpy(alias, payload + 3, aliasLen);
+    alias[aliasLen] = '\0';
+    setGPIO(payload[1], payload[2] != 0, alias);
+  } else if (payload[0] == WM_GPIO_OP_SWITCH) {
+    if (len < 3) return;
+    setGPIO(payload[1], payload[2] != 0, NULL);
+  } else if (payload[0] == WM_GPIO_OP_STATUS) {
+    for (size_t i = 0; i < sizeof(pins) / sizeof(pins[0]); i++) sendFrame(pins[i].pin);
+  }
+}
+
+// --- the clients, plain sockets so they work against a module too ---
+
+static sockaddr_in portal;
+static std::atomic<uint64_t> payloadBytes(0); // TCP payload both ways, headers of TCP/IP not counted
+
+static int connectPortal(int rcvbuf = 0) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  if (rcvbuf) setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  timeval timeout = { 5, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  if (connect(fd, (sockaddr *)&portal, sizeof(portal)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static bool sendAll(int fd, const void *buf, size_t len) {
+  const uint8_t *p = (const uint8_t *)buf;
+  while (len) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    p += n;
+    len -= n;
+    payloadBytes += n;
+  }
+  return true;
+}
+
+static bool recvAll(int fd, void *buf, size_t len) {
+  uint8_t *p = (uint8_t *)buf;
+  while (len) {
+    ssize_t n = recv(fd, p, len, 0);
+    if (n <= 0) return false;
+    p += n;
+    len -= n;
+    payloadBytes += n;
+  }
+  return true;
+}
+
+//reads the response head, returns the status code (0 on error) and Content-Length (or -1)
+static int readHead(int fd, long &contentLength) {
+  std::string head;
+  char c;
+  while (head.size() < 4096 && (head.size() < 4 || head.compare(head.size() - 4, 4, "\r\n\r\n") != 0)) {
+    if (recv(fd, &c, 1, 0) != 1) return 0;
+    head += c;
+    payloadBytes++;
+  }
+  contentLength = -1;
+  size_t at = head.find("\r\nContent-Length:");
+  if (at != std::string::npos) contentLength = atol(head.c_str() + at + 17);
+  return head.compare(0, 5, "HTTP/") == 0 ? atoi(head.c_str() + 9) : 0;
+}
+
+//one GET, the body is read and dropped, false on any error
+static bool httpGet(const char *path) {
+  int fd = connectPortal();
+  if (fd < 0) return false;
+  char request[256];
+  int n = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: portal\r\n\r\n", path);
+  long length;
+  bool ok = sendAll(fd, request, n) && readHead(fd, length) == 200;
+  char body[512];
+  while (ok && length > 0) {
+    ssize_t got = recv(fd, body, length < (long)sizeof(body) ? length : sizeof(body), 0);
+    if (got <= 0) {
+      ok = false;
+    } else {
+      length -= got;
+      payloadBytes += got;
+    }
+  }
+  close(fd);
+  return ok;
+}
+
+static double nowUs() {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Run {
+  std::vector<double> us; // round trip of each toggle
+  double        seconds = 0;
+  uint64_t      bytes   = 0; // payload of all toggles
+  bool          ok      = true;
+};
+
+static Run httpToggles(int count) {
+  Run run;
+  uint64_t bytes = payloadBytes;
+  double started = nowUs();
+  for (int i = 0; i < count && run.ok; i++) {
+    char path[96];
+    snprintf(path, sizeof(path), "/gpio_toggle?pin=%d&status=%s&alias=%s", TOGGLE_PIN, i & 1 ? "Off" : "On", TOGGLE_ALIAS);
+    double t = nowUs();
+    run.ok = httpGet(path);
+    run.us.push_back(nowUs() - t);
+  }
+  run.seconds = (nowUs() - started) / 1e6;
+  run.bytes = payloadBytes - bytes;
+  return run;
+}
+
+//one masked client frame, RFC 6455 5.2
+static bool sendFrame(int fd, const uint8_t *payload, size_t len) {
+  uint8_t frame[2 + 4 + WM_SOCKET_PAYLOAD];
+  const uint8_t mask[4] = { 0x37, 0xfa, 0x21, 0x3d };
+  frame[0] = 0x82;
+  frame[1] = 0x80 | len;
+  memcpy(frame + 2, mask, 4);
+  for (size_t i = 0; i < len; i++) frame[6 + i] = payload[i] ^ mask[i & 3];
+  return sendAll(fd, frame, 6 + len);
+}
+
+//one unmasked server frame, short ones only
+static bool recvFrame(int fd, uint8_t *payload, size_t &len) {
+  uint8_t head[2];
+  if (!recvAll(fd, head, 2) || (head[1] & 0x7F) > WM_GPIO_EVENT_LEN) return false;
+  len = head[1] & 0x7F;
+  return recvAll(fd, payload, len);
+}
+
+static Run socketToggles(int count) {
+  Run run;
+  run.ok = false;
+  int fd = connectPortal();
+  if (fd < 0) return run;
+  static const char upgrade[] = "GET /ws HTTP/1.1\r\nHost: portal\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+  long length;
+  uint8_t frame[WM_GPIO_EVENT_LEN];
+  size_t len;
+  // the handshake and the state of every pin the portal starts with
+  if (!sendAll(fd, upgrade, sizeof(upgrade) - 1) || readHead(fd, length) != 101) {
+    close(fd);
+    return run;
+  }
+  run.ok = true;
+  uint64_t bytes = payloadBytes;
+  double started = nowUs();
+  for (int i = 0; i < count && run.ok; i++) {
+    uint8_t state = i & 1 ? 0 : 1;
+    // the alias goes along as it does in the HTTP request
+    uint8_t toggle[3 + sizeof(TOGGLE_ALIAS) - 1] = { WM_GPIO_OP_TOGGLE, TOGGLE_PIN, state };
+    memcpy(toggle + 3, TOGGLE_ALIAS, sizeof(TOGGLE_ALIAS) - 1);
+    double t = nowUs();
+    run.ok = sendFrame(fd, toggle, sizeof(toggle));
+    // the acknowledgement is the broadcast of the new state, earlier frames are skipped
+    while (run.ok) {
+      run.ok = recvFrame(fd, frame, len);
+      if (run.ok && len >= 3 && frame[0] == WM_GPIO_OP_STATE && frame[1] == TOGGLE_PIN && frame[2] == state) break;
+    }
+    run.us.push_back(nowUs() - t);
+  }
+  run.seconds = (nowUs() - started) / 1e6;
+  run.bytes = payloadBytes - bytes;
+  close(fd);
+  return run;
+}
+
+struct Downloads {
+  std::vector<std::thread> threads;
+  std::atomic<bool> stop { false };
+  std::atomic<int> done { 0 };   // whole bodies received
+  std::atomic<bool> ok { true };
+};
+
+//GETs ASSET_PATH back to back until stop, reading at most rate bytes per second
+static void download(Downloads &d, double rate) {
+  while (!d.stop) {
+    int fd = connectPortal(DOWNLOAD_RCVBUF);
+    char request[] = "GET " ASSET_PATH " HTTP/1.1\r\nHost: portal\r\n\r\n";
+    long length;
+    if (fd < 0 || !sendAll(fd, request, sizeof(request) - 1) || readHead(fd, length) != 200 || length <= 0) {
+      if (fd >= 0) close(fd);
+      d.ok = false;
+      return;
+    }
+    char buf[1460];
+    long got = 0;
+    double started = nowUs();
+    while (got < length && !d.stop) {
+      ssize_t n = recv(fd, buf, length - got < (long)sizeof(buf) ? length - got : sizeof(buf), 0);
+      if (n <= 0) break;
+      got += n;
+      double wait = started + got * 1e6 / rate - nowUs();
+      if (wait > 0) usleep((useconds_t)wait);
+    }
+    close(fd);
+    if (got == length) d.done++;
+    else if (!d.stop) d.ok = false;
+  }
+}
+
+//toggles a few ms apart, each its own /gpio_toggle request
+static Run timedToggles(int count) {
+  Run run;
+  double started = nowUs();
+  for (int i = 0; i < count && run.ok; i++) {
+    usleep((2 + rand() % TOGGLE_GAP_MS) * 1000);
+    char path[96];
+    snprintf(path, sizeof(path), "/gpio_toggle?pin=%d&status=%s&alias=%s", TOGGLE_PIN, i & 1 ? "Off" : "On", TOGGLE_ALIAS);
+    double t = nowUs();
+    run.ok = httpGet(path);
+    run.us.push_back(nowUs() - t);
+  }
+  run.seconds = (nowUs() - started) / 1e6;
+  return run;
+}
+
+static double percentile(std::vector<double> v, int p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t i = v.size() * p / 100;
+  return v[i < v.size() ? i : v.size() - 1];
+}
+
+static void report(const char *path, const Run &run) {
+  if (!run.ok) {
+    printf("  %-10s failed after %zu toggles\n", path, run.us.size());
+    return;
+  }
+  printf("  %-10s %8zu %10.0f %9.3f %9.3f %9.1f\n", path, run.us.size(), run.us.size() / run.seconds,
+         percentile(run.us, 50) / 1000, percentile(run.us, 99) / 1000, (double)run.bytes / run.us.size());
+}
+
+//timed toggles with no other traffic, then during that many concurrent downloads, one line each
+static bool latency(const char *server, int count, int downloads, double rate) {
+  bool ok = true;
+  for (int loaded = 0; loaded < 2; loaded++) {
+    Downloads d;
+    for (int i = 0; loaded && i < downloads; i++) d.threads.push_back(std::thread(download, std::ref(d), rate));
+    if (loaded) usleep(50000); // let the downloads get going
+    Run run = timedToggles(count);
+    d.stop = true;
+    for (size_t i = 0; i < d.threads.size(); i++) d.threads[i].join();
+    ok = ok && run.ok && d.ok;
+    if (!run.ok || !d.ok) {
+      printf("  %-8s %9d failed after %zu toggles\n", server, loaded ? downloads : 0, run.us.size());
+      continue;
+    }
+    printf("  %-8s %9d %9.3f %9.3f %9.3f %9.3f %10d\n", server, loaded ? downloads : 0, percentile(run.us, 50) / 1000,
+           percentile(run.us, 90) / 1000, percentile(run.us, 99) / 1000, percentile(run.us, 100) / 1000, (int)d.done);
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  int count = 2000, timed = 200, downloads = 1, rate = 400, assetKB = 100;
+  const char *module = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) timed = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) downloads = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) rate = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) assetKB = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-h") == 0 && i + 1 < argc) module = argv[++i];
+    else {
+      fprintf(stderr, "usage: wmportalbench [-n <toggles>] [-l <toggles>] [-d <downloads>] [-r <KB/s>]\n"
+                      "                     [-s <asset KB>] [-h <module ip>[:port]]\n");
+      return 2;
+    }
+  }
+  if (count <= 0 || timed <= 0 || rate <= 0 || assetKB <= 0 || downloads < 0 || downloads >= WM_HTTP_SLOTS) {
+    fprintf(stderr, "toggles, rate and asset size must be > 0, downloads fewer than the %d slots\n", WM_HTTP_SLOTS);
+    return 2;
+  }
+
+  HostPortal host;
+  portal.sin_family = AF_INET;
+  if (module) {
+    char ip[32];
+    snprintf(ip, sizeof(ip), "%s", module);
+    char *colon = strchr(ip, ':');
+    portal.sin_port = htons(colon ? atoi(colon + 1) : 80);
+    if (colon) *colon = '\0';
+    if (inet_pton(AF_INET, ip, &portal.sin_addr) != 1) {
+      fprintf(stderr, "not an IPv4 address: %s\n", ip);
+      return 2;
+    }
+    printf("  portal at %s\n", module);
+  } else {
+    portal.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    portal.sin_port = htons(host.start());
+    printf("  host portal on loopback port %u, %d us between loop passes\n", ntohs(portal.sin_port), SERVER_PASS_US);
+  }
+
+  printf("  %d toggles of gpio%d, one at a time\n", count, TOGGLE_PIN);
+  printf("  %-10s %8s %10s %9s %9s %9s\n", "path", "toggles", "toggles/s", "p50 ms", "p99 ms", "B/toggle");
+  Run http = httpToggles(count);
+  report("http", http);
+  Run socket = socketToggles(count);
+  report("websocket", socket);
+  if (!module) host.stop();
+
+  printf("\n  %d /gpio_toggle requests, 2-%d ms apart, during back to back downloads of %s read at %d KB/s\n",
+         timed, 2 + TOGGLE_GAP_MS - 1, ASSET_PATH, rate);
+  printf("  %-8s %9s %9s %9s %9s %9s %10s\n", "server", "downloads", "p50 ms", "p90 ms", "p99 ms", "max ms", "completed");
+  bool timedOk;
+  if (module) {
+    timedOk = latency("module", timed, downloads, rate * 1024.0);
+  } else {
+    // the asset is not compressible filler, only its size matters
+    File asset = SPIFFS.open(ASSET_PATH, "w");
+    for (int i = 0; i < assetKB * 1024; i++) asset.write((uint8_t)(i * 131 + (i >> 9)));
+    asset.close();
+    HostPortal serial(true);
+    portal.sin_port = htons(serial.start());
+    timedOk = latency("serial", timed, downloads, rate * 1024.0);
+    serial.stop();
+    HostPortal pooled;
+    portal.sin_port = htons(pooled.start());
+    timedOk = latency("pooled", timed, downloads, rate * 1024.0) && timedOk;
+    pooled.stop();
+  }
+  return http.ok && socket.ok && timedOk ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+/**************************************************************
+   wmupbench - replays an editor upload against the host SPIFFS
+   model (host/FS.h) the way handleFileUpload receives it, in
+   HTTP_UPLOAD_BUFLEN chunks, once through the old path (one
+   File::write and two debug lines per chunk) and once through
+   UploadWriter, and reports flash writes, programmed pages and
+   serial bytes of each. KB/s is modelled from those counts with
+   the page program time of the flash chip and the time the UART
+   takes for the debug lines at 115200 baud; the network is left
+   out, it is the same for both. The stored file is compared with
+   the upload after each run.
+
+   Build: make -C tools wmupbench
+   Usage: wmupbench [-s <upload KB>] [-c <chunk bytes>]
+          -s  upload size, default 200
+          -c  chunk size, default 2048 (HTTP_UPLOAD_BUFLEN), 0 random sizes up to it
+   Licensed under MIT license
+ **************************************************************/
+
+#include <Arduino.h>
+#include <FS.h>
+#include "UploadWriter.h"
+#include <string>
+#include <vector>
+
+#define UPLOAD_BUFLEN     2048   // HTTP_UPLOAD_BUFLEN of the web server
+#define PAGE_PROGRAM_US   600    // typical page program time of the GD25Q32 / W25Q32 on ESP-12 modules
+#define SERIAL_BYTE_US    86.8   // 10 bits per byte at 115200 baud
+#define UPLOAD_LOG_STEP   32768  // WM_UPLOAD_LOG_STEP in WiFiManager.h
+#define UPLOAD_FILE       "/ace.js.gz"
+
+//counts what DEBUG_WM would send over Serial
+struct DebugLog {
+  size_t        bytes = 0;
+  void          line(const String &text) { bytes += 5 + text.length() + 2; } // "*WM: " text "\r\n"
+};
+
+struct Result {
+  HostFlashStats flash;
+  size_t        serial = 0;
+  bool          same   = false;
+};
+
+static std::vector<size_t> chunkSizes(size_t total, size_t chunk) {
+  std::vector<size_t> sizes;
+  srand(1);
+  for (size_t at = 0; at < total;) {
+    size_t n = chunk ? chunk : 1 + rand() % UPLOAD_BUFLEN;
+    if (n > total - at) n = total - at;
+    sizes.push_back(n);
+    at += n;
+  }
+  return sizes;
+}
+
+static bool stored(const std::vector<uint8_t> &upload) {
+  File f = SPIFFS.open(UPLOAD_FILE, "r");
+  std::vector<uint8_t> data(f.size());
+  bool same = f.read(data.data(), data.size()) == upload.size() && data == upload;
+  f.close();
+  return same;
+}
+
+//handleFileUpload before UploadWriter: a write and two debug lines per chunk
+static Result oldPath(const std::vector<uint8_t> &upload, const std::vector<size_t> &sizes) {
+  Result r;
+  DebugLog log;
+  SPIFFS.format();
+  hostFlashReset();
+  File f = SPIFFS.open(UPLOAD_FILE, "w");
+  size_t at = 0;
+  for (size_t n : sizes) {
+    log.line("Handle file upload...");
+    log.line("Uploading size: ");
+    log.line(String((unsigned long)n));
+    f.write(upload.data() + at, n);
+    at += n;
+  }
+  f.close();
+  log.line("Handle file upload...");
+  log.line("Total upload size: ");
+  log.line(String((unsigned long)upload.size()));
+  r.flash = hostFlashStats();
+  r.serial = log.bytes;
+  r.same = stored(upload);
+  return r;
+}
+
+//handleFileUpload with UploadWriter: whole page payloads, progress every UPLOAD_LOG_STEP bytes
+static Result newPath(const std::vector<uint8_t> &upload, const std::vector<size_t> &sizes) {
+  Result r;
+  DebugLog log;
+  SPIFFS.format();
+  hostFlashReset();
+  UploadWriter writer;
+  writer.begin(UPLOAD_FILE);
+  size_t at = 0;
+  for (size_t n : sizes) {
+    uint32_t before = writer.bytes();
+    writer.write(upload.data() + at, n);
+    at += n;
+    if (before / UPLOAD_LOG_STEP != writer.bytes() / UPLOAD_LOG_STEP) {
+      log.line("Uploaded bytes: ");
+      log.line(String((unsigned long)writer.bytes()));
+    }
+  }
+  writer.end();
+  log.line("Upload done, bytes / flash writes / ms:");
+  log.line(String((unsigned long)writer.bytes()));
+  log.line(String((unsigned long)writer.writes()));
+  log.line(String(writer.elapsed()));
+  r.flash = hostFlashStats();
+  r.serial = log.bytes;
+  r.same = stored(upload);
+  return r;
+}
+
+static void report(const char *label, const Result &r, size_t total) {
+  double ms = (r.flash.pages() * PAGE_PROGRAM_US + r.serial * SERIAL_BYTE_US) / 1000.0;
+  printf("  %-14s %6u %7u %8u %8.2f %7zu %9.1f %8.1f  %s\n", label, r.flash.writes, r.flash.dataPages, r.flash.indexPages,
+         (double)r.flash.bytes / total, r.serial, ms, total / 1024.0 / (ms / 1000.0), r.same ? "ok" : "CONTENT DIFFERS");
+}
+
+int main(int argc, char **argv) {
+  size_t kb = 200, chunk = UPLOAD_BUFLEN;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) kb = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) chunk = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: wmupbench [-s <upload KB>] [-c <chunk bytes>]\n");
+      return 2;
+    }
+  }
+  if (kb == 0 || chunk > UPLOAD_BUFLEN) {
+    fprintf(stderr, "upload size must be > 0 and chunks at most %d bytes\n", UPLOAD_BUFLEN);
+    return 2;
+  }
+  std::vector<uint8_t> upload(kb * 1024);
+  for (size_t i = 0; i < upload.size(); i++) upload[i] = (uint8_t)(i * 131 + (i >> 9));
+  std::vector<size_t> sizes = chunkSizes(upload.size(), chunk);
+
+  printf("  %zu KB upload, %zu chunks (%s), %d byte pages, %d us per page program\n", kb, sizes.size(),
+         chunk ? "fixed size" : "random size", WM_HOST_PAGE_SIZE, PAGE_PROGRAM_US);
+  printf("  %-14s %6s %7s %8s %8s %7s %9s %8s\n", "path", "writes", "data pg", "index pg", "flash/B", "serial", "model ms", "KB/s");
+  Result before = oldPath(upload, sizes);
+  Result after = newPath(upload, sizes);
+  report("per chunk", before, upload.size());
+  report("UploadWriter", after, upload.size());
+  return before.same && after.same ? 0 : 1;
+}